@@ -3,6 +3,7 @@ del /s /q x64\Debug\*.*
 del /s /q .vs\*.*
 del /s /q ThreeGPStart\x64\Release\*.*
 del /s /q ThreeGPStart\x64\Debug\*.*
+del /s /q TextureBaker\x64\*.*
 del /s /q ThreeGPStart\Debug
 del /s /q ThreeGPStart\Release
 del /s /q Debug\*.*
@@ -14,4 +15,5 @@ rd /s /q Debug
 rd /s /q Release
 rd /s /q ThreeGPStart\Debug
 rd /s /q ThreeGPStart\Release
-rd /s /q ThreeGPStart\x64
\ No newline at end of file
+rd /s /q ThreeGPStart\x64
+rd /s /q TextureBaker\x64
\ No newline at end of file
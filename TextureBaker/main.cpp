@@ -0,0 +1,112 @@
+/*
+	TextureBaker : converts source images (JPG, PNG, BMP, TGA, GIF, DDS) into .btx containers holding the
+	full mip chain in its GPU format, so ThreeGPStart can map and upload them without decoding or generating mips.
+
+	Usage: TextureBaker [-compress] [-nomips] [-virtual] [-force] [file or folder ...]
+
+		-compress	store BC1 (opaque) or BC3 (with alpha) instead of RGBA8
+		-nomips		only store the top level
+		-virtual	write a paged .vtx virtual texture instead, for images too big to load whole
+		-force		rebake files whose .btx is already up to date
+
+	Folders are searched recursively. With no paths given Data is baked. The .btx is written next to each
+	source and ImageLoader::Load picks it up automatically while it is newer than the source.
+	Uses the ThreeGPStart helper code directly and runs with ThreeGPStart as its working directory.
+*/
+
+#include "ExternalLibraryHeaders.h"
+#include "TextureContainer.h"
+#include "VirtualTextureFile.h"
+#include "ThreadPool.h"
+#include <filesystem>
+namespace fs = std::filesystem;
+
+// Source image types the baker picks up when searching folders
+static bool IsBakeableImage(const fs::path& path)
+{
+	std::string extension{ path.extension().string() };
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+	return extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp" ||
+		extension == ".tga" || extension == ".gif" || extension == ".dds";
+}
+
+int main(int argc, char* argv[])
+{
+	Helpers::TextureBakeSettings settings;
+	bool force{ false };
+	bool virtualTexture{ false };
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg{ argv[i] };
+		if (arg == "-compress")
+			settings.compress = true;
+		else if (arg == "-nomips")
+			settings.generateMips = false;
+		else if (arg == "-virtual")
+			virtualTexture = true;
+		else if (arg == "-force")
+			force = true;
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			std::cout << "Unknown option " << arg << std::endl;
+			std::cout << "Usage: TextureBaker [-compress] [-nomips] [-virtual] [-force] [file or folder ...]" << std::endl;
+			return 1;
+		}
+		else
+			inputs.push_back(arg);
+	}
+
+	if (inputs.empty())
+		inputs.push_back("Data");
+
+	// Gather everything to bake
+	std::vector<std::string> sources;
+	for (const std::string& input : inputs)
+	{
+		std::error_code error;
+		if (fs::is_directory(fs::path(input), error))
+		{
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(fs::path(input), error))
+			{
+				if (entry.is_regular_file() && IsBakeableImage(entry.path()))
+					sources.push_back(entry.path().string());
+			}
+		}
+		else if (fs::is_regular_file(fs::path(input), error))
+			sources.push_back(input);
+		else
+			std::cout << "Not found: " << input << std::endl;
+	}
+
+	// Bake on the loading pool, each image also spreads its mip and block work across threads
+	std::vector<std::future<bool>> results;
+	std::vector<std::string> baked;
+	for (const std::string& source : sources)
+	{
+		if (!force && (virtualTexture ? Helpers::IsVirtualTextureCurrent(source) : Helpers::IsBakedTextureCurrent(source)))
+			continue;
+
+		baked.push_back(source);
+		results.push_back(Helpers::LoadingPool().Submit([source, settings, virtualTexture]()
+		{
+			if (virtualTexture)
+				return Helpers::BakeVirtualTexture(source, Helpers::VirtualTexturePath(source));
+			return Helpers::BakeTexture(source, Helpers::BakedTexturePath(source), settings);
+		}));
+	}
+
+	int failed{ 0 };
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const bool ok{ results[i].get() };
+		std::cout << (ok ? "Baked  " : "FAILED ") << baked[i] << std::endl;
+		if (!ok)
+			failed++;
+	}
+
+	std::cout << baked.size() - failed << " baked, " << failed << " failed, " << sources.size() - baked.size() << " up to date" << std::endl;
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include "AnimationSampler.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Helpers
+{
+	// Quaternions closer than this are lerped, the slerp weights lose precision as the angle goes to 0
+	constexpr float kSlerpLerpThreshold{ 0.9995f };
+
+	// Key at or before time in times. cursor is where the last search ended, when playing forwards the answer
+	// is nearly always it or the one after so those are tried before searching
+	static unsigned int FindKey(const std::vector<float>& times, float time, unsigned int& cursor)
+	{
+		const unsigned int last{ (unsigned int)times.size() - 1 };
+		unsigned int key{ std::min(cursor, last) };
+		if (times[key] <= time && (key == last || time < times[key + 1]))
+			return key;
+
+		if (times[key] <= time && (key + 1 == last || time < times[key + 2]))
+		{
+			cursor = key + 1;
+			return cursor;
+		}
+
+		const unsigned int after{ (unsigned int)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) };
+		cursor = after == 0 ? 0 : after - 1;
+		return cursor;
+	}
+
+	// How far time is from key to the next one, 0 at the last key or before the first
+	static float KeyFraction(const std::vector<float>& times, unsigned int key, float time)
+	{
+		if (key + 1 >= times.size())
+			return 0;
+
+		const float span{ times[key + 1] - times[key] };
+		return span > 0 ? std::clamp((time - times[key]) / span, 0.0f, 1.0f) : 0;
+	}
+
+	static float Dot4(__m128 a, __m128 b)
+	{
+		__m128 sum{ _mm_mul_ps(a, b) };
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = _mm_add_ps(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(sum);
+	}
+
+	static glm::vec3 Lerp(const glm::vec3& a, const glm::vec3& b, float f)
+	{
+		const __m128 va{ _mm_setr_ps(a.x, a.y, a.z, 0.0f) };
+		const __m128 vb{ _mm_setr_ps(b.x, b.y, b.z, 0.0f) };
+		alignas(16) float result[4];
+		_mm_store_ps(result, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_set1_ps(f))));
+		return glm::vec3(result[0], result[1], result[2]);
+	}
+
+	// The angle and weights are scalar, blending the components is done 4 wide
+	static glm::quat Slerp(const glm::quat& a, const glm::quat& b, float f)
+	{
+		const __m128 qa{ _mm_loadu_ps(glm::value_ptr(a)) };
+		__m128 qb{ _mm_loadu_ps(glm::value_ptr(b)) };
+
+		// q and -q are the same rotation, going to whichever is nearer takes the short way round
+		float cosine{ Dot4(qa, qb) };
+		if (cosine < 0)
+		{
+			qb = _mm_sub_ps(_mm_setzero_ps(), qb);
+			cosine = -cosine;
+		}
+
+		float weightA{ 1 - f };
+		float weightB{ f };
+		if (cosine < kSlerpLerpThreshold)
+		{
+			const float angle{ std::acos(cosine) };
+			const float inverseSine{ 1.0f / std::sin(angle) };
+			weightA = std::sin((1 - f) * angle) * inverseSine;
+			weightB = std::sin(f * angle) * inverseSine;
+		}
+
+		__m128 blended{ _mm_add_ps(_mm_mul_ps(qa, _mm_set1_ps(weightA)), _mm_mul_ps(qb, _mm_set1_ps(weightB))) };
+		blended = _mm_mul_ps(blended, _mm_set1_ps(1.0f / std::sqrt(Dot4(blended, blended))));
+
+		glm::quat result;
+		_mm_storeu_ps(glm::value_ptr(result), blended);
+		return result;
+	}
+
+	AnimationSampler::AnimationSampler(const AnimationClip& clip) :
+		m_clip{ &clip }, m_cursors(clip.channels.size() * 3, 0)
+	{
+	}
+
+	void AnimationSampler::Sample(float seconds, NodeHierarchy& nodes)
+	{
+		if (!m_clip)
+			return;
+
+		float time{ seconds * m_clip->ticksPerSecond };
+		if (m_clip->duration > 0)
+		{
+			time = std::fmod(time, m_clip->duration);
+			if (time < 0)
+				time += m_clip->duration;
+		}
+
+		for (size_t i = 0; i < m_clip->channels.size(); i++)
+		{
+			const AnimationChannel& channel{ m_clip->channels[i] };
+
+			const unsigned int t{ FindKey(channel.translationTimes, time, m_cursors[i * 3]) };
+			const unsigned int nextT{ std::min(t + 1, (unsigned int)channel.translations.size() - 1) };
+			const glm::vec3 translation{ Lerp(channel.translations[t], channel.translations[nextT], KeyFraction(channel.translationTimes, t, time)) };
+
+			const unsigned int r{ FindKey(channel.rotationTimes, time, m_cursors[i * 3 + 1]) };
+			const unsigned int nextR{ std::min(r + 1, (unsigned int)channel.rotations.size() - 1) };
+			const glm::quat rotation{ Slerp(channel.rotations[r], channel.rotations[nextR], KeyFraction(channel.rotationTimes, r, time)) };
+
+			const unsigned int s{ FindKey(channel.scaleTimes, time, m_cursors[i * 3 + 2]) };
+			const unsigned int nextS{ std::min(s + 1, (unsigned int)channel.scales.size() - 1) };
+			const glm::vec3 scale{ Lerp(channel.scales[s], channel.scales[nextS], KeyFraction(channel.scaleTimes, s, time)) };
+
+			// Scale, then rotate, then translate
+			glm::mat4 transform{ glm::mat4_cast(rotation) };
+			transform[0] *= scale.x;
+			transform[1] *= scale.y;
+			transform[2] *= scale.z;
+			transform[3] = glm::vec4(translation, 1.0f);
+			nodes.SetLocalTransform(channel.node, transform);
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+// Keyframe animation. A clip holds a channel per animated node, with separate translation, rotation and scale
+// tracks. Each track keeps its key times apart from its values so finding a key only reads the times. Rotations
+// are quaternions so they interpolate by the shortest way round.
+// An AnimationSampler plays one clip for one instance. It remembers where each track was last sampled, which
+// is almost always the key wanted next frame as well, so a binary search is only needed after a jump or loop.
+// Values are blended with SSE, lerp for translations and scales and slerp for rotations.
+
+#include "ExternalLibraryHeaders.h"
+#include "NodeHierarchy.h"
+#include <glm/gtc/quaternion.hpp>
+
+namespace Helpers
+{
+	// Keys for one node. Every track has at least one key, times are in ticks and increasing
+	struct AnimationChannel
+	{
+		int node{ NodeHierarchy::kNoNode };
+
+		std::vector<float> translationTimes;
+		std::vector<glm::vec3> translations;
+
+		std::vector<float> rotationTimes;
+		std::vector<glm::quat> rotations;
+
+		std::vector<float> scaleTimes;
+		std::vector<glm::vec3> scales;
+	};
+
+	struct AnimationClip
+	{
+		std::string name;
+
+		// Length in ticks, and how many ticks there are per second
+		float duration{ 0 };
+		float ticksPerSecond{ 25.0f };
+
+		std::vector<AnimationChannel> channels;
+	};
+
+	class AnimationSampler
+	{
+	private:
+		const AnimationClip* m_clip{ nullptr };
+
+		// Key at or before the time last sampled, translation, rotation then scale for each channel
+		std::vector<unsigned int> m_cursors;
+	public:
+		AnimationSampler() = default;
+		explicit AnimationSampler(const AnimationClip& clip);
+
+		// Sets the local transform of every node the clip animates to its pose seconds into the clip, looping.
+		// nodes must be the hierarchy the clip was loaded with, or a copy of it
+		void Sample(float seconds, NodeHierarchy& nodes);
+	};
+}
@@ -0,0 +1,212 @@
+#include "BlockCompress.h"
+#include "Parallel.h"
+#include <climits>
+
+namespace Helpers
+{
+	// Block rows handed to each thread at minimum
+	constexpr size_t kMinBlockRowsPerThread{ 16 };
+
+	static UINT16 PackRGB565(int r, int g, int b)
+	{
+		return (UINT16)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+	}
+
+	// Expands a 565 colour back to 8 bits per channel the same way the GPU does
+	static void UnpackRGB565(UINT16 c, int rgb[3])
+	{
+		const int r{ (c >> 11) & 31 };
+		const int g{ (c >> 5) & 63 };
+		const int b{ c & 31 };
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Copies the 4x4 block at bx, by into block as 16 RGBA texels, repeating edge texels for partial blocks
+	static void FetchBlock(const BYTE* rgba, int width, int height, int bx, int by, BYTE block[64])
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			const int sy{ std::min(by * 4 + y, height - 1) };
+			for (int x = 0; x < 4; x++)
+			{
+				const int sx{ std::min(bx * 4 + x, width - 1) };
+				memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	// Writes the 8 byte colour part of a BC1 / BC3 block. End points come from the bounding box of the
+	// colours, taking the diagonal that follows how green and blue vary with red, pulled in slightly
+	// so the interpolated colours land on the texels rather than past them.
+	static void EncodeColourBlock(const BYTE block[64], BYTE* out)
+	{
+		int minC[3]{ 255, 255, 255 };
+		int maxC[3]{ 0, 0, 0 };
+		int mean[3]{ 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				minC[c] = std::min(minC[c], (int)block[i * 4 + c]);
+				maxC[c] = std::max(maxC[c], (int)block[i * 4 + c]);
+				mean[c] += block[i * 4 + c];
+			}
+		}
+
+		// Covariance of green and blue against red, times 16 * 16
+		int covRG{ 0 };
+		int covRB{ 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			const int r{ block[i * 4] * 16 - mean[0] };
+			covRG += r * (block[i * 4 + 1] * 16 - mean[1]);
+			covRB += r * (block[i * 4 + 2] * 16 - mean[2]);
+		}
+		if (covRG < 0)
+			std::swap(minC[1], maxC[1]);
+		if (covRB < 0)
+			std::swap(minC[2], maxC[2]);
+
+		for (int c = 0; c < 3; c++)
+		{
+			const int inset{ (maxC[c] - minC[c]) / 16 };
+			minC[c] += inset;
+			maxC[c] -= inset;
+		}
+
+		UINT16 c0{ PackRGB565(maxC[0], maxC[1], maxC[2]) };
+		UINT16 c1{ PackRGB565(minC[0], minC[1], minC[2]) };
+
+		// c0 > c1 selects 4 colour mode, c0 <= c1 would mean 3 colours and transparent black
+		if (c0 < c1)
+			std::swap(c0, c1);
+
+		UINT32 indices{ 0 };
+		if (c0 != c1)
+		{
+			int palette[4][3];
+			UnpackRGB565(c0, palette[0]);
+			UnpackRGB565(c1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int best{ 0 };
+				int bestDistance{ INT_MAX };
+				for (int p = 0; p < 4; p++)
+				{
+					const int dr{ block[i * 4] - palette[p][0] };
+					const int dg{ block[i * 4 + 1] - palette[p][1] };
+					const int db{ block[i * 4 + 2] - palette[p][2] };
+					const int distance{ dr * dr + dg * dg + db * db };
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (UINT32)best << (i * 2);
+			}
+		}
+
+		memcpy(out, &c0, 2);
+		memcpy(out + 2, &c1, 2);
+		memcpy(out + 4, &indices, 4);
+	}
+
+	// Writes the 8 byte interpolated alpha part of a BC3 block, using the 8 value mode between the min and max
+	static void EncodeAlphaBlock(const BYTE block[64], BYTE* out)
+	{
+		int a0{ 0 };
+		int a1{ 255 };
+		for (int i = 0; i < 16; i++)
+		{
+			a0 = std::max(a0, (int)block[i * 4 + 3]);
+			a1 = std::min(a1, (int)block[i * 4 + 3]);
+		}
+
+		out[0] = (BYTE)a0;
+		out[1] = (BYTE)a1;
+
+		unsigned long long indices{ 0 };
+		if (a0 != a1)
+		{
+			int palette[8]{ a0, a1 };
+			for (int p = 1; p < 7; p++)
+				palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+			for (int i = 0; i < 16; i++)
+			{
+				const int alpha{ block[i * 4 + 3] };
+				int best{ 0 };
+				int bestDistance{ INT_MAX };
+				for (int p = 0; p < 8; p++)
+				{
+					const int distance{ abs(alpha - palette[p]) };
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						best = p;
+					}
+				}
+				indices |= (unsigned long long)best << (i * 3);
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (BYTE)(indices >> (8 * i));
+	}
+
+	// Compresses a tightly packed RGBA image into BC1 or BC3 blocks. Returns false for other formats.
+	bool CompressImage(const BYTE* rgba, int width, int height, ImageFormat format, BYTE* destination)
+	{
+		if (format != ImageFormat::BC1 && format != ImageFormat::BC3)
+			return false;
+
+		const int blocksX{ std::max(1, (width + 3) / 4) };
+		const int blocksY{ std::max(1, (height + 3) / 4) };
+		const size_t blockSize{ format == ImageFormat::BC1 ? (size_t)8 : (size_t)16 };
+
+		ParallelFor((size_t)blocksY, kMinBlockRowsPerThread, [&](size_t begin, size_t end)
+		{
+			BYTE block[64];
+			for (size_t by = begin; by < end; by++)
+			{
+				BYTE* out{ destination + by * blocksX * blockSize };
+				for (int bx = 0; bx < blocksX; bx++, out += blockSize)
+				{
+					FetchBlock(rgba, width, height, bx, (int)by, block);
+					if (format == ImageFormat::BC3)
+					{
+						EncodeAlphaBlock(block, out);
+						EncodeColourBlock(block, out + 8);
+					}
+					else
+					{
+						EncodeColourBlock(block, out);
+					}
+				}
+			}
+		});
+
+		return true;
+	}
+
+	// True if any texel of the RGBA image has alpha below 255
+	bool HasTransparency(const BYTE* rgba, int width, int height)
+	{
+		const size_t numTexels{ (size_t)width * (size_t)height };
+		for (size_t i = 0; i < numTexels; i++)
+		{
+			if (rgba[i * 4 + 3] != 255)
+				return true;
+		}
+		return false;
+	}
+}
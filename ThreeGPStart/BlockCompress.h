@@ -0,0 +1,16 @@
+#pragma once
+// CPU encoders for the block compressed texture formats, used when baking textures offline
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+
+namespace Helpers
+{
+	// Compresses a tightly packed RGBA image into BC1 or BC3 blocks at destination, which must hold
+	// ImageLevelSize(width, height, format) bytes. Rows keep their order so the result uploads the same way
+	// as the source would. Partial blocks at the edges repeat the last row / column. Returns false for other formats.
+	bool CompressImage(const BYTE* rgba, int width, int height, ImageFormat format, BYTE* destination);
+
+	// True if any texel of the RGBA image has alpha below 255
+	bool HasTransparency(const BYTE* rgba, int width, int height);
+}
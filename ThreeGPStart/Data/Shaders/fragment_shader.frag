@@ -2,6 +2,17 @@
 
 uniform sampler2D sampler_tex;
 
+// Virtual texture, see VirtualTexture.h. When enabled the albedo comes from its page cache instead of sampler_tex
+uniform bool vt_enabled;
+uniform usampler2D vt_page_table;
+uniform sampler2D vt_cache;
+uniform vec2 vt_size;
+uniform float vt_page_size;
+uniform float vt_page_border;
+uniform float vt_cache_size;
+uniform float vt_max_level;
+uniform float vt_lod_bias;
+
 uniform vec3 light_intensity;
 
 uniform vec4 diffuse_colour;
@@ -15,10 +26,27 @@ in vec3 varying_gouraud;
 
 out vec4 fragment_colour;
 
+// Looks up the page the mip level wants in the page table, which points at it or the nearest coarser page
+// that is resident, then samples that page in the cache
+vec3 VirtualSample(vec2 uv)
+{
+	vec2 texel = clamp(uv, 0.0, 1.0) * vt_size;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_lod_bias), 0.0, vt_max_level);
+
+	texel = min(texel, vt_size - 1.0);
+	uvec4 entry = texelFetch(vt_page_table, ivec2(texel / (vt_page_size * exp2(level))), int(level));
+
+	vec2 in_page = fract(texel / (vt_page_size * exp2(float(entry.b))));
+	vec2 cache_texel = vec2(entry.rg) * (vt_page_size + 2.0 * vt_page_border) + vt_page_border + in_page * vt_page_size;
+	return textureLod(vt_cache, cache_texel / vt_cache_size, 0.0).rgb;
+}
+
 
 void main(void)
 { 
-	vec3 tex_colour = texture(sampler_tex, varying_texcoord).rgb;
+	vec3 tex_colour = vt_enabled ? VirtualSample(varying_texcoord) : texture(sampler_tex, varying_texcoord).rgb;
 	vec3 N = normalize(varying_normal);
 	vec3 P = varying_position;
 	vec3 light_position = vec3(50, 100, 50);
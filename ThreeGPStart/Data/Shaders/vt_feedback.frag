@@ -0,0 +1,24 @@
+#version 330
+
+// Feedback pass of the virtual texture, writes the page each pixel needs (plus one, 0 is no page).
+// Must pick the level the same way as VirtualSample in fragment_shader.frag
+uniform vec2 vt_size;
+uniform float vt_page_size;
+uniform float vt_max_level;
+uniform float vt_lod_bias;
+
+in vec2 varying_texcoord;
+
+out uint feedback;
+
+void main(void)
+{
+	vec2 texel = clamp(varying_texcoord, 0.0, 1.0) * vt_size;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+	float level = clamp(floor(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + vt_lod_bias), 0.0, vt_max_level);
+
+	texel = min(texel, vt_size - 1.0);
+	uvec2 page = uvec2(texel / (vt_page_size * exp2(level)));
+	feedback = ((uint(level) << 24) | (page.y << 12) | page.x) + 1u;
+}
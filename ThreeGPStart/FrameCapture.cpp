@@ -0,0 +1,235 @@
+#include "FrameCapture.h"
+#include "Parallel.h"
+
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	// PNG encoding is mostly zlib, a couple of threads keep up with recording without taking every core
+	static size_t EncoderThreadCount()
+	{
+		return std::clamp<size_t>(WorkerThreadCount() / 4, 1, 2);
+	}
+
+	static void CreateParentFolder(const std::string& filepath)
+	{
+		const fs::path folder{ fs::path(filepath).parent_path() };
+		std::error_code error;
+		if (!folder.empty())
+			fs::create_directories(folder, error);
+	}
+
+	// Writes bottom up RGBA rows as filepath.png. Alpha is dropped, the framebuffer's alpha is not meaningful
+	static bool EncodeFrame(const std::vector<BYTE>& pixels, int width, int height, const std::string& filepath, bool fastCompression)
+	{
+		FIBITMAP* bitmap{ FreeImage_ConvertFromRawBits((BYTE*)pixels.data(), width, height, width * 4, 32, 0, 0, 0, FALSE) };
+		if (!bitmap)
+			return false;
+
+		FIBITMAP* opaque{ FreeImage_ConvertTo24Bits(bitmap) };
+		FreeImage_Unload(bitmap);
+		if (!opaque)
+			return false;
+
+		const BOOL res{ FreeImage_Save(FIF_PNG, opaque, (filepath + ".png").c_str(), fastCompression ? PNG_Z_BEST_SPEED : PNG_DEFAULT) };
+		FreeImage_Unload(opaque);
+
+		return (res == 1);
+	}
+
+	FrameCapture::FrameCapture() :
+		m_encoders(EncoderThreadCount())
+	{
+	}
+
+	FrameCapture::~FrameCapture()
+	{
+		// Readbacks still on their way are the last frames of a capture, wait for them, oldest first, and write them
+		for (int i = 0; i < kNumSlots; i++)
+		{
+			Slot& slot{ m_slots[(m_nextSlot + i) % kNumSlots] };
+			if (!slot.fence)
+				continue;
+
+			const GLenum result{ glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFinalReadbackTimeout) };
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+			{
+				FinishReadback(slot);
+			}
+			else
+			{
+				std::cout << "Frame capture: gave up waiting for " << slot.filepath << std::endl;
+				m_failedWrites++;
+			}
+		}
+
+		// The encode jobs point back at this
+		for (std::future<void>& job : m_encodeJobs)
+			job.wait();
+
+		for (Slot& slot : m_slots)
+		{
+			if (slot.fence)
+				glDeleteSync(slot.fence);
+			glDeleteBuffers(1, &slot.pbo);
+		}
+	}
+
+	// Saves the next frame as filepath.png (SaveImage style, no extension)
+	void FrameCapture::RequestScreenshot(const std::string& filepath)
+	{
+		CreateParentFolder(filepath);
+		m_screenshotPath = filepath;
+	}
+
+	// Saves every frame to folder as frame_00000.png onwards until StopRecording
+	void FrameCapture::StartRecording(const std::string& folder)
+	{
+		std::error_code error;
+		fs::create_directories(folder, error);
+
+		m_recordingFolder = folder;
+		m_recordedFrames = 0;
+		m_droppedFrames = 0;
+		m_failedWrites = 0;
+		m_recording = true;
+	}
+
+	void FrameCapture::StopRecording()
+	{
+		// Frames already read back still get written
+		m_recording = false;
+	}
+
+	bool FrameCapture::StartReadback(const std::string& filepath, bool fastCompression)
+	{
+		// Reusing a slot the GPU hasn't finished with would stall
+		Slot& slot{ m_slots[m_nextSlot] };
+		if (slot.fence)
+			return false;
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		if (viewport[2] <= 0 || viewport[3] <= 0)
+			return false;
+
+		// Buffers only grow, so resizing the window doesn't reallocate every frame
+		const size_t size{ (size_t)viewport[2] * viewport[3] * 4 };
+		if (slot.capacity < size)
+		{
+			glDeleteBuffers(1, &slot.pbo);
+			glCreateBuffers(1, &slot.pbo);
+			glNamedBufferStorage(slot.pbo, size, nullptr, GL_MAP_READ_BIT);
+			slot.capacity = size;
+		}
+
+		// With a pack buffer bound glReadPixels only queues the copy and returns straight away
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glReadPixels(viewport[0], viewport[1], viewport[2], viewport[3], GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.width = viewport[2];
+		slot.height = viewport[3];
+		slot.filepath = filepath;
+		slot.fastCompression = fastCompression;
+
+		m_nextSlot = (m_nextSlot + 1) % kNumSlots;
+		return true;
+	}
+
+	void FrameCapture::FinishReadback(Slot& slot)
+	{
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		std::vector<BYTE> pixels;
+		{
+			std::lock_guard<std::mutex> lock(m_bufferMutex);
+			if (!m_freeBuffers.empty())
+			{
+				pixels = std::move(m_freeBuffers.back());
+				m_freeBuffers.pop_back();
+			}
+		}
+
+		const size_t size{ (size_t)slot.width * slot.height * 4 };
+		pixels.resize(size);
+
+		// The copy has finished so this maps without waiting. The pixels are copied out rather than encoded from
+		// the mapping so the slot is free again straight away and no encoder touches OpenGL memory
+		const void* mapped{ glMapNamedBufferRange(slot.pbo, 0, size, GL_MAP_READ_BIT) };
+		if (!mapped)
+		{
+			std::cout << "Frame capture: could not map the readback buffer for " << slot.filepath << std::endl;
+			m_failedWrites++;
+			return;
+		}
+		memcpy(pixels.data(), mapped, size);
+		glUnmapNamedBuffer(slot.pbo);
+
+		m_queuedFrames++;
+		m_encodeJobs.push_back(m_encoders.Submit([this, pixels{ std::move(pixels) }, width{ slot.width }, height{ slot.height },
+			filepath{ slot.filepath }, fast{ slot.fastCompression }]() mutable
+		{
+			if (!EncodeFrame(pixels, width, height, filepath, fast))
+			{
+				std::cout << "Frame capture: could not write " << filepath << ".png" << std::endl;
+				m_failedWrites++;
+			}
+
+			std::lock_guard<std::mutex> lock(m_bufferMutex);
+			m_freeBuffers.push_back(std::move(pixels));
+			m_queuedFrames--;
+		}));
+	}
+
+	// Call once per frame on the OpenGL thread after drawing what should be captured.
+	// Starts this frame's readback and hands finished ones to the encoders
+	void FrameCapture::Update()
+	{
+		// Oldest first so frames reach the encoders in order. Fences signal in order so this never skips one
+		for (int i = 0; i < kNumSlots; i++)
+		{
+			Slot& slot{ m_slots[(m_nextSlot + i) % kNumSlots] };
+			if (slot.fence && glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED)
+				FinishReadback(slot);
+		}
+
+		while (!m_encodeJobs.empty() && m_encodeJobs.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			m_encodeJobs.pop_front();
+
+		// A screenshot waits for a free slot rather than being dropped
+		if (!m_screenshotPath.empty() && StartReadback(m_screenshotPath, false))
+			m_screenshotPath.clear();
+
+		if (m_recording)
+		{
+			std::ostringstream name;
+			name << "frame_" << std::setw(5) << std::setfill('0') << m_recordedFrames;
+			const std::string filepath{ (fs::path(m_recordingFolder) / name.str()).string() };
+
+			// Dropping keeps the frame rate steady when the encoders or the GPU fall behind
+			if (m_queuedFrames < kMaxQueuedFrames && StartReadback(filepath, true))
+				m_recordedFrames++;
+			else
+				m_droppedFrames++;
+		}
+	}
+
+	// Local time as text such as 2024-01-31_18-05-12, for naming captures so they don't overwrite each other
+	std::string CaptureTimestamp()
+	{
+		const std::time_t now{ std::time(nullptr) };
+		std::tm local{};
+		localtime_s(&local, &now);
+
+		std::ostringstream text;
+		text << std::put_time(&local, "%Y-%m-%d_%H-%M-%S");
+		return text.str();
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+// Screenshots and image sequence recording that don't stall the frame.
+// The framebuffer is read into a ring of pixel buffer objects, mapped a few frames later once the GPU has
+// finished with them, and encoded to PNG on worker threads.
+
+#include "ExternalLibraryHeaders.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <deque>
+
+namespace Helpers
+{
+	class FrameCapture
+	{
+	private:
+		// Frames in flight between the GPU and the CPU. Readbacks are normally done 2 frames after they start
+		static constexpr int kNumSlots{ 3 };
+
+		// Frames waiting for or being encoded. Recording drops frames beyond this rather than slowing down
+		static constexpr int kMaxQueuedFrames{ 8 };
+
+		// How long the destructor waits in nanoseconds for each readback still in flight
+		static constexpr GLuint64 kFinalReadbackTimeout{ 1000000000 };
+
+		// One readback on its way from the GPU
+		struct Slot
+		{
+			GLuint pbo{ 0 };
+			size_t capacity{ 0 };
+			GLsync fence{ nullptr };
+			int width{ 0 };
+			int height{ 0 };
+			std::string filepath;
+			bool fastCompression{ false };
+		};
+
+		Slot m_slots[kNumSlots];
+		int m_nextSlot{ 0 };
+
+		// Screenshot waiting to be taken at the end of the frame
+		std::string m_screenshotPath;
+
+		bool m_recording{ false };
+		std::string m_recordingFolder;
+		int m_recordedFrames{ 0 };
+		int m_droppedFrames{ 0 };
+
+		// Frame buffers are reused to avoid a large allocation per frame
+		std::mutex m_bufferMutex;
+		std::vector<std::vector<BYTE>> m_freeBuffers;
+		std::atomic<int> m_queuedFrames{ 0 };
+		std::atomic<int> m_failedWrites{ 0 };
+
+		std::deque<std::future<void>> m_encodeJobs;
+		ThreadPool m_encoders;
+
+		// Returns false if the next slot is still in flight, the frame can then be retried or dropped
+		bool StartReadback(const std::string& filepath, bool fastCompression);
+		void FinishReadback(Slot& slot);
+	public:
+		FrameCapture();
+
+		// Finishes readbacks in flight and waits for every frame to be written. Needs the OpenGL context
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&) = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+
+		// Saves the next frame as filepath.png (SaveImage style, no extension)
+		void RequestScreenshot(const std::string& filepath);
+
+		// Saves every frame to folder as frame_00000.png onwards until StopRecording
+		void StartRecording(const std::string& folder);
+		void StopRecording();
+		bool IsRecording() const { return m_recording; }
+
+		// Call once per frame on the OpenGL thread after drawing what should be captured.
+		// Starts this frame's readback and hands finished ones to the encoders
+		void Update();
+
+		int RecordedFrames() const { return m_recordedFrames; }
+		int DroppedFrames() const { return m_droppedFrames; }
+		int QueuedFrames() const { return m_queuedFrames; }
+		int FailedWrites() const { return m_failedWrites; }
+	};
+
+	// Local time as text such as 2024-01-31_18-05-12, for naming captures so they don't overwrite each other
+	std::string CaptureTimestamp();
+}
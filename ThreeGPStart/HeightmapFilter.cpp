@@ -0,0 +1,311 @@
+#include "HeightmapFilter.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace Helpers
+{
+	// Rows handed to each thread at minimum. Small heightmaps end up running on one thread
+	constexpr size_t kMinRowsPerThread{ 32 };
+
+	// Runs kernel over every row then every column of field. The kernel is given one pointer per tap
+	// where taps[k][x] is the k-th neighbour of texel x, so the same kernel code serves both directions.
+	// Edges are handled by clamping.
+	template<typename Kernel>
+	void SeparablePass(HeightField& field, int radius, const Kernel& kernel)
+	{
+		const size_t width{ (size_t)field.width };
+		const size_t height{ (size_t)field.height };
+		const int numTaps{ radius * 2 + 1 };
+
+		std::vector<float> temp(field.values.size());
+
+		// Horizontal, field -> temp. Each row is copied into a padded buffer so the taps never go out of bounds
+		ParallelFor(height, kMinRowsPerThread, [&](size_t begin, size_t end)
+		{
+			std::vector<float> padded(width + (size_t)radius * 2);
+			std::vector<const float*> taps(numTaps);
+			for (int k = 0; k < numTaps; k++)
+				taps[k] = padded.data() + k;
+
+			for (size_t y = begin; y < end; y++)
+			{
+				const float* src{ field.values.data() + y * width };
+				for (int i = 0; i < radius; i++)
+				{
+					padded[i] = src[0];
+					padded[radius + width + i] = src[width - 1];
+				}
+				memcpy(padded.data() + radius, src, width * sizeof(float));
+
+				kernel(taps.data(), temp.data() + y * width, width);
+			}
+		});
+
+		// Vertical, temp -> field. The taps are just neighbouring rows
+		ParallelFor(height, kMinRowsPerThread, [&](size_t begin, size_t end)
+		{
+			std::vector<const float*> taps(numTaps);
+			for (size_t y = begin; y < end; y++)
+			{
+				for (int k = 0; k < numTaps; k++)
+				{
+					const long long row{ std::clamp((long long)y + k - radius, 0LL, (long long)height - 1) };
+					taps[k] = temp.data() + (size_t)row * width;
+				}
+
+				kernel(taps.data(), field.values.data() + y * width, width);
+			}
+		});
+	}
+
+	// Weighted sum of the taps
+	struct GaussianKernel
+	{
+		std::vector<float> weights;
+
+		void operator()(const float* const* taps, float* out, size_t width) const
+		{
+			const size_t numTaps{ weights.size() };
+
+			// Two accumulators per iteration to hide the add latency
+			size_t x{ 0 };
+			for (; x + 8 <= width; x += 8)
+			{
+				__m128 acc0{ _mm_setzero_ps() };
+				__m128 acc1{ _mm_setzero_ps() };
+				for (size_t k = 0; k < numTaps; k++)
+				{
+					const __m128 w{ _mm_set1_ps(weights[k]) };
+					acc0 = _mm_add_ps(acc0, _mm_mul_ps(w, _mm_loadu_ps(taps[k] + x)));
+					acc1 = _mm_add_ps(acc1, _mm_mul_ps(w, _mm_loadu_ps(taps[k] + x + 4)));
+				}
+				_mm_storeu_ps(out + x, acc0);
+				_mm_storeu_ps(out + x + 4, acc1);
+			}
+
+			for (; x < width; x++)
+			{
+				float acc{ 0 };
+				for (size_t k = 0; k < numTaps; k++)
+					acc += weights[k] * taps[k][x];
+				out[x] = acc;
+			}
+		}
+	};
+
+	// Middle value of the taps via a min / max sorting network
+	struct MedianKernel
+	{
+		int numTaps{ 3 };
+
+		void operator()(const float* const* taps, float* out, size_t width) const
+		{
+			__m128 v[5];
+
+			size_t x{ 0 };
+			for (; x + 4 <= width; x += 4)
+			{
+				for (int k = 0; k < numTaps; k++)
+					v[k] = _mm_loadu_ps(taps[k] + x);
+
+				// Odd-even transposition sort, at most 10 compare and swaps for 5 taps
+				for (int pass = 0; pass < numTaps; pass++)
+				{
+					for (int k = pass & 1; k + 1 < numTaps; k += 2)
+					{
+						const __m128 lo{ _mm_min_ps(v[k], v[k + 1]) };
+						v[k + 1] = _mm_max_ps(v[k], v[k + 1]);
+						v[k] = lo;
+					}
+				}
+
+				_mm_storeu_ps(out + x, v[numTaps / 2]);
+			}
+
+			for (; x < width; x++)
+			{
+				float s[5];
+				for (int k = 0; k < numTaps; k++)
+					s[k] = taps[k][x];
+				std::nth_element(s, s + numTaps / 2, s + numTaps);
+				out[x] = s[numTaps / 2];
+			}
+		}
+	};
+
+	// Gaussian in both distance and height difference. The range gaussian comes from a lookup table
+	// so no exp is needed per tap
+	struct BilateralKernel
+	{
+		std::vector<float> spatialWeights;
+		std::vector<float> rangeLookup;
+		float rangeScale{ 1.0f };
+
+		void operator()(const float* const* taps, float* out, size_t width) const
+		{
+			const size_t numTaps{ spatialWeights.size() };
+			const float* centre{ taps[numTaps / 2] };
+			const float maxIndex{ (float)(rangeLookup.size() - 1) };
+
+			const __m128 absMask{ _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)) };
+			const __m128 scale{ _mm_set1_ps(rangeScale) };
+			const __m128 clampIndex{ _mm_set1_ps(maxIndex) };
+			alignas(16) int index[4];
+
+			size_t x{ 0 };
+			for (; x + 4 <= width; x += 4)
+			{
+				const __m128 c{ _mm_loadu_ps(centre + x) };
+				__m128 sum{ _mm_setzero_ps() };
+				__m128 weightSum{ _mm_setzero_ps() };
+				for (size_t k = 0; k < numTaps; k++)
+				{
+					const __m128 v{ _mm_loadu_ps(taps[k] + x) };
+					const __m128 diff{ _mm_and_ps(_mm_sub_ps(v, c), absMask) };
+					_mm_store_si128((__m128i*)index, _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(diff, scale), clampIndex)));
+
+					const __m128 w{ _mm_mul_ps(_mm_set1_ps(spatialWeights[k]),
+						_mm_setr_ps(rangeLookup[index[0]], rangeLookup[index[1]], rangeLookup[index[2]], rangeLookup[index[3]])) };
+					sum = _mm_add_ps(sum, _mm_mul_ps(w, v));
+					weightSum = _mm_add_ps(weightSum, w);
+				}
+
+				// The centre tap always has a range weight of 1 so weightSum is never 0
+				_mm_storeu_ps(out + x, _mm_div_ps(sum, weightSum));
+			}
+
+			for (; x < width; x++)
+			{
+				float sum{ 0 };
+				float weightSum{ 0 };
+				for (size_t k = 0; k < numTaps; k++)
+				{
+					const float v{ taps[k][x] };
+					const float diff{ std::abs(v - centre[x]) };
+					const float w{ spatialWeights[k] * rangeLookup[(size_t)std::min(diff * rangeScale, maxIndex)] };
+					sum += w * v;
+					weightSum += w;
+				}
+				out[x] = sum / weightSum;
+			}
+		}
+	};
+
+	// Normalised 1D gaussian with a radius of 3 sigma
+	static std::vector<float> MakeGaussianWeights(float sigma, int& radius)
+	{
+		radius = std::max(1, (int)std::ceil(sigma * 3.0f));
+
+		std::vector<float> weights((size_t)radius * 2 + 1);
+		float total{ 0 };
+		for (int i = -radius; i <= radius; i++)
+		{
+			const float w{ std::exp(-0.5f * (i * i) / (sigma * sigma)) };
+			weights[(size_t)i + radius] = w;
+			total += w;
+		}
+
+		for (float& w : weights)
+			w /= total;
+
+		return weights;
+	}
+
+	// Fills field with heights from image. 8 bit sources (and the red of RGBA) give 0-255, R16 is scaled to the
+	// same 0-255 range keeping its extra precision as fractions and R32F is used as is. Returns false if the image is empty.
+	bool HeightFieldFromImage(const ImageLoader& image, HeightField& field)
+	{
+		if (!image.GetData() || image.IsCompressed() || image.Width() <= 0 || image.Height() <= 0)
+			return false;
+
+		field.width = image.Width();
+		field.height = image.Height();
+		field.values.resize((size_t)field.width * (size_t)field.height);
+
+		const BYTE* src{ image.GetData() };
+		float* dst{ field.values.data() };
+		const ImageFormat format{ image.Format() };
+		ParallelFor(field.values.size(), 1 << 16, [src, dst, format](size_t begin, size_t end)
+		{
+			switch (format)
+			{
+			case ImageFormat::R8:
+				for (size_t i = begin; i < end; i++)
+					dst[i] = (float)src[i];
+				break;
+			case ImageFormat::R16:
+				for (size_t i = begin; i < end; i++)
+					dst[i] = ((const UINT16*)src)[i] * (255.0f / 65535.0f);
+				break;
+			case ImageFormat::R32F:
+				memcpy(dst + begin, (const float*)src + begin, (end - begin) * sizeof(float));
+				break;
+			default:
+				for (size_t i = begin; i < end; i++)
+					dst[i] = (float)src[i * 4];
+				break;
+			}
+		});
+
+		return true;
+	}
+
+	// Separable gaussian blur with a kernel radius of 3 * sigma
+	void GaussianFilter(HeightField& field, float sigma)
+	{
+		if (sigma <= 0.0f || field.values.empty())
+			return;
+
+		int radius{ 0 };
+		GaussianKernel kernel;
+		kernel.weights = MakeGaussianWeights(sigma, radius);
+
+		SeparablePass(field, radius, kernel);
+	}
+
+	// Separable median approximation (rows then columns). Radius is clamped to 1 or 2
+	void MedianFilter(HeightField& field, int radius)
+	{
+		if (radius <= 0 || field.values.empty())
+			return;
+
+		radius = std::min(radius, 2);
+
+		MedianKernel kernel;
+		kernel.numTaps = radius * 2 + 1;
+
+		SeparablePass(field, radius, kernel);
+	}
+
+	// Separable bilateral approximation (rows then columns)
+	void BilateralFilter(HeightField& field, float spatialSigma, float rangeSigma)
+	{
+		if (spatialSigma <= 0.0f || rangeSigma <= 0.0f || field.values.empty())
+			return;
+
+		int radius{ 0 };
+		BilateralKernel kernel;
+		kernel.spatialWeights = MakeGaussianWeights(spatialSigma, radius);
+
+		// Table covers differences up to 3 sigma, anything beyond that gets no weight
+		const size_t lookupSize{ 256 };
+		kernel.rangeScale = (float)(lookupSize - 1) / (rangeSigma * 3.0f);
+		kernel.rangeLookup.resize(lookupSize);
+		for (size_t i = 0; i < lookupSize; i++)
+		{
+			const float diff{ (float)i / kernel.rangeScale };
+			kernel.rangeLookup[i] = std::exp(-0.5f * (diff * diff) / (rangeSigma * rangeSigma));
+		}
+		kernel.rangeLookup.back() = 0.0f;
+
+		SeparablePass(field, radius, kernel);
+	}
+
+	// Runs all the filters enabled in settings
+	void FilterHeightField(HeightField& field, const HeightFilterSettings& settings)
+	{
+		MedianFilter(field, settings.medianRadius);
+		BilateralFilter(field, settings.bilateralSpatialSigma, settings.bilateralRangeSigma);
+		GaussianFilter(field, settings.gaussianSigma);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+// Heightmap preprocessing: converts images to floating point heights and smooths them
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+
+namespace Helpers
+{
+	// Single channel floating point height data, row major with width * height entries
+	struct HeightField
+	{
+		int width{ 0 };
+		int height{ 0 };
+		std::vector<float> values;
+
+		// Height at texel x, y. No bounds checking
+		float At(int x, int y) const { return values[(size_t)x + (size_t)y * (size_t)width]; }
+	};
+
+	// Which filters to run over a height field before building terrain from it
+	// Filters run in the order median, bilateral then gaussian. A radius or sigma of 0 disables that filter
+	struct HeightFilterSettings
+	{
+		// Removes single texel spikes and holes. 1 = 3 taps, 2 = 5 taps per axis
+		int medianRadius{ 0 };
+
+		// Smooths the 8 bit stair steps while keeping real cliffs. Range sigma is in height units (0-255 for 8 bit sources)
+		float bilateralSpatialSigma{ 0.0f };
+		float bilateralRangeSigma{ 4.0f };
+
+		// Plain blur, good at hiding quantisation steps on gentle slopes
+		float gaussianSigma{ 1.5f };
+	};
+
+	// Fills field with heights from image. 8 bit sources (and the red of RGBA) give 0-255, R16 is scaled to the
+	// same 0-255 range keeping its extra precision as fractions and R32F is used as is. Returns false if the image is empty.
+	bool HeightFieldFromImage(const ImageLoader& image, HeightField& field);
+
+	// Separable gaussian blur with a kernel radius of 3 * sigma
+	void GaussianFilter(HeightField& field, float sigma);
+
+	// Separable median approximation (rows then columns). Radius is clamped to 1 or 2
+	void MedianFilter(HeightField& field, int radius);
+
+	// Separable bilateral approximation (rows then columns)
+	void BilateralFilter(HeightField& field, float spatialSigma, float rangeSigma);
+
+	// Runs all the filters enabled in settings
+	void FilterHeightField(HeightField& field, const HeightFilterSettings& settings);
+}
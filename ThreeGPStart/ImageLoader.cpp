@@ -1,23 +1,76 @@
 #include "ImageLoader.h"
+#include "ImageRegionReader.h"
+#include "PixelConvert.h"
+#include "TextureContainer.h"
+#include "ThreadPool.h"
 #include <filesystem>
 namespace fs = std::filesystem;
 
 namespace Helpers
 {
+	// Bytes per texel of an uncompressed format, 0 for the block compressed ones
+	int BytesPerTexel(ImageFormat format)
+	{
+		switch (format)
+		{
+		case ImageFormat::RGBA8:
+		case ImageFormat::R32F:
+			return 4;
+		case ImageFormat::R16:
+			return 2;
+		case ImageFormat::R8:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+	// Bytes taken by one mip level of the given size and format
+	size_t ImageLevelSize(int width, int height, ImageFormat format)
+	{
+		const size_t blocks{ (size_t)std::max(1, (width + 3) / 4) * (size_t)std::max(1, (height + 3) / 4) };
+		switch (format)
+		{
+		case ImageFormat::BC1:
+			return blocks * 8;
+		case ImageFormat::BC2:
+		case ImageFormat::BC3:
+			return blocks * 16;
+		default:
+			return (size_t)width * (size_t)height * BytesPerTexel(format);
+		}
+	}
+
 	BYTE ImageLoader::GetGreyValue(float u, float v) const
 	{
+		if (IsCompressed() || !m_data)
+			return 0;
+
 		u = fmod(u, 1.0f);
 		v = fmod(v, 1.0f);
 
 		// Nearest
 		const int x = (int)(u * (m_width - 1));
 		const int y = (int)(v * (m_height - 1));
+		const size_t index{ (size_t)x + (size_t)y * m_width };
 
-		BYTE alpha{ m_data[(x + y * m_width) * 4 + 3] };
+		switch (m_format)
+		{
+		case ImageFormat::R8:
+			return m_data[index];
+		case ImageFormat::R16:
+			return (BYTE)(((const UINT16*)m_data)[index] >> 8);
+		case ImageFormat::R32F:
+			return (BYTE)std::clamp(((const float*)m_data)[index], 0.0f, 255.0f);
+		default:
+			break;
+		}
+
+		BYTE alpha{ m_data[index * 4 + 3] };
 		if (alpha == 0)
 			return 0;
 
-		BYTE red{ m_data[(x + y * m_width) * 4] };
+		BYTE red{ m_data[index * 4] };
 
 		if (alpha == 255 || red == 0)
 			return red;
@@ -26,15 +79,61 @@ namespace Helpers
 		return calc;
 	}
 
-	// Attempt to load an image from the file and path provided. Returns false on error.
-	bool ImageLoader::Load(const std::string& filepath)
+	ImageLoader::ImageLoader(ImageLoader&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	ImageLoader& ImageLoader::operator=(ImageLoader&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Release();
+
+			m_width = other.m_width;
+			m_height = other.m_height;
+			m_data = other.m_data;
+			m_bitmap = other.m_bitmap;
+			m_mappedFile = std::move(other.m_mappedFile);
+			m_ownsData = other.m_ownsData;
+			m_format = other.m_format;
+			m_mipLevels = std::move(other.m_mipLevels);
+
+			other.m_width = other.m_height = 0;
+			other.m_data = nullptr;
+			other.m_bitmap = nullptr;
+			other.m_ownsData = false;
+			other.m_format = ImageFormat::RGBA8;
+			other.m_mipLevels.clear();
+		}
+		return *this;
+	}
+
+	// Frees whatever is holding the image data
+	void ImageLoader::Release()
+	{
+		if (m_bitmap)
+			FreeImage_Unload(m_bitmap);
+		else if (m_ownsData)
+			delete[] m_data;
+		m_mappedFile.Close();
+
+		m_bitmap = nullptr;
+		m_data = nullptr;
+		m_ownsData = false;
+		m_width = m_height = 0;
+		m_format = ImageFormat::RGBA8;
+		m_mipLevels.clear();
+	}
+
+	// Works out the file format. Returns FIF_UNKNOWN on error
+	static FREE_IMAGE_FORMAT DetermineFormat(const std::string& filepath)
 	{
-		
 		// First check file exists
 		if (!exists(fs::path(filepath)))
 		{
 			std::cout << "File does not exist: " << filepath << std::endl;
-			return false;
+			return FIF_UNKNOWN;
 		}
 
 		// Determine the format of the image.
@@ -51,91 +150,491 @@ namespace Helpers
 			if (!FreeImage_FIFSupportsReading(format))
 			{
 				std::cout << "Detected image format cannot be read!" << std::endl;
-				return false;
+				return FIF_UNKNOWN;
 			}
 		}
 
-		// If we're here we have a known image format, so load the image into a bitmap
+		return format;
+	}
+
+	// Loads the file into a FreeImage bitmap in whatever layout the file uses. Returns nullptr on error
+	static FIBITMAP* Decode(const std::string& filepath)
+	{
+		const FREE_IMAGE_FORMAT format{ DetermineFormat(filepath) };
+		if (format == FIF_UNKNOWN)
+			return nullptr;
+
 		FIBITMAP* bitmap{ FreeImage_Load(format, filepath.c_str()) };
+		if (!bitmap)
+			std::cout << "FreeImage failed to load: " << filepath << std::endl;
+
+		return bitmap;
+	}
+
+	// Converts bitmap into tightly packed RGBA at destination one scanline at a time, so no intermediate
+	// 32 bit copy of the image is ever made. Common layouts use the SSE2 kernels in PixelConvert, the rest
+	// FreeImage's line converters, with rows spread over the worker threads.
+	// Returns false if the bitmap layout is not handled here.
+	static bool ConvertTo32BitsInto(FIBITMAP* bitmap, BYTE* destination)
+	{
+		const int width{ (int)FreeImage_GetWidth(bitmap) };
+		const int height{ (int)FreeImage_GetHeight(bitmap) };
+		const size_t rowBytes{ (size_t)width * 4 };
+		const FREE_IMAGE_TYPE imageType{ FreeImage_GetImageType(bitmap) };
+
+		if (imageType == FIT_UINT16)
+		{
+			// FreeImage seems to have an issue converting 16 bit grey scale images to 32 so handling this manually
+			ConvertImageRows(height, [=](int y)
+			{
+				Grey16ToRGBA((const UINT16*)FreeImage_GetScanLine(bitmap, y), destination + rowBytes * y, width);
+			});
+			return true;
+		}
+
+		if (imageType != FIT_BITMAP)
+			return false;
+
+		const unsigned int bitsPerPixel{ FreeImage_GetBPP(bitmap) };
+		RGBQUAD* palette{ FreeImage_GetPalette(bitmap) };
+		const bool transparent{ FreeImage_IsTransparent(bitmap) == TRUE };
+		BYTE* transparencyTable{ FreeImage_GetTransparencyTable(bitmap) };
+		const int transparencyCount{ (int)FreeImage_GetTransparencyCount(bitmap) };
+		const bool is565{ bitsPerPixel == 16 && FreeImage_GetRedMask(bitmap) == FI16_565_RED_MASK };
+
+		// Plain grey scale needs no palette lookups
+		const bool grey{ bitsPerPixel == 8 && !transparent && FreeImage_GetColorType(bitmap) == FIC_MINISBLACK };
+
+		if (bitsPerPixel != 1 && bitsPerPixel != 4 && bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 24 && bitsPerPixel != 32)
+			return false;
+
+		ConvertImageRows(height, [=](int y)
+		{
+			BYTE* src{ FreeImage_GetScanLine(bitmap, y) };
+			BYTE* dst{ destination + rowBytes * y };
+
+			switch (bitsPerPixel)
+			{
+			case 1:
+				if (transparent)
+					FreeImage_ConvertLine1To32MapTransparency(dst, src, width, palette, transparencyTable, transparencyCount);
+				else
+					FreeImage_ConvertLine1To32(dst, src, width, palette);
+				break;
+			case 4:
+				if (transparent)
+					FreeImage_ConvertLine4To32MapTransparency(dst, src, width, palette, transparencyTable, transparencyCount);
+				else
+					FreeImage_ConvertLine4To32(dst, src, width, palette);
+				break;
+			case 8:
+				if (grey)
+					GreyToRGBA(src, dst, width);
+				else if (transparent)
+					FreeImage_ConvertLine8To32MapTransparency(dst, src, width, palette, transparencyTable, transparencyCount);
+				else
+					FreeImage_ConvertLine8To32(dst, src, width, palette);
+				break;
+			case 16:
+				if (is565)
+					FreeImage_ConvertLine16To32_565(dst, src, width);
+				else
+					FreeImage_ConvertLine16To32_555(dst, src, width);
+				break;
+			case 24:
+				// FreeImage is built with RGB order so this is a straight widen
+				RGBToRGBA(src, dst, width);
+				break;
+			case 32:
+				memcpy(dst, src, rowBytes);
+				break;
+			}
+		});
+
+		return true;
+	}
+
+	// Keeps one channel of bitmap at the source precision. Always unloads bitmap. Returns false on error.
+	bool ImageLoader::LoadSingleChannel(FIBITMAP* bitmap)
+	{
+		// Unusual sample types (signed, 32 bit integer, double etc.) are converted to float by FreeImage
+		FREE_IMAGE_TYPE imageType{ FreeImage_GetImageType(bitmap) };
+		if (imageType != FIT_BITMAP && imageType != FIT_UINT16 && imageType != FIT_RGB16 && imageType != FIT_RGBA16 &&
+			imageType != FIT_FLOAT && imageType != FIT_RGBF && imageType != FIT_RGBAF)
+		{
+			FIBITMAP* asFloat{ FreeImage_ConvertToType(bitmap, FIT_FLOAT) };
+			FreeImage_Unload(bitmap);
+			if (!asFloat)
+			{
+				std::cout << "ImageLoader::Load could not convert image to a single channel" << std::endl;
+				return false;
+			}
+			bitmap = asFloat;
+			imageType = FIT_FLOAT;
+		}
 
-		// How many bits-per-pixel is the source image?
-		unsigned int bitsPerPixel{ FreeImage_GetBPP(bitmap) };
-				
-		// Grab size
 		m_width = FreeImage_GetWidth(bitmap);
 		m_height = FreeImage_GetHeight(bitmap);
 
-		// Convert our image to 32 bits (8 bits per channel, Red/Green/Blue/Alpha) if not already
-		FIBITMAP* bitmap32{ nullptr };
-		if (bitsPerPixel == 32)
+		// Texels per source pixel, the first (red or grey) is the one kept
+		int stride{ 1 };
+		switch (imageType)
 		{
-			bitmap32 = bitmap;
+		case FIT_UINT16:
+			m_format = ImageFormat::R16;
+			break;
+		case FIT_RGB16:
+		case FIT_RGBA16:
+			m_format = ImageFormat::R16;
+			stride = imageType == FIT_RGB16 ? 3 : 4;
+			break;
+		case FIT_FLOAT:
+			m_format = ImageFormat::R32F;
+			break;
+		case FIT_RGBF:
+		case FIT_RGBAF:
+			m_format = ImageFormat::R32F;
+			stride = imageType == FIT_RGBF ? 3 : 4;
+			break;
+		default:
+			m_format = ImageFormat::R8;
+			break;
+		}
+
+		m_data = new BYTE[DataSize()];
+		m_ownsData = true;
+
+		const size_t rowBytes{ (size_t)m_width * BytesPerTexel(m_format) };
+		bool ok{ true };
+
+		if (imageType == FIT_BITMAP && FreeImage_GetBPP(bitmap) == 8)
+		{
+			// Grey scale copies straight across, paletted images look up the red of each entry
+			const bool grey{ FreeImage_GetColorType(bitmap) == FIC_MINISBLACK };
+			const RGBQUAD* palette{ FreeImage_GetPalette(bitmap) };
+			for (int y = 0; y < m_height; y++)
+			{
+				const BYTE* src{ FreeImage_GetScanLine(bitmap, y) };
+				BYTE* dst{ m_data + rowBytes * y };
+				if (grey)
+					memcpy(dst, src, rowBytes);
+				else
+				{
+					for (int x = 0; x < m_width; x++)
+						dst[x] = palette[src[x]].rgbRed;
+				}
+			}
+		}
+		else if (imageType == FIT_BITMAP)
+		{
+			// Colour, go via RGBA and keep red
+			std::vector<BYTE> rgba(ImageLevelSize(m_width, m_height, ImageFormat::RGBA8));
+			ok = ConvertTo32BitsInto(bitmap, rgba.data());
+			if (!ok)
+			{
+				FIBITMAP* bitmap32{ FreeImage_ConvertTo32Bits(bitmap) };
+				if (bitmap32)
+				{
+					ok = ConvertTo32BitsInto(bitmap32, rgba.data());
+					FreeImage_Unload(bitmap32);
+				}
+			}
+
+			if (ok)
+			{
+				ConvertImageRows(m_height, [this, &rgba, rowBytes](int y)
+				{
+					ExtractChannel(rgba.data() + rowBytes * 4 * y, m_data + rowBytes * y, m_width, 0);
+				});
+			}
 		}
 		else
 		{
-			bitmap32 = FreeImage_ConvertTo32Bits(bitmap);
-			if (!bitmap32)
+			// 16 bit and float samples are kept exactly as stored
+			const size_t sampleSize{ (size_t)BytesPerTexel(m_format) };
+			for (int y = 0; y < m_height; y++)
 			{
-				const FREE_IMAGE_TYPE image_type{ FreeImage_GetImageType(bitmap) };
-				if (image_type == FIT_UINT16)
+				const BYTE* src{ FreeImage_GetScanLine(bitmap, y) };
+				BYTE* dst{ m_data + rowBytes * y };
+				if (stride == 1)
+					memcpy(dst, src, rowBytes);
+				else
 				{
-					// FreeImage seems to have an issue converting 16 bit grey scale images to 32 so handling this manually
-					UINT16* textureData{ (UINT16*)FreeImage_GetBits(bitmap) };
-
-					m_data = new GLubyte[(size_t)m_width * (size_t)m_height * 4];
-					size_t count{ 0 };
-					for (size_t i = 0; i < (size_t)m_width * (size_t)m_height * 4; i += 4)
-					{
-						BYTE asByte = (BYTE)(textureData[count++] / 256.0f);
-						m_data[i] = m_data[i + 1] = m_data[i + 2] = asByte;
-						m_data[i + 3] = 255;
-					}
-
-					return true;
+					for (int x = 0; x < m_width; x++)
+						memcpy(dst + x * sampleSize, src + x * stride * sampleSize, sampleSize);
 				}
+			}
+		}
+
+		FreeImage_Unload(bitmap);
+
+		if (!ok)
+		{
+			std::cout << "ImageLoader::Load could not convert image to a single channel" << std::endl;
+			Release();
+			return false;
+		}
+
+		return true;
+	}
+
+	// Reads uncompressed BMP, TGA and raw files straight from a mapping of the file. Returns false if the file is not one of those
+	bool ImageLoader::LoadNative(const std::string& filepath, ImageLoadMode mode)
+	{
+		ImageRegionReader reader;
+		if (!reader.OpenNative(filepath, mode))
+			return false;
 
-				std::cout << "ImageLoader::Load failed to convert image to 32 bits" << std::endl;
+		m_width = reader.Width();
+		m_height = reader.Height();
+		m_format = reader.Format();
 
+		// Already laid out as we want (e.g. 8 bit grey bitmaps loaded as one channel) so use the file in place
+		if (BYTE* view{ reader.DirectView() })
+		{
+			m_data = view;
+			m_mappedFile = reader.TakeFile();
+			return true;
+		}
+
+		// Otherwise one conversion pass from the mapping into our own buffer
+		m_data = new BYTE[DataSize()];
+		m_ownsData = true;
+		if (reader.ReadRows(0, m_height, m_data))
+			return true;
+
+		Release();
+		return false;
+	}
+
+	// Attempt to load an image from the file and path provided. Returns false on error.
+	bool ImageLoader::Load(const std::string& filepath, ImageLoadMode mode, bool useBaked)
+	{
+		Release();
+
+		if (mode == ImageLoadMode::SingleChannel)
+		{
+			if (LoadNative(filepath, mode))
+				return true;
+
+			FIBITMAP* bitmap{ Decode(filepath) };
+			return bitmap && LoadSingleChannel(bitmap);
+		}
+
+		// Baked containers need no decoding or mip generation, just a map of the file
+		if (fs::path(filepath).extension() == ".btx")
+			return LoadContainer(filepath);
+
+		if (useBaked && IsBakedTextureCurrent(filepath) && LoadContainer(BakedTexturePath(filepath)))
+			return true;
+
+		// Block compressed DDS files are kept compressed rather than being decoded
+		if (LoadDDS(filepath))
+			return true;
+
+		if (LoadNative(filepath, mode))
+			return true;
+
+		FIBITMAP* bitmap{ Decode(filepath) };
+		if (!bitmap)
+			return false;
+
+		// Grab size
+		m_width = FreeImage_GetWidth(bitmap);
+		m_height = FreeImage_GetHeight(bitmap);
+
+		// 15/04/20: Rebuilt FreeImage with correct order so now RGBA so no need to swizzle.
+		// A 32 bit bitmap is therefore already in our layout, so keep it and use its bits directly
+		if (FreeImage_GetImageType(bitmap) == FIT_BITMAP && FreeImage_GetBPP(bitmap) == 32 &&
+			FreeImage_GetPitch(bitmap) == (unsigned)m_width * 4)
+		{
+			m_bitmap = bitmap;
+			m_data = FreeImage_GetBits(bitmap);
+			return true;
+		}
+
+		// Otherwise convert straight into our own buffer
+		m_data = new BYTE[DataSize()];
+		m_ownsData = true;
+		if (ConvertTo32BitsInto(bitmap, m_data))
+		{
+			FreeImage_Unload(bitmap);
+			return true;
+		}
+
+		// Unusual layout, let FreeImage convert it and keep the result
+		delete[] m_data;
+		m_data = nullptr;
+		m_ownsData = false;
+
+		FIBITMAP* bitmap32{ FreeImage_ConvertTo32Bits(bitmap) };
+		FreeImage_Unload(bitmap);
+		if (!bitmap32)
+		{
+			std::cout << "ImageLoader::Load failed to convert image to 32 bits" << std::endl;
+			m_width = m_height = 0;
+			return false;
+		}
+
+		m_bitmap = bitmap32;
+		m_data = FreeImage_GetBits(bitmap32);
+		return true;
+	}
+
+	// Decode straight into memory provided by the caller. Returns false on error.
+	bool ImageLoader::LoadInto(const std::string& filepath, BYTE* destination, size_t destinationSize)
+	{
+		Release();
+
+		if (!destination)
+			return false;
+
+		// Uncompressed BMP and TGA files convert straight from the mapped file into destination
+		ImageRegionReader reader;
+		if (reader.OpenNative(filepath))
+		{
+			m_width = reader.Width();
+			m_height = reader.Height();
+			if (destinationSize < DataSize())
+			{
+				std::cout << "ImageLoader::LoadInto destination too small for " << filepath << std::endl;
+				m_width = m_height = 0;
 				return false;
 			}
-		}		
-
-		// Get a pointer to the texture data as an array of unsigned bytes.
-		// Note: At this point bitmap32 ALWAYS holds a 32-bit colour version of our image - so we get our data from that.
-		// Also, we don't need to delete or delete[] this textureData because it's not on the heap (so attempting to do
-		// so will cause a crash) - just let it go out of scope and the memory will be returned to the stack.
-		BYTE* textureData{ FreeImage_GetBits(bitmap32) };
-
-		m_data = new GLubyte[(size_t)m_width * (size_t)m_height * 1 * 4];
-
-		// Copy to mine, Note: Freeimage data format is GL_BGRA while I need GL_RGBA
-		// Iterate through the pixels, copying the data
-		// from 'pixels' to 'bits' except in RGBA format.		
-
-		//for (int pix = 0; pix < m_width * m_height; pix++)
-		//{
-		//	m_data[pix * 4 + 0] = textureData[pix * 4 + 2];	//r = 3
-		//	m_data[pix * 4 + 1] = textureData[pix * 4 + 1];	//g = 0
-		//	m_data[pix * 4 + 2] = textureData[pix * 4 + 0];	//b = 1
-		//	m_data[pix * 4 + 3] = textureData[pix * 4 + 3];	//a = 2
-		//}
-		
-		// 15/04/20: Rebuilt FreeImage with correct order so now RGBA so no need to convert = quicker :)
-		memcpy(m_data, textureData, (size_t)m_width * (size_t)m_height * 1 * 4);
-		
-		// Unload the 32-bit colour bitmap
-		FreeImage_Unload(bitmap32);
-
-		// If we had to do a conversion to 32-bit colour, then unload the original
-		// non-32-bit-colour version of the image data too. Otherwise, bitmap32 and
-		// bitmap point at the same data, and that data's already been free'd, so
-		// don't attempt to free it again! (or we'll crash).
-		if (bitsPerPixel != 32)
+
+			if (!reader.ReadRows(0, m_height, destination))
+			{
+				std::cout << "ImageLoader::LoadInto failed to read " << filepath << std::endl;
+				m_width = m_height = 0;
+				return false;
+			}
+
+			m_data = destination;
+			return true;
+		}
+
+		FIBITMAP* bitmap{ Decode(filepath) };
+		if (!bitmap)
+			return false;
+
+		m_width = FreeImage_GetWidth(bitmap);
+		m_height = FreeImage_GetHeight(bitmap);
+
+		if (destinationSize < DataSize())
+		{
+			std::cout << "ImageLoader::LoadInto destination too small for " << filepath << std::endl;
 			FreeImage_Unload(bitmap);
+			m_width = m_height = 0;
+			return false;
+		}
+
+		bool ok{ ConvertTo32BitsInto(bitmap, destination) };
+		if (!ok)
+		{
+			FIBITMAP* bitmap32{ FreeImage_ConvertTo32Bits(bitmap) };
+			if (bitmap32)
+			{
+				ok = ConvertTo32BitsInto(bitmap32, destination);
+				FreeImage_Unload(bitmap32);
+			}
+		}
+		FreeImage_Unload(bitmap);
 
+		if (!ok)
+		{
+			std::cout << "ImageLoader::LoadInto failed to convert image to 32 bits" << std::endl;
+			m_width = m_height = 0;
+			return false;
+		}
+
+		m_data = destination;
 		return true;
 	}
 
+	// Reads just enough of the file to get the image dimensions. Returns false on error.
+	bool ImageLoader::GetImageSize(const std::string& filepath, int& width, int& height)
+	{
+		// Only the header of natively read files is touched
+		ImageRegionReader reader;
+		if (reader.OpenNative(filepath))
+		{
+			width = reader.Width();
+			height = reader.Height();
+			return true;
+		}
+
+		const FREE_IMAGE_FORMAT format{ DetermineFormat(filepath) };
+		if (format == FIF_UNKNOWN)
+			return false;
+
+		// Plugins that don't support header only loading just load the whole thing
+		FIBITMAP* bitmap{ FreeImage_Load(format, filepath.c_str(), FIF_LOAD_NOPIXELS) };
+		if (!bitmap)
+			return false;
+
+		width = FreeImage_GetWidth(bitmap);
+		height = FreeImage_GetHeight(bitmap);
+		FreeImage_Unload(bitmap);
+		return true;
+	}
+
+	// Builds the mip chain of an RGBA8 image on the CPU. Returns false if there is no data or the format isn't RGBA8
+	bool ImageLoader::GenerateMipChain(int maxLevels)
+	{
+		if (!m_data || m_format != ImageFormat::RGBA8)
+			return false;
+
+		if (MipLevelCount() > 1)
+			return true;
+
+		std::vector<ImageMipLevel> levels;
+		size_t totalSize{ 0 };
+		int width{ m_width };
+		int height{ m_height };
+		while (true)
+		{
+			const size_t size{ ImageLevelSize(width, height, m_format) };
+			levels.push_back(ImageMipLevel{ width, height, totalSize, size });
+			totalSize += size;
+
+			if ((width == 1 && height == 1) || (int)levels.size() >= maxLevels)
+				break;
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
+		}
+
+		// All levels live in one allocation, level 0 first, like the DDS and baked layouts
+		BYTE* data{ new BYTE[totalSize] };
+		memcpy(data, m_data, levels[0].size);
+		for (size_t i = 1; i < levels.size(); i++)
+		{
+			const ImageMipLevel& previous{ levels[i - 1] };
+			DownsampleRGBA(data + previous.offset, previous.width, previous.height, data + levels[i].offset, levels[i].width, levels[i].height);
+		}
+
+		const int topWidth{ m_width };
+		const int topHeight{ m_height };
+		Release();
+
+		m_width = topWidth;
+		m_height = topHeight;
+		m_data = data;
+		m_ownsData = true;
+		m_mipLevels = std::move(levels);
+		return true;
+	}
+
+	// Decodes an image on the shared loading pool
+	std::future<ImageLoader> LoadImageAsync(const std::string& filepath, ImageLoadMode mode)
+	{
+		return LoadingPool().Submit([filepath, mode]()
+		{
+			ImageLoader image;
+			image.Load(filepath, mode);
+			return image;
+		});
+	}
+
 	// Attempt to save an image to the file and path provided. Returns false on error.
 	// Assumes RGBA 32 bit format. Therefore data size must be width * height * 4
 	// Creates a .png file so you don't need to add an extension to filepath
@@ -1,19 +1,97 @@
 #pragma once
 
 #include "ExternalLibraryHeaders.h"
+#include "MappedFile.h"
+#include <future>
 
 namespace Helpers
 {
+	// Layout of the data held by an ImageLoader
+	enum class ImageFormat
+	{
+		RGBA8,		// 8 bits per channel RGBA
+		BC1,		// Block compressed (DXT1), 8 bytes per 4x4 block
+		BC2,		// Block compressed (DXT3), 16 bytes per 4x4 block
+		BC3,		// Block compressed (DXT5), 16 bytes per 4x4 block
+		R8,			// Single 8 bit channel
+		R16,		// Single 16 bit unsigned channel, e.g. DEM heightmaps
+		R32F		// Single 32 bit float channel
+	};
+
+	// How Load lays out what it decodes
+	enum class ImageLoadMode
+	{
+		// Everything converted to 32 bit RGBA
+		RGBA,
+
+		// One channel kept at the source precision: 16 bit grey scale gives R16, float images R32F and everything
+		// else R8. Colour sources keep their red channel. Meant for heightmaps, a quarter of the memory of RGBA
+		SingleChannel
+	};
+
+	// Bytes per texel of an uncompressed format, 0 for the block compressed ones
+	int BytesPerTexel(ImageFormat format);
+
+	// Bytes taken by one mip level of the given size and format
+	size_t ImageLevelSize(int width, int height, ImageFormat format);
+
+	// Location of one mip level within an image's data
+	struct ImageMipLevel
+	{
+		int width{ 0 };
+		int height{ 0 };
+		size_t offset{ 0 };
+		size_t size{ 0 };
+	};
+
 	// Helper utilising FreeImage to load images / textures
-	// Loaded format is guaranteed to be 32 bit RGBA layout
+	// Loaded format is 32 bit RGBA layout (or one channel with ImageLoadMode::SingleChannel), except for block compressed
+	// DDS files which are kept compressed with their full mip chain so they can be uploaded as is (see Format())
+	// Baked .btx containers (see TextureContainer.h) are memory mapped and used in place instead of decoding the source
+	// Uncompressed BMP and TGA files skip FreeImage, they are converted from a mapping of the file in one pass
+	// Can be moved (e.g. stored in containers or returned from functions) but not copied
 	class ImageLoader
 	{
 	private:
 		int m_width{ 0 };
 		int m_height{ 0 };
 		BYTE* m_data{ nullptr };
+
+		// Where m_data lives. When the decoded bitmap is already 32 bit we keep it and point straight at
+		// its bits rather than copying them out. Baked containers point into the mapped file.
+		// Otherwise m_data is either new[]'d by us or owned by the caller
+		FIBITMAP* m_bitmap{ nullptr };
+		MappedFile m_mappedFile;
+		bool m_ownsData{ false };
+
+		ImageFormat m_format{ ImageFormat::RGBA8 };
+
+		// Only filled for formats that store mips in the file, otherwise the data is just level 0
+		std::vector<ImageMipLevel> m_mipLevels;
+
+		void Release();
+
+		// Native DDS reader. Returns false if the file is not a DDS this can handle, so FreeImage should decode it instead
+		bool LoadDDS(const std::string& filepath);
+
+		// Maps a .btx file and points the image at its levels. Returns false if the file is missing or not valid
+		bool LoadContainer(const std::string& filepath);
+
+		// Keeps one channel of bitmap at the source precision. Always unloads bitmap. Returns false on error.
+		bool LoadSingleChannel(FIBITMAP* bitmap);
+
+		// Reads uncompressed BMP, TGA and raw files straight from a mapping of the file (see ImageRegionReader).
+		// Returns false if the file is not one of those, so FreeImage should decode it instead
+		bool LoadNative(const std::string& filepath, ImageLoadMode mode);
 	public:
-		~ImageLoader() { delete []m_data; }
+		ImageLoader() = default;
+		~ImageLoader() { Release(); }
+
+		ImageLoader(const ImageLoader&) = delete;
+		ImageLoader& operator=(const ImageLoader&) = delete;
+
+		ImageLoader(ImageLoader&& other) noexcept;
+		ImageLoader& operator=(ImageLoader&& other) noexcept;
 
 		// Width in texels of the image
 		int Width() const { return m_width; }
@@ -21,16 +99,57 @@ namespace Helpers
 		// Height in texels of the image
 		int Height() const { return m_height; }
 
+		// Layout of the data
+		ImageFormat Format() const { return m_format; }
+
+		// True for the block compressed formats
+		bool IsCompressed() const { return m_format == ImageFormat::BC1 || m_format == ImageFormat::BC2 || m_format == ImageFormat::BC3; }
+
+		// Number of mip levels held, at least 1 once loaded
+		int MipLevelCount() const { return m_mipLevels.empty() ? 1 : (int)m_mipLevels.size(); }
+
+		// Size and position within GetData() of a mip level
+		ImageMipLevel GetMipLevel(int level) const {
+			return m_mipLevels.empty() ? ImageMipLevel{ m_width, m_height, 0, DataSize() } : m_mipLevels[level];
+		}
+
+		// Size in bytes of all the data
+		size_t DataSize() const {
+			return m_mipLevels.empty() ? ImageLevelSize(m_width, m_height, m_format) : m_mipLevels.back().offset + m_mipLevels.back().size;
+		}
+
 		// Attempt to load an image from the file and path provided. Returns false on error.
-		bool Load(const std::string& filepath);
+		// If useBaked is true and an up to date baked container exists for the file it is mapped instead (RGBA mode only)
+		bool Load(const std::string& filepath, ImageLoadMode mode = ImageLoadMode::RGBA, bool useBaked = true);
+
+		// Decode straight into memory provided by the caller e.g. a mapped pixel buffer, with no intermediate copy.
+		// destinationSize must be at least width * height * 4 (see GetImageSize). The caller keeps ownership of destination
+		// and must keep it alive while this loader's data is used. Returns false on error.
+		bool LoadInto(const std::string& filepath, BYTE* destination, size_t destinationSize);
 
-		// Allows access to the raw bytes that make up the image laid out in RGBA format (8 bits per channel)
+		// Reads just enough of the file to get the image dimensions. Returns false on error.
+		static bool GetImageSize(const std::string& filepath, int& width, int& height);
+
+		// Allows access to the raw bytes that make up the image laid out in RGBA format (8 bits per channel),
+		// one channel for the single channel formats or, for compressed formats, the blocks of each mip level one after the other
 		BYTE* GetData() const { return m_data; }
 
-		// Returns a grey scale value at provided uv, useful for RMA textures
+		// Builds the mip chain of an RGBA8 image on the CPU with a 2x2 box filter, at most maxLevels levels in all,
+		// e.g. so levels can be uploaded separately. Images that already have mips are left alone.
+		// Returns false if there is no data or the format isn't RGBA8
+		bool GenerateMipChain(int maxLevels = 16);
+
+		// Returns a grey scale value at provided uv, useful for RMA textures. Returns 0 for compressed images.
+		// One nearest lookup per call, use a TexelSampler to sample many UVs or to filter
+		// R16 is scaled down to 0-255 and R32F clamped to it
 		BYTE GetGreyValue(float u, float v) const;
 	};
 
+	// Decodes an image on the shared loading pool so several images can be decoded at once.
+	// On error the resulting loader has no data (GetData() returns nullptr).
+	// Only the decode happens on the pool, creating the OpenGL texture must still be done on the context thread.
+	std::future<ImageLoader> LoadImageAsync(const std::string& filepath, ImageLoadMode mode = ImageLoadMode::RGBA);
+
 	// Saves an image to the file and path provided. Returns false on error.
 	// Assumes RGBA 32 bit format. Therefore data size must be width * height * 4
 	// Creates a .png file so you don't add an extension to the passed in filepath
@@ -0,0 +1,273 @@
+// Native reader for block compressed DDS files
+// Keeps the blocks and mip chain exactly as stored so they can go straight to glCompressedTexImage2D
+#include "ImageLoader.h"
+#include <fstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	// DDS file layout, see https://docs.microsoft.com/en-us/windows/win32/direct3ddds/dds-header
+	struct DDSPixelFormat
+	{
+		UINT32 size;
+		UINT32 flags;
+		UINT32 fourCC;
+		UINT32 rgbBitCount;
+		UINT32 redMask;
+		UINT32 greenMask;
+		UINT32 blueMask;
+		UINT32 alphaMask;
+	};
+
+	struct DDSHeader
+	{
+		UINT32 size;
+		UINT32 flags;
+		UINT32 height;
+		UINT32 width;
+		UINT32 pitchOrLinearSize;
+		UINT32 depth;
+		UINT32 mipMapCount;
+		UINT32 reserved1[11];
+		DDSPixelFormat pixelFormat;
+		UINT32 caps;
+		UINT32 caps2;
+		UINT32 caps3;
+		UINT32 caps4;
+		UINT32 reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		UINT32 dxgiFormat;
+		UINT32 resourceDimension;
+		UINT32 miscFlag;
+		UINT32 arraySize;
+		UINT32 miscFlags2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header must match the file layout");
+
+	constexpr UINT32 MakeFourCC(char a, char b, char c, char d)
+	{
+		return (UINT32)(BYTE)a | ((UINT32)(BYTE)b << 8) | ((UINT32)(BYTE)c << 16) | ((UINT32)(BYTE)d << 24);
+	}
+
+	constexpr UINT32 kDDSMagic{ MakeFourCC('D', 'D', 'S', ' ') };
+	constexpr UINT32 kDDSFlagMipMapCount{ 0x20000 };
+	constexpr UINT32 kDDSPixelFormatFourCC{ 0x4 };
+	constexpr UINT32 kDDSCaps2CubeMap{ 0x200 };
+	constexpr UINT32 kDDSCaps2Volume{ 0x200000 };
+	constexpr UINT32 kDX10MiscTextureCube{ 0x4 };
+
+	// Bytes per 4x4 block
+	static size_t BlockSize(ImageFormat format)
+	{
+		return format == ImageFormat::BC1 ? 8 : 16;
+	}
+
+	// DDS stores the top row first but OpenGL expects the bottom row first (as FreeImage gives us), so blocks
+	// are flipped on load. Only the rows that exist are flipped, e.g. the first 2 for a 2 texel high mip.
+	static void FlipColourBlock(BYTE* block, int rows)
+	{
+		// 4 bytes of colour end points then one byte of 2 bit indices per row
+		BYTE flipped[4];
+		for (int r = 0; r < rows; r++)
+			flipped[r] = block[4 + rows - 1 - r];
+		memcpy(block + 4, flipped, rows);
+	}
+
+	static void FlipExplicitAlphaBlock(BYTE* block, int rows)
+	{
+		// 2 bytes of 4 bit alpha per row
+		UINT16 flipped[4];
+		for (int r = 0; r < rows; r++)
+			memcpy(&flipped[r], block + (rows - 1 - r) * 2, 2);
+		memcpy(block, flipped, (size_t)rows * 2);
+	}
+
+	static void FlipInterpolatedAlphaBlock(BYTE* block, int rows)
+	{
+		// 2 bytes of alpha end points then 48 bits of 3 bit indices, 12 bits per row
+		unsigned long long bits{ 0 };
+		for (int i = 0; i < 6; i++)
+			bits |= (unsigned long long)block[2 + i] << (8 * i);
+
+		unsigned long long flipped{ bits };
+		for (int r = 0; r < rows; r++)
+		{
+			const unsigned long long row{ (bits >> (12 * (rows - 1 - r))) & 0xfff };
+			flipped &= ~(0xfffULL << (12 * r));
+			flipped |= row << (12 * r);
+		}
+
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = (BYTE)(flipped >> (8 * i));
+	}
+
+	static void FlipLevel(BYTE* data, const ImageMipLevel& level, ImageFormat format)
+	{
+		const size_t blockSize{ BlockSize(format) };
+		const size_t blocksX{ (size_t)std::max(1, (level.width + 3) / 4) };
+		const size_t blocksY{ (size_t)std::max(1, (level.height + 3) / 4) };
+		const size_t rowBytes{ blocksX * blockSize };
+		const int rowsPerBlock{ std::min(level.height, 4) };
+
+		// Reverse the order of the rows of blocks
+		std::vector<BYTE> temp(rowBytes);
+		for (size_t y = 0; y < blocksY / 2; y++)
+		{
+			BYTE* a{ data + y * rowBytes };
+			BYTE* b{ data + (blocksY - 1 - y) * rowBytes };
+			memcpy(temp.data(), a, rowBytes);
+			memcpy(a, b, rowBytes);
+			memcpy(b, temp.data(), rowBytes);
+		}
+
+		// Then the texel rows within each block
+		for (size_t i = 0; i < blocksX * blocksY; i++)
+		{
+			BYTE* block{ data + i * blockSize };
+			switch (format)
+			{
+			case ImageFormat::BC1:
+				FlipColourBlock(block, rowsPerBlock);
+				break;
+			case ImageFormat::BC2:
+				FlipExplicitAlphaBlock(block, rowsPerBlock);
+				FlipColourBlock(block + 8, rowsPerBlock);
+				break;
+			case ImageFormat::BC3:
+				FlipInterpolatedAlphaBlock(block, rowsPerBlock);
+				FlipColourBlock(block + 8, rowsPerBlock);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	// Native DDS reader. Returns false if the file is not a DDS this can handle, so FreeImage should decode it instead
+	bool ImageLoader::LoadDDS(const std::string& filepath)
+	{
+		std::string extension{ fs::path(filepath).extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+		if (extension != ".dds")
+			return false;
+
+		std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return false;
+
+		const size_t fileSize{ (size_t)file.tellg() };
+		file.seekg(0);
+
+		UINT32 magic{ 0 };
+		DDSHeader header{};
+		file.read((char*)&magic, sizeof(magic));
+		file.read((char*)&header, sizeof(header));
+		if (!file || magic != kDDSMagic || header.size != sizeof(DDSHeader))
+			return false;
+
+		// Cube maps and volumes are left to FreeImage
+		if (header.caps2 & (kDDSCaps2CubeMap | kDDSCaps2Volume))
+			return false;
+
+		if (!(header.pixelFormat.flags & kDDSPixelFormatFourCC))
+			return false;
+
+		ImageFormat format;
+		switch (header.pixelFormat.fourCC)
+		{
+		case MakeFourCC('D', 'X', 'T', '1'):
+			format = ImageFormat::BC1;
+			break;
+		case MakeFourCC('D', 'X', 'T', '3'):
+			format = ImageFormat::BC2;
+			break;
+		case MakeFourCC('D', 'X', 'T', '5'):
+			format = ImageFormat::BC3;
+			break;
+		case MakeFourCC('D', 'X', '1', '0'):
+		{
+			DDSHeaderDX10 dx10{};
+			file.read((char*)&dx10, sizeof(dx10));
+			if (!file || dx10.arraySize > 1 || (dx10.miscFlag & kDX10MiscTextureCube))
+				return false;
+
+			// DXGI_FORMAT_BC1_UNORM, BC2, BC3. The _SRGB variants (72, 75, 78) are refused as textures are
+			// uploaded with linear internal formats, they would come out too bright
+			if (dx10.dxgiFormat == 71)
+				format = ImageFormat::BC1;
+			else if (dx10.dxgiFormat == 74)
+				format = ImageFormat::BC2;
+			else if (dx10.dxgiFormat == 77)
+				format = ImageFormat::BC3;
+			else
+				return false;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		const int width{ (int)header.width };
+		const int height{ (int)header.height };
+
+		if (width <= 0 || height <= 0)
+			return false;
+
+		int numLevels{ (header.flags & kDDSFlagMipMapCount) && header.mipMapCount > 0 ? (int)header.mipMapCount : 1 };
+
+		// Work out where each level lives, dropping any the file is too short to hold or that can't be flipped
+		const size_t dataStart{ (size_t)file.tellg() };
+		const size_t blockSize{ BlockSize(format) };
+		std::vector<ImageMipLevel> levels;
+		size_t offset{ 0 };
+		int levelWidth{ width };
+		int levelHeight{ height };
+		for (int i = 0; i < numLevels; i++)
+		{
+			// Flipping only works on whole blocks or single partial blocks. The chain stops at the first level
+			// that is neither, if that is the top level the file is decoded by FreeImage instead
+			if (levelHeight > 4 && levelHeight % 4 != 0)
+				break;
+
+			const size_t size{ (size_t)std::max(1, (levelWidth + 3) / 4) * (size_t)std::max(1, (levelHeight + 3) / 4) * blockSize };
+			if (dataStart + offset + size > fileSize)
+				break;
+
+			levels.push_back(ImageMipLevel{ levelWidth, levelHeight, offset, size });
+			offset += size;
+
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+			levelWidth = std::max(1, levelWidth / 2);
+			levelHeight = std::max(1, levelHeight / 2);
+		}
+
+		if (levels.empty())
+			return false;
+
+		BYTE* data{ new BYTE[offset] };
+		file.read((char*)data, offset);
+		if (!file)
+		{
+			delete[] data;
+			return false;
+		}
+
+		for (const ImageMipLevel& level : levels)
+			FlipLevel(data + level.offset, level, format);
+
+		m_width = width;
+		m_height = height;
+		m_data = data;
+		m_ownsData = true;
+		m_format = format;
+		m_mipLevels = std::move(levels);
+
+		return true;
+	}
+}
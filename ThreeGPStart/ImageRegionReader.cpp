@@ -0,0 +1,449 @@
+#include "ImageRegionReader.h"
+#include "PixelConvert.h"
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	// BMP and TGA file layouts. Both are packed little endian, see
+	// https://docs.microsoft.com/en-us/windows/win32/gdi/bitmap-storage and the Truevision TGA specification
+#pragma pack(push, 1)
+	struct BMPFileHeader
+	{
+		UINT16 type;
+		UINT32 size;
+		UINT16 reserved1;
+		UINT16 reserved2;
+		UINT32 pixelOffset;
+	};
+
+	struct BMPInfoHeader
+	{
+		UINT32 size;
+		INT32 width;
+		INT32 height;
+		UINT16 planes;
+		UINT16 bitCount;
+		UINT32 compression;
+		UINT32 imageSize;
+		INT32 xPixelsPerMeter;
+		INT32 yPixelsPerMeter;
+		UINT32 coloursUsed;
+		UINT32 coloursImportant;
+	};
+
+	struct TGAHeader
+	{
+		BYTE idLength;
+		BYTE colourMapType;
+		BYTE imageType;
+		UINT16 colourMapFirst;
+		UINT16 colourMapLength;
+		BYTE colourMapEntryBits;
+		UINT16 xOrigin;
+		UINT16 yOrigin;
+		UINT16 width;
+		UINT16 height;
+		BYTE bitsPerPixel;
+		BYTE descriptor;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(BMPFileHeader) == 14, "BMP file header must match the file layout");
+	static_assert(sizeof(BMPInfoHeader) == 40, "BMP info header must match the file layout");
+	static_assert(sizeof(TGAHeader) == 18, "TGA header must match the file layout");
+
+	constexpr UINT32 kBMPUncompressed{ 0 };
+	constexpr UINT32 kBMPBitFields{ 3 };
+
+	constexpr BYTE kTGAColourMapped{ 1 };
+	constexpr BYTE kTGATrueColour{ 2 };
+	constexpr BYTE kTGAGrey{ 3 };
+	constexpr BYTE kTGATopToBottom{ 0x20 };
+	constexpr BYTE kTGARightToLeft{ 0x10 };
+
+	ImageRegionReader::ImageRegionReader(ImageRegionReader&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	ImageRegionReader& ImageRegionReader::operator=(ImageRegionReader&& other) noexcept
+	{
+		if (this != &other)
+		{
+			// Pointers into the mapping or the decoded image stay valid, the memory itself doesn't move
+			m_file = std::move(other.m_file);
+			m_decoded = std::move(other.m_decoded);
+			m_mode = other.m_mode;
+			m_format = other.m_format;
+			m_layout = other.m_layout;
+			m_width = other.m_width;
+			m_height = other.m_height;
+			m_bottomRow = other.m_bottomRow;
+			m_rowStride = other.m_rowStride;
+			memcpy(m_palette, other.m_palette, sizeof(m_palette));
+			other.Close();
+		}
+		return *this;
+	}
+
+	void ImageRegionReader::Close()
+	{
+		m_file.Close();
+		m_decoded = ImageLoader();
+		m_width = m_height = 0;
+		m_bottomRow = nullptr;
+		m_rowStride = 0;
+	}
+
+	// Points the reader at rows stored rowBytes apart from offset, checking they are all inside the file
+	static bool LocateRows(const MappedFile& file, size_t offset, size_t rowBytes, int height, bool topDown,
+		const BYTE*& bottomRow, ptrdiff_t& rowStride)
+	{
+		if (offset > file.Size() || rowBytes * height > file.Size() - offset)
+			return false;
+
+		const BYTE* first{ file.Data() + offset };
+		if (topDown)
+		{
+			bottomRow = first + rowBytes * (height - 1);
+			rowStride = -(ptrdiff_t)rowBytes;
+		}
+		else
+		{
+			bottomRow = first;
+			rowStride = (ptrdiff_t)rowBytes;
+		}
+		return true;
+	}
+
+	// True if the palette is a plain 0-255 grey ramp, the same test FreeImage uses for FIC_MINISBLACK
+	static bool IsGreyRamp(const UINT32* palette)
+	{
+		for (UINT32 i = 0; i < 256; i++)
+		{
+			if (palette[i] != (0xFF000000 | i << 16 | i << 8 | i))
+				return false;
+		}
+		return true;
+	}
+
+	// Uncompressed 8, 24 and 32 bit Windows bitmaps
+	bool ImageRegionReader::OpenBMP()
+	{
+		const size_t minSize{ sizeof(BMPFileHeader) + sizeof(BMPInfoHeader) };
+		if (m_file.Size() < minSize)
+			return false;
+
+		BMPFileHeader fileHeader;
+		BMPInfoHeader info;
+		memcpy(&fileHeader, m_file.Data(), sizeof(fileHeader));
+		memcpy(&info, m_file.Data() + sizeof(fileHeader), sizeof(info));
+
+		// 'BM'. Older OS/2 headers are smaller and left to FreeImage
+		if (fileHeader.type != 0x4D42 || info.size < sizeof(BMPInfoHeader) || info.width <= 0 || info.height == 0)
+			return false;
+
+		// Colour masks directly follow the 40 byte header, or are part of the larger V4 / V5 headers
+		const BYTE* masks{ m_file.Data() + minSize };
+		switch (info.bitCount)
+		{
+		case 8:
+		{
+			if (info.compression != kBMPUncompressed)
+				return false;
+
+			const UINT32 numColours{ info.coloursUsed == 0 ? 256 : std::min(info.coloursUsed, 256u) };
+			const size_t paletteOffset{ sizeof(fileHeader) + info.size };
+			if (paletteOffset + numColours * 4 > m_file.Size())
+				return false;
+
+			// Stored as BGRX
+			memset(m_palette, 0, sizeof(m_palette));
+			const BYTE* entry{ m_file.Data() + paletteOffset };
+			for (UINT32 i = 0; i < numColours; i++, entry += 4)
+				m_palette[i] = 0xFF000000 | (UINT32)entry[0] << 16 | (UINT32)entry[1] << 8 | entry[2];
+
+			m_layout = IsGreyRamp(m_palette) ? RasterLayout::Grey8 : RasterLayout::Palette8;
+			break;
+		}
+		case 24:
+			if (info.compression != kBMPUncompressed)
+				return false;
+			m_layout = RasterLayout::BGR24;
+			break;
+		case 32:
+			// The top byte is unused in plain 32 bit bitmaps, only bit field ones can say it is alpha
+			if (info.compression == kBMPUncompressed)
+			{
+				m_layout = RasterLayout::BGRX32;
+				break;
+			}
+
+			if (info.compression == kBMPBitFields && m_file.Size() >= minSize + 16)
+			{
+				UINT32 mask[4];
+				memcpy(mask, masks, sizeof(mask));
+				if (mask[0] != 0x00FF0000 || mask[1] != 0x0000FF00 || mask[2] != 0x000000FF)
+					return false;
+
+				// Only headers bigger than the basic one carry an alpha mask
+				m_layout = (info.size > sizeof(BMPInfoHeader) && mask[3] == 0xFF000000) ? RasterLayout::BGRA32 : RasterLayout::BGRX32;
+				break;
+			}
+			return false;
+		default:
+			return false;
+		}
+
+		m_width = info.width;
+		m_height = std::abs(info.height);
+
+		// Rows are padded to 4 bytes. A negative height means the rows are stored top down
+		const size_t rowBytes{ ((size_t)m_width * info.bitCount + 31) / 32 * 4 };
+		return LocateRows(m_file, fileHeader.pixelOffset, rowBytes, m_height, info.height < 0, m_bottomRow, m_rowStride);
+	}
+
+	// Uncompressed true colour, grey scale and 8 bit colour mapped targas
+	bool ImageRegionReader::OpenTGA()
+	{
+		if (m_file.Size() < sizeof(TGAHeader))
+			return false;
+
+		TGAHeader header;
+		memcpy(&header, m_file.Data(), sizeof(header));
+
+		if (header.width == 0 || header.height == 0 || header.colourMapType > 1 || (header.descriptor & kTGARightToLeft))
+			return false;
+
+		const size_t colourMapBytes{ header.colourMapType == 1 ? (size_t)header.colourMapLength * ((header.colourMapEntryBits + 7) / 8) : 0 };
+		const size_t colourMapOffset{ sizeof(TGAHeader) + header.idLength };
+
+		if (header.imageType == kTGATrueColour && header.bitsPerPixel == 24)
+			m_layout = RasterLayout::BGR24;
+		else if (header.imageType == kTGATrueColour && header.bitsPerPixel == 32)
+			m_layout = RasterLayout::BGRA32;
+		else if (header.imageType == kTGAGrey && header.bitsPerPixel == 8)
+			m_layout = RasterLayout::Grey8;
+		else if (header.imageType == kTGAColourMapped && header.colourMapType == 1 && header.bitsPerPixel == 8 &&
+			(header.colourMapEntryBits == 24 || header.colourMapEntryBits == 32) && header.colourMapFirst == 0 &&
+			header.colourMapLength <= 256 && colourMapOffset + colourMapBytes <= m_file.Size())
+		{
+			// Stored as BGR or BGRA
+			memset(m_palette, 0, sizeof(m_palette));
+			const int entryBytes{ header.colourMapEntryBits / 8 };
+			const BYTE* entry{ m_file.Data() + colourMapOffset };
+			for (int i = 0; i < header.colourMapLength; i++, entry += entryBytes)
+			{
+				const UINT32 alpha{ entryBytes == 4 ? entry[3] : 255u };
+				m_palette[i] = alpha << 24 | (UINT32)entry[0] << 16 | (UINT32)entry[1] << 8 | entry[2];
+			}
+			m_layout = RasterLayout::Palette8;
+		}
+		else
+			return false;
+
+		m_width = header.width;
+		m_height = header.height;
+
+		const size_t rowBytes{ (size_t)m_width * header.bitsPerPixel / 8 };
+		return LocateRows(m_file, colourMapOffset + colourMapBytes, rowBytes, m_height,
+			(header.descriptor & kTGATopToBottom) != 0, m_bottomRow, m_rowStride);
+	}
+
+	// Headerless square heightmaps as exported by most terrain tools, rows stored top down.
+	// The size comes from the file length. 16 bit values are little endian
+	bool ImageRegionReader::OpenRaw(const std::string& extension)
+	{
+		m_layout = extension == ".r16" ? RasterLayout::Grey16 : RasterLayout::Grey8;
+		const size_t texelBytes{ m_layout == RasterLayout::Grey16 ? 2u : 1u };
+		const size_t numTexels{ m_file.Size() / texelBytes };
+
+		const size_t side{ (size_t)std::llround(std::sqrt((double)numTexels)) };
+		if (side == 0 || side > INT_MAX || side * side * texelBytes != m_file.Size())
+		{
+			std::cout << "Raw heightmaps must be square" << std::endl;
+			return false;
+		}
+
+		m_width = m_height = (int)side;
+		return LocateRows(m_file, 0, side * texelBytes, m_height, true, m_bottomRow, m_rowStride);
+	}
+
+	// Open for the natively read formats only, returns false for anything that would need decoding
+	bool ImageRegionReader::OpenNative(const std::string& filepath, ImageLoadMode mode)
+	{
+		Close();
+		m_mode = mode;
+
+		std::string extension{ fs::path(filepath).extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+		// TGA and raw files have no signature so go by the extension. Don't map files that can't be read here
+		const bool readable{ extension == ".bmp" || extension == ".tga" || extension == ".raw" || extension == ".r16" };
+		if (!readable || !m_file.Open(filepath))
+			return false;
+
+		const bool native{ OpenBMP() || (extension == ".tga" && OpenTGA()) ||
+			((extension == ".raw" || extension == ".r16") && OpenRaw(extension)) };
+
+		if (!native)
+		{
+			Close();
+			return false;
+		}
+
+		if (mode == ImageLoadMode::SingleChannel)
+			m_format = m_layout == RasterLayout::Grey16 ? ImageFormat::R16 : ImageFormat::R8;
+		else
+			m_format = ImageFormat::RGBA8;
+		return true;
+	}
+
+	// Reads the header (or decodes everything for formats with no native reader). Returns false on error.
+	bool ImageRegionReader::Open(const std::string& filepath, ImageLoadMode mode)
+	{
+		if (OpenNative(filepath, mode))
+			return true;
+
+		// Compressed or unusual layouts, decode the lot
+		if (!m_decoded.Load(filepath, mode, false))
+			return false;
+
+		if (m_decoded.IsCompressed())
+		{
+			std::cout << "ImageRegionReader can't read block compressed images: " << filepath << std::endl;
+			m_decoded = ImageLoader();
+			return false;
+		}
+
+		m_width = m_decoded.Width();
+		m_height = m_decoded.Height();
+		m_format = m_decoded.Format();
+		m_bottomRow = m_decoded.GetData();
+		m_rowStride = (ptrdiff_t)m_width * BytesPerTexel(m_format);
+		return true;
+	}
+
+	// Converts width texels of one source row starting at column x into the output format
+	void ImageRegionReader::ConvertRow(const BYTE* sourceRow, int x, int width, BYTE* destination) const
+	{
+		// Decoded up front so already in the output format
+		if (!m_file.IsOpen())
+		{
+			const int texelBytes{ BytesPerTexel(m_format) };
+			memcpy(destination, sourceRow + (size_t)x * texelBytes, (size_t)width * texelBytes);
+			return;
+		}
+
+		const bool rgba{ m_mode == ImageLoadMode::RGBA };
+		switch (m_layout)
+		{
+		case RasterLayout::Grey8:
+			if (rgba)
+				GreyToRGBA(sourceRow + x, destination, width);
+			else
+				memcpy(destination, sourceRow + x, width);
+			break;
+		case RasterLayout::Grey16:
+			if (rgba)
+				Grey16ToRGBA((const UINT16*)sourceRow + x, destination, width);
+			else
+				memcpy(destination, sourceRow + (size_t)x * 2, (size_t)width * 2);
+			break;
+		case RasterLayout::Palette8:
+		{
+			// Single channel keeps the red entry like ImageLoader
+			const BYTE* source{ sourceRow + x };
+			if (rgba)
+			{
+				for (int i = 0; i < width; i++)
+					memcpy(destination + (size_t)i * 4, &m_palette[source[i]], 4);
+			}
+			else
+			{
+				for (int i = 0; i < width; i++)
+					destination[i] = (BYTE)m_palette[source[i]];
+			}
+			break;
+		}
+		case RasterLayout::BGR24:
+		{
+			const BYTE* source{ sourceRow + (size_t)x * 3 };
+			if (rgba)
+			{
+				RGBToRGBA(source, destination, width);
+				SwapRedBlue(destination, destination, width);
+			}
+			else
+			{
+				for (int i = 0; i < width; i++)
+					destination[i] = source[i * 3 + 2];
+			}
+			break;
+		}
+		case RasterLayout::BGRA32:
+		case RasterLayout::BGRX32:
+		{
+			const BYTE* source{ sourceRow + (size_t)x * 4 };
+			if (!rgba)
+			{
+				ExtractChannel(source, destination, width, 2);
+				break;
+			}
+
+			SwapRedBlue(source, destination, width);
+			if (m_layout == RasterLayout::BGRX32)
+			{
+				for (int i = 0; i < width; i++)
+					destination[i * 4 + 3] = 255;
+			}
+			break;
+		}
+		}
+	}
+
+	// Decodes the width x height texels with their bottom left corner at (x, y) into destination. Returns false on error
+	bool ImageRegionReader::ReadRegion(int x, int y, int width, int height, BYTE* destination, size_t destinationPitch) const
+	{
+		if (!IsOpen() || !destination || x < 0 || y < 0 || width <= 0 || height <= 0 ||
+			width > m_width - x || height > m_height - y || destinationPitch < (size_t)width * BytesPerTexel(m_format))
+		{
+			return false;
+		}
+
+		// Only the rows asked for are touched, so only their pages of the file are read in
+		ConvertImageRows(height, [=](int row)
+		{
+			ConvertRow(m_bottomRow + (ptrdiff_t)(y + row) * m_rowStride, x, width, destination + destinationPitch * row);
+		});
+		return true;
+	}
+
+	// Decodes rowCount whole rows from firstRow (counting from the bottom) tightly packed into destination
+	bool ImageRegionReader::ReadRows(int firstRow, int rowCount, BYTE* destination) const
+	{
+		return ReadRegion(0, firstRow, m_width, rowCount, destination, (size_t)m_width * BytesPerTexel(m_format));
+	}
+
+	// The texels in place in the mapped file when they are already exactly what reads would produce, otherwise nullptr
+	BYTE* ImageRegionReader::DirectView() const
+	{
+		if (!m_file.IsOpen() || m_rowStride != (ptrdiff_t)m_width * BytesPerTexel(m_format))
+			return nullptr;
+
+		const bool matches{ m_mode == ImageLoadMode::SingleChannel ?
+			(m_layout == RasterLayout::Grey8 || m_layout == RasterLayout::Grey16) : false };
+
+		// Points into m_file's copy on write view, so handing out a writable pointer is safe
+		return matches ? const_cast<BYTE*>(m_bottomRow) : nullptr;
+	}
+
+	// Hands over the mapping. Closes the reader
+	MappedFile ImageRegionReader::TakeFile()
+	{
+		MappedFile file{ std::move(m_file) };
+		Close();
+		return file;
+	}
+}
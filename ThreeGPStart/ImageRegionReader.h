@@ -0,0 +1,98 @@
+#pragma once
+// Reads rectangles or runs of rows out of an image without decoding the rest of it, for sources such as large DEMs
+// and satellite images that are too big to load whole. Meant as the building block for paging terrain in.
+//
+// Uncompressed BMP and TGA files and headerless .raw (8 bit) / .r16 (16 bit) square heightmaps are memory mapped
+// and each read only touches the rows it needs, so memory use is bounded by what is read rather than the image size.
+// Anything else falls back to decoding the whole image with ImageLoader when opened.
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+#include "MappedFile.h"
+
+namespace Helpers
+{
+	// Layouts the native readers understand, as they are stored in the file
+	enum class RasterLayout
+	{
+		Grey8,
+		Grey16,
+		Palette8,
+		BGR24,
+		BGRA32,
+		BGRX32		// 32 bit with the top byte unused, as in most 32 bit BMPs
+	};
+
+	// Can be moved but not copied. Reads are const and may be made from several threads at once
+	class ImageRegionReader
+	{
+	private:
+		MappedFile m_file;
+
+		// Fallback for formats with no native reader
+		ImageLoader m_decoded;
+
+		ImageLoadMode m_mode{ ImageLoadMode::RGBA };
+		ImageFormat m_format{ ImageFormat::RGBA8 };
+		RasterLayout m_layout{ RasterLayout::BGRA32 };
+		int m_width{ 0 };
+		int m_height{ 0 };
+
+		// Bottom row of the image and the step in bytes to the row above, negative for files stored top down
+		const BYTE* m_bottomRow{ nullptr };
+		ptrdiff_t m_rowStride{ 0 };
+
+		// Palette8 entries as RGBA texels
+		UINT32 m_palette[256]{};
+
+		bool OpenBMP();
+		bool OpenTGA();
+		bool OpenRaw(const std::string& extension);
+
+		// Converts width texels of one source row starting at column x into the output format
+		void ConvertRow(const BYTE* sourceRow, int x, int width, BYTE* destination) const;
+	public:
+		ImageRegionReader() = default;
+
+		ImageRegionReader(const ImageRegionReader&) = delete;
+		ImageRegionReader& operator=(const ImageRegionReader&) = delete;
+
+		ImageRegionReader(ImageRegionReader&& other) noexcept;
+		ImageRegionReader& operator=(ImageRegionReader&& other) noexcept;
+
+		// Reads the header (or decodes everything for formats with no native reader). The mode picks the output
+		// format the same way it does for ImageLoader::Load. Returns false on error.
+		bool Open(const std::string& filepath, ImageLoadMode mode = ImageLoadMode::RGBA);
+
+		// Open for the natively read formats only, returns false for anything that would need decoding
+		bool OpenNative(const std::string& filepath, ImageLoadMode mode = ImageLoadMode::RGBA);
+
+		void Close();
+
+		bool IsOpen() const { return m_width > 0; }
+
+		// True if reads come straight from the file, false if the whole image had to be decoded up front
+		bool IsStreamed() const { return m_file.IsOpen(); }
+
+		int Width() const { return m_width; }
+		int Height() const { return m_height; }
+
+		// Format of the texels reads produce: RGBA8, or in single channel mode R8 / R16 (R32F from the fallback too)
+		ImageFormat Format() const { return m_format; }
+
+		// Decodes the width x height texels with their bottom left corner at (x, y) into destination, rows
+		// destinationPitch bytes apart. Rows are bottom up like ImageLoader's data, so y 0 is the bottom of the image.
+		// Returns false if the region is not inside the image
+		bool ReadRegion(int x, int y, int width, int height, BYTE* destination, size_t destinationPitch) const;
+
+		// Decodes rowCount whole rows from firstRow (counting from the bottom) tightly packed into destination
+		bool ReadRows(int firstRow, int rowCount, BYTE* destination) const;
+
+		// The texels in place in the mapped file when it already stores them exactly as reads would produce them
+		// (bottom up, tightly packed, in Format()), otherwise nullptr. The mapping is copy on write so may be written to
+		BYTE* DirectView() const;
+
+		// Hands over the mapping, e.g. to keep a DirectView() alive once the reader has gone. Closes the reader
+		MappedFile TakeFile();
+	};
+}
@@ -0,0 +1,84 @@
+#include "MappedFile.h"
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	MappedFile::MappedFile(MappedFile&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+
+			m_file = other.m_file;
+			m_mapping = other.m_mapping;
+			m_data = other.m_data;
+			m_size = other.m_size;
+
+			other.m_file = INVALID_HANDLE_VALUE;
+			other.m_mapping = nullptr;
+			other.m_data = nullptr;
+			other.m_size = 0;
+		}
+		return *this;
+	}
+
+	// Maps the whole file. Returns false on error or if the file is empty.
+	bool MappedFile::Open(const std::string& filepath)
+	{
+		Close();
+
+		// Go via a wide path so non ASCII file names work
+		const std::wstring widePath{ fs::path(filepath).wstring() };
+		m_file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			Close();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		if (!m_mapping)
+		{
+			Close();
+			return false;
+		}
+
+		m_data = (BYTE*)MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0);
+		if (!m_data)
+		{
+			std::cout << "MappedFile failed to map: " << filepath << std::endl;
+			Close();
+			return false;
+		}
+
+		m_size = (size_t)fileSize.QuadPart;
+		return true;
+	}
+
+	// Unmaps the file, any pointers into it become invalid
+	void MappedFile::Close()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+// Read only view of a whole file using the OS memory mapping, so pages are only read from disk when touched
+
+#include "ExternalLibraryHeaders.h"
+
+namespace Helpers
+{
+	// Can be moved but not copied. The view is unmapped when the object is destroyed
+	class MappedFile
+	{
+	private:
+		HANDLE m_file{ INVALID_HANDLE_VALUE };
+		HANDLE m_mapping{ nullptr };
+		BYTE* m_data{ nullptr };
+		size_t m_size{ 0 };
+	public:
+		MappedFile() = default;
+		~MappedFile() { Close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// Maps the whole file. Pages are copy on write so the data can be changed in memory without
+		// touching the file. Returns false on error or if the file is empty.
+		bool Open(const std::string& filepath);
+
+		// Unmaps the file, any pointers into it become invalid
+		void Close();
+
+		bool IsOpen() const { return m_data != nullptr; }
+
+		BYTE* Data() const { return m_data; }
+
+		// Size of the file in bytes
+		size_t Size() const { return m_size; }
+	};
+}
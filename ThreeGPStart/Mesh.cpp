@@ -1,17 +1,36 @@
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "Parallel.h"
+#include "ThreadPool.h"
+#include <filesystem>
+#include <iomanip>
+namespace fs = std::filesystem;
 //#include <math.h>
 //#define VERBOSE
 
-#define M_PI 3.14159265358979323846264338327950288
 #define EsAssert assert
 
 namespace Helpers
 {
+	// Mesh streams are copied straight out of ASSIMP's arrays
+	static_assert(sizeof(aiVector3D) == sizeof(glm::vec3), "ASSIMP vectors must match glm::vec3 to be block copied");
+
 	// Conversions from ASSIMP types
 	inline glm::vec4 aiColor4DToGlmVec4(aiColor4D col) { return glm::vec4(col.r, col.g, col.b, col.a); }
 	inline std::string aiStringToString(const aiString& str) { return std::string(str.C_Str()); }
 	inline glm::vec3 aiVector3DToGlmVec3(aiVector3D vec) { return glm::vec3(vec.x, vec.y, vec.z); }
 
+	// Nodes in the assimp hierarchy below and including node
+	static size_t CountNodes(const aiNode* node)
+	{
+		size_t count{ 1 };
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			count += CountNodes(node->mChildren[i]);
+		return count;
+	}
+
 	// OpenGL uses column major matrices while ASSIMP uses row major - this converts
 	inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4* from)
 	{
@@ -25,28 +44,17 @@ namespace Helpers
 		return to;
 	}
 
-	// x is roll, y is pitch, z is yaw
-	glm::vec3 aiQuaternionToEulerAngles(aiQuaternion q) {
-		glm::vec3 angles;
+	inline glm::quat aiQuaternionToGlmQuat(const aiQuaternion& q) { return glm::quat(q.w, q.x, q.y, q.z); }
 
-		// roll (x-axis rotation)
-		double sinr_cosp = 2 * (double)(q.w * (double)q.x + q.y * (double)q.z);
-		double cosr_cosp = 1 - 2 * (double)((double)q.x * q.x + (double)q.y * q.y);
-		angles.x = (float)std::atan2(sinr_cosp, cosr_cosp);
-
-		// pitch (y-axis rotation)
-		double sinp = 2 * (double)((double)q.w * q.y - (double)q.z * q.x);
-		if (std::abs(sinp) >= 1)
-			angles.y = (float)std::copysign(M_PI / 2, sinp); // use 90 degrees if out of range
-		else
-			angles.y = (float)std::asin(sinp);
-
-		// yaw (z-axis rotation)
-		double siny_cosp = 2 * (double)((double)q.w * q.z + (double)q.x * q.y);
-		double cosy_cosp = 1 - 2 * (double)((double)q.y * q.y + (double)q.z * q.z);
-		angles.z = (float)std::atan2(siny_cosp, cosy_cosp);
+	// Gives a track with no keys one holding the node's own value, so every track can be sampled
+	template <typename T>
+	static void FillEmptyTrack(std::vector<float>& times, std::vector<T>& values, const T& value)
+	{
+		if (!times.empty())
+			return;
 
-		return angles;
+		times.push_back(0.0f);
+		values.push_back(value);
 	}
 
 	// Retrieve the dimensions of this mesh in local coordinates
@@ -72,10 +80,48 @@ namespace Helpers
 	}
 
 	// Load a 3D model form a provided file and path, return false on error
-	bool ModelLoader::LoadFromFile(const std::string& objFilename)
+	bool ModelLoader::LoadFromFile(const std::string& objFilename, bool generateLods)
 	{
 		m_filename = objFilename;
 
+		// A cache made from this exact file skips importing. If only the cache was shipped it is used as is
+		const std::string cachePath{ MeshCachePath(objFilename) };
+		MeshCacheSource source{};
+		const bool haveSource{ GetMeshCacheSource(objFilename, source) };
+		if (ReadCache(cachePath, haveSource ? &source : nullptr))
+		{
+			// A cache made without levels of detail gets them the first time they are asked for
+			if (generateLods && !m_hasLods)
+			{
+				GenerateLods();
+				if (haveSource)
+					WriteCache(cachePath, source);
+			}
+			return true;
+		}
+
+		std::string extension{ fs::path(objFilename).extension().string() };
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower(c); });
+
+		// Wavefront OBJ has a much faster native reader, assimp takes everything else and any OBJ that fails it
+		const bool loaded{ extension == ".obj" && PopulateFromObjFile(objFilename) };
+		if (!loaded && !ImportWithAssimp(objFilename))
+			return false;
+
+		OptimizeMeshes();
+		if (generateLods)
+			GenerateLods();
+
+		// Not being able to write the cache only costs the next load time
+		if (haveSource)
+			WriteCache(cachePath, source);
+
+		return true;
+	}
+
+	// Loads any format assimp supports
+	bool ModelLoader::ImportWithAssimp(const std::string& objFilename)
+	{
 #if defined(VERBOSE)
 		std::cout << "\nUsing assimp to load: " << objFilename << std::endl;
 #endif
@@ -83,7 +129,6 @@ namespace Helpers
 		unsigned int ppsteps = aiProcess_CalcTangentSpace | // calculate tangents and bitangents if possible
 			aiProcess_JoinIdenticalVertices |				// join identical vertices/ optimize indexing
 			aiProcess_ValidateDataStructure |				// perform a full validation of the loader's output
-			aiProcess_ImproveCacheLocality |				// improve the cache locality of the output vertices
 			aiProcess_RemoveRedundantMaterials |			// remove redundant materials
 			aiProcess_FindDegenerates |						// remove degenerated polygons from the import
 			aiProcess_FindInvalidData |						// detect invalid model data, such as invalid normal vectors
@@ -101,8 +146,9 @@ namespace Helpers
 			aiProcess_GlobalScale |							// KD: Needed for FBX which uses cm rather than metres
 			0;
 
-		// Create an instance of the Importer class
-		Assimp::Importer importer;
+		// One importer per thread, kept between files so batch loads on the loading pool don't set up a new one
+		// each time. Every property is set again below as they carry over from the last file
+		thread_local Assimp::Importer importer;
 
 		// Buggy:
 		// https://gamedev.stackexchange.com/questions/175044/assimp-skeletal-animation-with-some-fbx-files-has-issues-weird-node-added
@@ -113,8 +159,7 @@ namespace Helpers
 		importer.SetPropertyInteger(AI_CONFIG_GLOB_MEASURE_TIME, 1);
 
 		// KD: Need to scale down FBX which uses cm rather than metres
-		if (objFilename.find(".fbx")!=std::string::npos)
-			importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, 0.01f);
+		importer.SetPropertyFloat(AI_CONFIG_GLOBAL_SCALE_FACTOR_KEY, objFilename.find(".fbx") != std::string::npos ? 0.01f : 1.0f);
 
 		const aiScene* scene = importer.ReadFile(objFilename.c_str(), ppsteps);
 
@@ -124,7 +169,10 @@ namespace Helpers
 			return false;
 		}
 
-		return PopulateFromAssimpScene(scene);
+		// The scene is only needed until it has been copied out
+		const bool populated{ PopulateFromAssimpScene(scene) };
+		importer.FreeScene();
+		return populated;
 	}
 
 	// Parse the ASSIMP data into our format
@@ -205,9 +253,13 @@ namespace Helpers
 
 		// ASSIMP mesh
 		// http://assimp.sourceforge.net/lib_html/structai_mesh.html
+		// Every mesh and stream is sized exactly once up front and filled with bulk copies, so the copy out
+		// costs a handful of allocations and memcpys per mesh rather than growing vectors element by element
+		m_meshVector.clear();
+		m_meshVector.resize(scene->mNumMeshes);
 		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
 		{
-			aiMesh* aimesh = scene->mMeshes[i];
+			const aiMesh* aimesh = scene->mMeshes[i];
 
 			if (aimesh->HasBones())
 				hasBones++;
@@ -218,49 +270,42 @@ namespace Helpers
 			if (aimesh->HasTangentsAndBitangents())
 				hasTangents++;
 
-			// Create my mesh part
-			m_meshVector.push_back(Mesh());
-			Mesh& newMesh = m_meshVector.back();
-
+			Mesh& newMesh = m_meshVector[i];
 			newMesh.name = aimesh->mName.C_Str();
 
-			//		std::cout << "Processing mesh with name: " + newMesh->name);
+			// Positions and normals have the same layout in ASSIMP as here so are copied as one block
+			const size_t numVertices{ aimesh->mNumVertices };
+			const glm::vec3* vertices{ (const glm::vec3*)aimesh->mVertices };
+			newMesh.vertices.assign(vertices, vertices + numVertices);
 
-					// Copy over all the vertices, ai format of a vertex is same as mine
-					// Probably be able to speed this all up at some point
-			for (size_t v = 0; v < aimesh->mNumVertices; v++)
-			{
-				glm::vec3 newV = *(glm::vec3*) & aimesh->mVertices[v];
-				newMesh.vertices.push_back(newV);
-			}
-
-			// And the normals if there are any
 			if (aimesh->HasNormals())
 			{
-				for (size_t v = 0; v < aimesh->mNumVertices; v++)
-				{
-					glm::vec3 newN = *(glm::vec3*) & aimesh->mNormals[v];
-					newMesh.normals.push_back(newN);
-				}
+				const glm::vec3* normals{ (const glm::vec3*)aimesh->mNormals };
+				newMesh.normals.assign(normals, normals + numVertices);
 			}
 
-			// And texture coordinates
+			// ASSIMP texture coordinates have 3 components, only the first 2 are kept
 			if (aimesh->HasTextureCoords(0))
 			{
-				for (size_t v = 0; v < aimesh->mNumVertices; v++)
-				{
-					glm::vec2 newN = *(glm::vec2*) &aimesh->mTextureCoords[0][v];
-					
-					newMesh.uvCoords.push_back(newN);
-				}
+				newMesh.uvCoords.resize(numVertices);
+				const aiVector3D* uvs{ aimesh->mTextureCoords[0] };
+				glm::vec2* out{ newMesh.uvCoords.data() };
+				for (size_t v = 0; v < numVertices; v++)
+					out[v] = glm::vec2(uvs[v].x, uvs[v].y);
 			}
 
-			// Faces contain the vertex indices and due to the flags I set before are always triangles
+			// Faces contain the vertex indices and due to the flags I set before are always triangles.
+			// Each face has its own index array so this is a gather into one exactly sized buffer
+			newMesh.elements.resize((size_t)aimesh->mNumFaces * 3);
+			unsigned int* elements{ newMesh.elements.data() };
 			for (unsigned int face = 0; face < aimesh->mNumFaces; face++)
 			{
-				EsAssert(aimesh->mFaces[face].mNumIndices == 3);
-				for (int triInd = 0; triInd < 3; triInd++)
-					newMesh.elements.push_back(aimesh->mFaces[face].mIndices[triInd]);
+				const aiFace& aiface = aimesh->mFaces[face];
+				EsAssert(aiface.mNumIndices == 3);
+				elements[0] = aiface.mIndices[0];
+				elements[1] = aiface.mIndices[1];
+				elements[2] = aiface.mIndices[2];
+				elements += 3;
 			}
 
 			// Material index
@@ -276,31 +321,43 @@ namespace Helpers
 		if (hasTangents)
 			std::cout << "Ignoring: One or more mesh has tangents" << std::endl;
 #endif
-		// Hierarchy, ASSIMP calls these nodes
-		m_rootNode = RecurseCreateNode(scene->mRootNode, nullptr);
-
+		// Hierarchy, ASSIMP calls these nodes. Adding them also indexes their names, so finding the node for
+		// each animation channel below takes constant time
+		m_nodes.Clear();
+		m_nodes.Reserve(CountNodes(scene->mRootNode));
+		RecurseCreateNode(scene->mRootNode, NodeHierarchy::kNoNode);
+
+		m_animations.clear();
+		m_animations.resize(scene->mNumAnimations);
 		for (size_t i = 0; i < scene->mNumAnimations; i++)
 		{
+			const aiAnimation* animation{ scene->mAnimations[i] };
 #if defined(VERBOSE)
 			// Only supporting node animation			
-			if (scene->mAnimations[i]->mNumMeshChannels)
+			if (animation->mNumMeshChannels)
 				std::cout << "Ignoring: mesh animations" << std::endl;
 
-			if (scene->mAnimations[i]->mNumChannels)
-				std::cout << "Animation has " + std::to_string(scene->mAnimations[i]->mNumChannels) + " Channels" << std::endl;
+			if (animation->mNumChannels)
+				std::cout << "Animation has " + std::to_string(animation->mNumChannels) + " Channels" << std::endl;
 #endif
+			AnimationClip& clip{ m_animations[i] };
+			clip.name = aiStringToString(animation->mName);
+			clip.duration = (float)animation->mDuration;
+			if (animation->mTicksPerSecond > 0)
+				clip.ticksPerSecond = (float)animation->mTicksPerSecond;
+			clip.channels.reserve(animation->mNumChannels);
 
 			// Load the channel data
-			for (unsigned int k = 0; k < scene->mAnimations[i]->mNumChannels; k++)
+			for (unsigned int k = 0; k < animation->mNumChannels; k++)
 			{
-				aiNodeAnim* node = scene->mAnimations[i]->mChannels[k];
+				aiNodeAnim* node = animation->mChannels[k];
 
 #if defined(VERBOSE)
 				std::cout << "Node: " + aiStringToString(node->mNodeName) << std::endl;
 #endif
 
-				Node* internalNode{ RecurseFindNode(m_rootNode,aiStringToString(node->mNodeName)) };
-				if (!internalNode)
+				const int nodeIndex{ m_nodes.Find(aiStringToString(node->mNodeName)) };
+				if (nodeIndex == NodeHierarchy::kNoNode)
 				{
 					std::cout << "Failed to find internal node for channel animation" << std::endl;
 					continue;
@@ -312,36 +369,51 @@ namespace Helpers
 				std::cout << "Node has " + std::to_string(node->mNumScalingKeys) + " scaling keys" << std::endl;
 #endif
 
+				AnimationChannel& channel{ clip.channels.emplace_back() };
+				channel.node = nodeIndex;
+
+				channel.translationTimes.resize(node->mNumPositionKeys);
+				channel.translations.resize(node->mNumPositionKeys);
 				for (unsigned int j = 0; j < node->mNumPositionKeys; j++)
 				{
-					double time = node->mPositionKeys[j].mTime;
-					aiVector3D val=node->mPositionKeys[j].mValue;
-
-					internalNode->translationAnimationKeys.push_back(AnimationData{ (float)time, aiVector3DToGlmVec3(val) });
+					channel.translationTimes[j] = (float)node->mPositionKeys[j].mTime;
+					channel.translations[j] = aiVector3DToGlmVec3(node->mPositionKeys[j].mValue);
 				}
 
+				channel.rotationTimes.resize(node->mNumRotationKeys);
+				channel.rotations.resize(node->mNumRotationKeys);
 				for (unsigned int j = 0; j < node->mNumRotationKeys; j++)
 				{
-					double time = node->mRotationKeys[j].mTime;
-					aiQuaternion val = node->mRotationKeys[j].mValue;
-
-					internalNode->translationAnimationKeys.push_back(AnimationData{ (float)time, aiQuaternionToEulerAngles(val) });					
+					channel.rotationTimes[j] = (float)node->mRotationKeys[j].mTime;
+					channel.rotations[j] = aiQuaternionToGlmQuat(node->mRotationKeys[j].mValue);
 				}
 
+				channel.scaleTimes.resize(node->mNumScalingKeys);
+				channel.scales.resize(node->mNumScalingKeys);
 				for (unsigned int j = 0; j < node->mNumScalingKeys; j++)
 				{
-					double time = node->mScalingKeys[j].mTime;
-					aiVector3D val = node->mScalingKeys[j].mValue;
+					channel.scaleTimes[j] = (float)node->mScalingKeys[j].mTime;
+					channel.scales[j] = aiVector3DToGlmVec3(node->mScalingKeys[j].mValue);
+				}
 
-					internalNode->translationAnimationKeys.push_back(AnimationData{ (float)time, aiVector3DToGlmVec3(val) });
-				}				
+				// Tracks without keys hold the part of the node's transform they would have animated
+				const glm::mat4& transform{ m_nodes.GetLocalTransform(nodeIndex) };
+				const glm::vec3 scale{ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) };
+				glm::quat rotation{ 1, 0, 0, 0 };
+
+				// A node scaled to nothing along an axis has no rotation to recover, dividing by the scale gives NaN
+				if (scale.x > 0 && scale.y > 0 && scale.z > 0)
+					rotation = glm::quat_cast(glm::mat3(glm::vec3(transform[0]) / scale.x, glm::vec3(transform[1]) / scale.y, glm::vec3(transform[2]) / scale.z));
+				FillEmptyTrack(channel.translationTimes, channel.translations, glm::vec3(transform[3]));
+				FillEmptyTrack(channel.rotationTimes, channel.rotations, rotation);
+				FillEmptyTrack(channel.scaleTimes, channel.scales, scale);
 			}
 		}
 
 		std::cout << "Loaded OK" << std::endl;
 
 #if defined(VERBOSE)
-		RecurseOutputHierarchy(m_rootNode, 0);
+		OutputHierarchy();
 #endif
 
 #if defined(VERBOSE)
@@ -390,70 +462,111 @@ namespace Helpers
 		return true;
 	}
 
-	void ModelLoader::RecurseOutputHierarchy(Node* node, int depth)
+	void ModelLoader::OutputHierarchy() const
 	{
-		for (int i=0;i<depth;i++)
-			std::cout << " ";
+		std::vector<int> depths(m_nodes.Size(), 0);
+		for (size_t i = 0; i < m_nodes.Size(); i++)
+		{
+			const int parent{ m_nodes.GetParent(i) };
+			depths[i] = parent == NodeHierarchy::kNoNode ? 0 : depths[parent] + 1;
+			for (int d = 0; d < depths[i]; d++)
+				std::cout << " ";
 
-		glm::vec3 tran = glm::vec3(node->transform[3]);
+			glm::vec3 tran = glm::vec3(m_nodes.GetLocalTransform(i)[3]);
 
-		std::cout << "Node name: " << node->name << " Trans: " << tran.x << "," << tran.y << "," << tran.z << " Mesh: ";
-		for (unsigned int m : node->meshIndices)
-			std::cout << m << " ";
-		std::cout << std::endl;
+			std::cout << "Node name: " << m_nodes.GetNode(i).name << " Trans: " << tran.x << "," << tran.y << "," << tran.z << " Mesh: ";
+			for (unsigned int m : m_nodes.GetNode(i).meshIndices)
+				std::cout << m << " ";
+			std::cout << std::endl;
+		}
+	}
 
-		for (auto n : node->childNodes)
-			RecurseOutputHierarchy(n, depth + 1);
+	// Recursive node creation
+	void ModelLoader::RecurseCreateNode(aiNode* node, int parent)
+	{
+		Node newNode;
+		newNode.name = node->mName.C_Str();
+		newNode.meshIndices.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+		const int index{ (int)m_nodes.Add(std::move(newNode), parent, aiMatrix4x4ToGlm(&node->mTransformation)) };
+		for (size_t i = 0; i < node->mNumChildren; i++)
+			RecurseCreateNode(node->mChildren[i], index);
 	}
 
-	Node* ModelLoader::RecurseFindNode(Node* node, const std::string& nodeName)
+	// Reorders every mesh for drawing, splits it into meshlets and reports how much that helped
+	void ModelLoader::OptimizeMeshes()
 	{
-		if (!node)
-			return nullptr;
+		std::vector<MeshDrawStats> before(m_meshVector.size());
+		std::vector<MeshDrawStats> after(m_meshVector.size());
+		ParallelFor(m_meshVector.size(), 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				before[i] = AnalyzeMeshDraw(m_meshVector[i].elements, m_meshVector[i].vertices);
+				OptimizeMesh(m_meshVector[i]);
 
-		if (node->name == nodeName)
-			return node;
+				// Meshlets reorder the triangles, the vertices then follow the new order
+				BuildMeshlets(m_meshVector[i]);
+				OptimizeVertexFetch(m_meshVector[i]);
+				after[i] = AnalyzeMeshDraw(m_meshVector[i].elements, m_meshVector[i].vertices);
+			}
+		});
 
-		Node* retVal{ nullptr };
-		for (auto child : node->childNodes)
+		for (size_t i = 0; i < m_meshVector.size(); i++)
 		{
-			retVal=RecurseFindNode(child, nodeName);
-			if (retVal)
-				break;
+			std::cout << "Optimised mesh " << i << " (" << m_meshVector[i].elements.size() / 3 << " triangles)"
+				<< std::fixed << std::setprecision(3)
+				<< " ACMR " << before[i].acmr << " -> " << after[i].acmr
+				<< " ATVR " << before[i].atvr << " -> " << after[i].atvr
+				<< " Overdraw " << before[i].overdraw << " -> " << after[i].overdraw
+				<< " Meshlets " << m_meshVector[i].meshlets.size()
+				<< std::defaultfloat << std::endl;
 		}
-
-		return retVal;
 	}
 
-	// Recursive node creation
-	Node* ModelLoader::RecurseCreateNode(aiNode* node, Node* parent)
+	// Simplified levels for every mesh
+	void ModelLoader::GenerateLods()
 	{
-		Node* newNode = new Node;
-
-		newNode->name = node->mName.C_Str();
-		newNode->parentNode = parent;
-
-		for (size_t i = 0; i < node->mNumMeshes; i++)
-			newNode->meshIndices.push_back(node->mMeshes[i]);
-
-		newNode->transform = aiMatrix4x4ToGlm(&node->mTransformation);
-		
-		for (size_t i = 0; i < node->mNumChildren; i++)
-			newNode->childNodes.emplace_back(RecurseCreateNode(node->mChildren[i], newNode));
+		ParallelFor(m_meshVector.size(), 1, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				GenerateMeshLods(m_meshVector[i]);
+		});
+		m_hasLods = true;
 
-		return newNode;
+		for (size_t i = 0; i < m_meshVector.size(); i++)
+		{
+			std::cout << "Mesh " << i << " levels of detail:";
+			for (const MeshLod& lod : m_meshVector[i].lods)
+				std::cout << " " << lod.elements.size() / 3 << " triangles (error " << lod.error << ")";
+			std::cout << std::endl;
+		}
 	}
 
-	// Recursive deletion of nodes
-	void ModelLoader::RecurseDeleteNode(Node* node)
+	// Loads each model on the shared loading pool, largest files first
+	std::vector<std::future<std::unique_ptr<ModelLoader>>> LoadModelsAsync(const std::vector<std::string>& filenames, bool generateLods)
 	{
-		if (!node)
-			return;
-
-		for (Node* n : node->childNodes)
-			RecurseDeleteNode(n);
+		std::vector<std::pair<std::uintmax_t, size_t>> order(filenames.size());
+		for (size_t i = 0; i < filenames.size(); i++)
+		{
+			std::error_code error;
+			const std::uintmax_t size{ fs::file_size(fs::path(filenames[i]), error) };
+			order[i] = { error ? 0 : size, i };
+		}
+		std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
 
-		delete node;
+		std::vector<std::future<std::unique_ptr<ModelLoader>>> loaders(filenames.size());
+		for (const auto& [size, i] : order)
+		{
+			loaders[i] = LoadingPool().Submit([filename = filenames[i], generateLods]()
+			{
+				std::unique_ptr<ModelLoader> loader{ std::make_unique<ModelLoader>() };
+				if (!loader->LoadFromFile(filename, generateLods))
+					loader.reset();
+				return loader;
+			});
+		}
+		return loaders;
 	}
 
 	// Retrieve the dimensions of this model in local coordinates
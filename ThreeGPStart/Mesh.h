@@ -3,16 +3,14 @@
 
 #include "ExternalLibraryHeaders.h"
 #include "Helper.h"
+#include "AnimationSampler.h"
+#include "MeshCache.h"
+#include "NodeHierarchy.h"
+#include <future>
+#include <memory>
 
 namespace Helpers
 {
-	// Per node animation data
-	struct AnimationData
-	{
-		float time;
-		glm::vec3 value;
-	};
-
 	// Materials work with lights and shaders to produce the final render
 	struct Material
 	{
@@ -49,6 +47,33 @@ namespace Helpers
 		}
 	};
 
+	// A simplified version of a mesh drawing a subset of its vertices, see MeshSimplifier.h
+	struct MeshLod
+	{
+		std::vector<unsigned int> elements;
+
+		// Furthest in model units this level's surface gets from the full detail one, or the other way round,
+		// measured at points spread over both
+		float error{ 0 };
+	};
+
+	// A cluster of up to kMeshletMaxVertices vertices and kMeshletMaxTriangles triangles that is culled on its
+	// own, see Meshlets.h. Its triangles are a run of the mesh's elements
+	struct Meshlet
+	{
+		unsigned int firstElement{ 0 };
+		unsigned int elementCount{ 0 };
+
+		// Bounding sphere in model coordinates
+		glm::vec3 centre{ 0 };
+		float radius{ 0 };
+
+		// Every face normal is within the cone around coneAxis, so the whole meshlet faces away from an eye when
+		// dot(normalize(centre - eye), coneAxis) >= coneCutoff + radius / distance(centre, eye). 1 never culls
+		glm::vec3 coneAxis{ 0 };
+		float coneCutoff{ 1 };
+	};
+
 	// Data container for a mesh
 	// A model can be made up of a number of mesh
 	struct Mesh
@@ -67,6 +92,12 @@ namespace Helpers
 		// Index into the material vector held by the ModelLoader
 		size_t materialIndex{ 0 };
 
+		// Levels of detail, coarser each time, only filled if the ModelLoader was asked for them
+		std::vector<MeshLod> lods;
+
+		// Clusters covering elements in order, made on import
+		std::vector<Meshlet> meshlets;
+
 		// Retrieve the dimensions of this mesh in local model coordinates
 		void GetLocalExtents(glm::vec3& minExtents, glm::vec3& maxExtents) const;
 
@@ -82,23 +113,6 @@ namespace Helpers
 		}
 	};	
 
-	// A mesh can contain a hierarchy in a tree structure
-	// Each entry is a Node
-	struct Node
-	{
-		std::string name;
-		glm::mat4 transform{ 1 };
-		std::vector<unsigned int> meshIndices;
-
-		Node* parentNode{ nullptr };
-		std::vector<Node*> childNodes;
-
-		// Animations
-		std::vector<AnimationData> translationAnimationKeys;
-		std::vector<AnimationData> rotationAnimationKeys;
-		std::vector<AnimationData> scaleAnimationKeys;
-	};
-
 	// Helper to load model data into mesh and material structures
 	class ModelLoader
 	{
@@ -107,21 +121,43 @@ namespace Helpers
 		std::vector<Mesh> m_meshVector;
 		std::vector<Material> m_materials;
 
-		Node* m_rootNode{ nullptr };
+		// Hierarchy, the first node is the root
+		NodeHierarchy m_nodes;
+
+		// One clip per animation in the file, each animating nodes in m_nodes
+		std::vector<AnimationClip> m_animations;
 
+		// Set once every mesh has had its levels of detail generated
+		bool m_hasLods{ false };
+
+		bool ImportWithAssimp(const std::string& filename);
 		bool PopulateFromAssimpScene(const aiScene* scene);
 
-		// Recursive
-		Node* RecurseCreateNode(aiNode* node, Node* parent);
-		void RecurseDeleteNode(Node* node);
-		Node* RecurseFindNode(Node* node, const std::string& nodeName);
-		void RecurseOutputHierarchy(Node* node, int depth);
+		// Native multi-threaded reader for Wavefront OBJ and MTL files, see ObjParser.cpp. Returns false on
+		// anything it can't read, leaving the loader unchanged so assimp can try instead
+		bool PopulateFromObjFile(const std::string& filename);
+
+		// Runs the MeshOptimizer passes on every mesh once imported, so the cache stores the optimised order
+		void OptimizeMeshes();
+
+		// Fills in the lods of every mesh, see MeshSimplifier.h
+		void GenerateLods();
+
+		// Binary cache of everything above, see MeshCache.h. Read checks the cache was made from source unless
+		// it is nullptr. Both return false on error, a failed read leaves the loader empty
+		bool ReadCache(const std::string& cachePath, const MeshCacheSource* source);
+		bool WriteCache(const std::string& cachePath, const MeshCacheSource& source) const;
+
+		// Adds the assimp node and everything below it depth first, which keeps parents before children
+		void RecurseCreateNode(aiNode* node, int parent);
+		void OutputHierarchy() const;
 	public:
-		ModelLoader() = default;
-		~ModelLoader() { RecurseDeleteNode(m_rootNode); }
 
-		// Load a 3D model form a provided file and path, return false on error
-		bool LoadFromFile(const std::string& objFilename);
+		// Load a 3D model form a provided file and path, return false on error.
+		// Uses the .bmc cache next to the file while it matches, otherwise imports the file and writes the cache.
+		// OBJ files are read by a native parser, everything else (and any OBJ it can't read) by assimp.
+		// With generateLods each mesh also gets a chain of simplified levels, kept in the cache too
+		bool LoadFromFile(const std::string& objFilename, bool generateLods = false);
 
 		// Retrieves the collection of mesh loaded from the 3D model
 		std::vector<Mesh>& GetMeshVector() { return m_meshVector; }
@@ -129,12 +165,16 @@ namespace Helpers
 		// Retrieves the collection of materials loaded from the 3D model
 		const std::vector<Material>& GetMaterialVector() const { return m_materials; }
 
-		// For a mesh heirarchy this is the root.
-		Node* GetRootNode() { return m_rootNode; }
+		// The mesh hierarchy, node 0 is the root
+		NodeHierarchy& GetNodes() { return m_nodes; }
+		const NodeHierarchy& GetNodes() const { return m_nodes; }
+
+		// Animation clips for the hierarchy, played with an AnimationSampler
+		const std::vector<AnimationClip>& GetAnimations() const { return m_animations; }
 
-		// Retrieve a specific node by name
-		Node* FindNode(const std::string& nodeName) {
-			return RecurseFindNode(m_rootNode, nodeName);
+		// Retrieve the index of a specific node by name, NodeHierarchy::kNoNode if there isn't one
+		int FindNode(const std::string& nodeName) const {
+			return m_nodes.Find(nodeName);
 		}
 
 		// Retrieve the dimensions of this model in local model coordinates
@@ -152,5 +192,12 @@ namespace Helpers
 			return root;
 		}
 	};
+
+	// Loads several models at once on the shared loading pool, each worker thread keeping its own assimp
+	// importer. The largest files are started first so a model made of many files takes about as long as its
+	// largest part. The futures are in the order of filenames and hold nullptr for a file that failed to load.
+	// Each model is loaded on one worker, its parallel loops run serially there as the models already share the
+	// cores. Only the loading happens on the pool, OpenGL buffers must still be made on the context thread.
+	std::vector<std::future<std::unique_ptr<ModelLoader>>> LoadModelsAsync(const std::vector<std::string>& filenames, bool generateLods = false);
 }
 
@@ -0,0 +1,372 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <type_traits>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	static_assert(sizeof(glm::quat) == 16, "Rotation keys are stored as raw bytes");
+	static_assert(sizeof(glm::mat4) == 64, "Node transforms are stored as raw bytes");
+
+	// Cache file ModelLoader uses for sourcePath
+	std::string MeshCachePath(const std::string& sourcePath)
+	{
+		return sourcePath + ".bmc";
+	}
+
+	// Size, timestamp and content hash of sourcePath
+	bool GetMeshCacheSource(const std::string& sourcePath, MeshCacheSource& source)
+	{
+		std::error_code error;
+		const fs::file_time_type writeTime{ fs::last_write_time(fs::path(sourcePath), error) };
+		if (error)
+			return false;
+
+		MappedFile file;
+		if (!file.Open(sourcePath))
+			return false;
+
+		UINT64 hash{ 0xCBF29CE484222325ull };
+		const BYTE* data{ file.Data() };
+		for (size_t i = 0; i < file.Size(); i++)
+			hash = (hash ^ data[i]) * 0x100000001B3ull;
+
+		source.size = (UINT64)file.Size();
+		source.writeTime = (INT64)writeTime.time_since_epoch().count();
+		source.hash = hash;
+		return true;
+	}
+
+	// Appends values to the cache in memory before it is written out in one go
+	class MeshCacheWriter
+	{
+	private:
+		std::vector<BYTE> m_data;
+	public:
+		const std::vector<BYTE>& Data() const { return m_data; }
+
+		void PutBytes(const void* data, size_t size)
+		{
+			const BYTE* bytes{ (const BYTE*)data };
+			m_data.insert(m_data.end(), bytes, bytes + size);
+		}
+
+		template<typename T>
+		void Put(const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be stored");
+			PutBytes(&value, sizeof(T));
+		}
+
+		template<typename T>
+		void PutArray(const std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be stored");
+			Put((UINT32)values.size());
+			PutBytes(values.data(), values.size() * sizeof(T));
+		}
+
+		void PutString(const std::string& value)
+		{
+			Put((UINT32)value.size());
+			PutBytes(value.data(), value.size());
+		}
+	};
+
+	// Copies values back out of a mapped cache. Every read is bounds checked, once one fails the rest do too
+	class MeshCacheReader
+	{
+	private:
+		const BYTE* m_data;
+		size_t m_size;
+		size_t m_offset{ 0 };
+		bool m_ok{ true };
+	public:
+		MeshCacheReader(const BYTE* data, size_t size) : m_data(data), m_size(size) {}
+
+		bool Ok() const { return m_ok; }
+
+		bool GetBytes(void* data, size_t size)
+		{
+			if (!m_ok || size > m_size - m_offset)
+				return m_ok = false;
+
+			memcpy(data, m_data + m_offset, size);
+			m_offset += size;
+			return true;
+		}
+
+		template<typename T>
+		bool Get(T& value)
+		{
+			return GetBytes(&value, sizeof(T));
+		}
+
+		template<typename T>
+		bool GetArray(std::vector<T>& values)
+		{
+			UINT32 count{ 0 };
+			if (!Get(count) || count > (m_size - m_offset) / sizeof(T))
+				return m_ok = false;
+
+			values.resize(count);
+			return GetBytes(values.data(), (size_t)count * sizeof(T));
+		}
+
+		bool GetString(std::string& value)
+		{
+			UINT32 length{ 0 };
+			if (!Get(length) || length > m_size - m_offset)
+				return m_ok = false;
+
+			value.assign((const char*)m_data + m_offset, length);
+			m_offset += length;
+			return true;
+		}
+	};
+
+	// Fills the loader from the cache at cachePath. If source is given the cache must have been made from it
+	bool ModelLoader::ReadCache(const std::string& cachePath, const MeshCacheSource* source)
+	{
+		std::error_code error;
+		if (!fs::exists(fs::path(cachePath), error))
+			return false;
+
+		MappedFile file;
+		if (!file.Open(cachePath))
+			return false;
+
+		MeshCacheReader reader(file.Data(), file.Size());
+		MeshCacheHeader header{};
+		if (!reader.Get(header) || header.magic != kMeshCacheMagic || header.version != kMeshCacheVersion)
+			return false;
+
+		if (source && (header.source.size != source->size || header.source.writeTime != source->writeTime ||
+			header.source.hash != source->hash))
+			return false;
+
+		// Every entry takes at least a byte, so bigger counts can only come from a damaged file
+		if (header.materialCount > file.Size() || header.meshCount > file.Size() || header.nodeCount > file.Size())
+			return false;
+
+		m_materials.resize(header.materialCount);
+		for (Material& material : m_materials)
+		{
+			reader.GetString(material.diffuseTextureFilename);
+			reader.GetString(material.specularTextureFilename);
+			reader.Get(material.diffuseColour);
+			reader.Get(material.ambientColour);
+			reader.Get(material.emissiveColour);
+			reader.Get(material.specularColour);
+			reader.Get(material.specularFactor);
+		}
+
+		bool valid{ true };
+		m_meshVector.resize(header.meshCount);
+		for (Mesh& mesh : m_meshVector)
+		{
+			UINT32 materialIndex{ 0 };
+			reader.GetString(mesh.name);
+			reader.Get(materialIndex);
+			reader.GetArray(mesh.vertices);
+			reader.GetArray(mesh.normals);
+			reader.GetArray(mesh.uvCoords);
+			reader.GetArray(mesh.elements);
+			mesh.materialIndex = materialIndex;
+			valid = valid && materialIndex < header.materialCount;
+
+			UINT32 lodCount{ 0 };
+			reader.Get(lodCount);
+			mesh.lods.resize(std::min<size_t>(lodCount, file.Size()));
+			for (MeshLod& lod : mesh.lods)
+			{
+				reader.Get(lod.error);
+				reader.GetArray(lod.elements);
+			}
+			reader.GetArray(mesh.meshlets);
+		}
+		m_hasLods = (header.flags & kMeshCacheHasLods) != 0;
+
+		// Stored in hierarchy order, so each node's parent was read before it
+		m_nodes.Clear();
+		m_nodes.Reserve(header.nodeCount);
+		for (UINT32 i = 0; i < header.nodeCount && valid; i++)
+		{
+			INT32 parentIndex{ -1 };
+			reader.Get(parentIndex);
+			if (!reader.Ok() || (i == 0 ? parentIndex != NodeHierarchy::kNoNode : (parentIndex < 0 || (UINT32)parentIndex >= i)))
+			{
+				valid = false;
+				break;
+			}
+
+			Node node;
+			glm::mat4 transform{ 1 };
+			reader.GetString(node.name);
+			reader.Get(transform);
+			reader.GetArray(node.meshIndices);
+
+			for (unsigned int meshIndex : node.meshIndices)
+				valid = valid && meshIndex < header.meshCount;
+
+			m_nodes.Add(std::move(node), parentIndex, transform);
+		}
+
+		// Every track needs a value per key and at least one key for the sampler
+		const auto validTrack = [](const std::vector<float>& times, size_t valueCount)
+		{
+			return !times.empty() && times.size() == valueCount;
+		};
+
+		UINT32 animationCount{ 0 };
+		reader.Get(animationCount);
+		m_animations.resize(valid ? std::min<size_t>(animationCount, file.Size()) : 0);
+		for (AnimationClip& clip : m_animations)
+		{
+			UINT32 channelCount{ 0 };
+			reader.GetString(clip.name);
+			reader.Get(clip.duration);
+			reader.Get(clip.ticksPerSecond);
+			reader.Get(channelCount);
+			clip.channels.resize(std::min<size_t>(channelCount, file.Size()));
+			for (AnimationChannel& channel : clip.channels)
+			{
+				INT32 node{ NodeHierarchy::kNoNode };
+				reader.Get(node);
+				reader.GetArray(channel.translationTimes);
+				reader.GetArray(channel.translations);
+				reader.GetArray(channel.rotationTimes);
+				reader.GetArray(channel.rotations);
+				reader.GetArray(channel.scaleTimes);
+				reader.GetArray(channel.scales);
+				channel.node = node;
+
+				valid = valid && reader.Ok() && node >= 0 && (UINT32)node < header.nodeCount &&
+					validTrack(channel.translationTimes, channel.translations.size()) &&
+					validTrack(channel.rotationTimes, channel.rotations.size()) &&
+					validTrack(channel.scaleTimes, channel.scales.size());
+			}
+			if (!valid)
+				break;
+		}
+
+		if (valid && reader.Ok() && m_nodes.Size() == header.nodeCount && m_animations.size() == animationCount)
+			return true;
+
+		std::cout << "Ignoring damaged mesh cache: " << cachePath << std::endl;
+		m_nodes.Clear();
+		m_animations.clear();
+		m_meshVector.clear();
+		m_materials.clear();
+		m_hasLods = false;
+		return false;
+	}
+
+	// Writes what the loader holds to cachePath, made from source
+	bool ModelLoader::WriteCache(const std::string& cachePath, const MeshCacheSource& source) const
+	{
+		MeshCacheHeader header{};
+		header.magic = kMeshCacheMagic;
+		header.version = kMeshCacheVersion;
+		header.source = source;
+		header.materialCount = (UINT32)m_materials.size();
+		header.meshCount = (UINT32)m_meshVector.size();
+		header.nodeCount = (UINT32)m_nodes.Size();
+		header.flags = m_hasLods ? kMeshCacheHasLods : 0;
+
+		MeshCacheWriter writer;
+		writer.Put(header);
+
+		for (const Material& material : m_materials)
+		{
+			writer.PutString(material.diffuseTextureFilename);
+			writer.PutString(material.specularTextureFilename);
+			writer.Put(material.diffuseColour);
+			writer.Put(material.ambientColour);
+			writer.Put(material.emissiveColour);
+			writer.Put(material.specularColour);
+			writer.Put(material.specularFactor);
+		}
+
+		for (const Mesh& mesh : m_meshVector)
+		{
+			writer.PutString(mesh.name);
+			writer.Put((UINT32)mesh.materialIndex);
+			writer.PutArray(mesh.vertices);
+			writer.PutArray(mesh.normals);
+			writer.PutArray(mesh.uvCoords);
+			writer.PutArray(mesh.elements);
+
+			writer.Put((UINT32)mesh.lods.size());
+			for (const MeshLod& lod : mesh.lods)
+			{
+				writer.Put(lod.error);
+				writer.PutArray(lod.elements);
+			}
+			writer.PutArray(mesh.meshlets);
+		}
+
+		for (size_t i = 0; i < m_nodes.Size(); i++)
+		{
+			const Node& node{ m_nodes.GetNode(i) };
+			writer.Put((INT32)m_nodes.GetParent(i));
+			writer.PutString(node.name);
+			writer.Put(m_nodes.GetLocalTransform(i));
+			writer.PutArray(node.meshIndices);
+		}
+
+		writer.Put((UINT32)m_animations.size());
+		for (const AnimationClip& clip : m_animations)
+		{
+			writer.PutString(clip.name);
+			writer.Put(clip.duration);
+			writer.Put(clip.ticksPerSecond);
+			writer.Put((UINT32)clip.channels.size());
+			for (const AnimationChannel& channel : clip.channels)
+			{
+				writer.Put((INT32)channel.node);
+				writer.PutArray(channel.translationTimes);
+				writer.PutArray(channel.translations);
+				writer.PutArray(channel.rotationTimes);
+				writer.PutArray(channel.rotations);
+				writer.PutArray(channel.scaleTimes);
+				writer.PutArray(channel.scales);
+			}
+		}
+
+		// Write to a temporary file first so a later load never maps a half written one. It is named after the
+		// thread so loads of the same model running at once don't write into each other's
+		const std::string tempPath{ cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp" };
+		bool ok{ false };
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cout << "Could not create: " << tempPath << std::endl;
+				return false;
+			}
+
+			file.write((const char*)writer.Data().data(), writer.Data().size());
+			ok = (bool)file;
+			if (!ok)
+				std::cout << "Failed writing: " << tempPath << std::endl;
+		}
+
+		std::error_code error;
+		if (ok)
+		{
+			fs::rename(fs::path(tempPath), fs::path(cachePath), error);
+			if (!error)
+				return true;
+			std::cout << "Could not replace " << cachePath << ": " << error.message() << std::endl;
+		}
+
+		fs::remove(fs::path(tempPath), error);
+		return false;
+	}
+}
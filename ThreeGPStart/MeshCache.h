@@ -0,0 +1,50 @@
+#pragma once
+// Binary model cache (.bmc). ModelLoader writes one next to a model after importing it with Assimp, holding the
+// meshes, materials, node hierarchy and animation clips exactly as PopulateFromAssimpScene produced them.
+// Later loads map the cache and copy the streams straight out while the source file's size, timestamp and
+// content hash still match, skipping Assimp and its post processing entirely.
+
+#include "ExternalLibraryHeaders.h"
+
+namespace Helpers
+{
+	constexpr UINT32 kMeshCacheMagic{ 0x434D4221 };	// "!BMC"
+
+	// Bump whenever the layout or what the import produces changes, older caches are then rebuilt
+	// 2: meshes are stored after MeshOptimizer has reordered them
+	// 3: meshes have levels of detail
+	// 4: meshes have meshlets
+	// 5: animations are clips of separate translation, quaternion rotation and scale tracks
+	// 6: level of detail errors are measured distances from the full detail surface
+	constexpr UINT32 kMeshCacheVersion{ 6 };
+
+	// MeshCacheHeader flags
+	constexpr UINT32 kMeshCacheHasLods{ 1 };
+
+	// Identifies the source file a cache was made from
+	struct MeshCacheSource
+	{
+		UINT64 size;
+		INT64 writeTime;	// file_time_type ticks
+		UINT64 hash;		// FNV-1a of the contents
+	};
+
+	// Start of a .bmc file. The sections follow in this order, each array as a UINT32 count then its elements:
+	// materials, meshes, the nodes in hierarchy order, parents first, then a UINT32 count and the animation clips
+	struct MeshCacheHeader
+	{
+		UINT32 magic;
+		UINT32 version;
+		MeshCacheSource source;
+		UINT32 materialCount;
+		UINT32 meshCount;
+		UINT32 nodeCount;
+		UINT32 flags;
+	};
+
+	// The cache file ModelLoader uses for sourcePath, next to the source with .bmc appended
+	std::string MeshCachePath(const std::string& sourcePath);
+
+	// Size, timestamp and content hash of sourcePath. Returns false if it can't be read
+	bool GetMeshCacheSource(const std::string& sourcePath, MeshCacheSource& source);
+}
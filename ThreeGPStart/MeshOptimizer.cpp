@@ -0,0 +1,400 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+namespace Helpers
+{
+	// Size of each of the six views the overdraw is measured in
+	constexpr int kOverdrawViewSize{ 256 };
+
+	// FIFO vertex cache. A vertex is in the cache while fewer than kVertexCacheSize misses happened since it was added
+	class VertexCacheModel
+	{
+	private:
+		std::vector<size_t> m_addedAt;
+		size_t m_time{ kVertexCacheSize + 1 };
+	public:
+		explicit VertexCacheModel(size_t vertexCount) : m_addedAt(vertexCount, 0) {}
+
+		// Returns true on a miss
+		bool Use(unsigned int vertex)
+		{
+			if (m_time - m_addedAt[vertex] <= kVertexCacheSize)
+				return false;
+
+			m_addedAt[vertex] = m_time++;
+			return true;
+		}
+
+		// Time since vertex entered the cache, more than kVertexCacheSize if it isn't in it
+		size_t Age(unsigned int vertex) const { return m_time - m_addedAt[vertex]; }
+
+		void Flush() { m_time += kVertexCacheSize + 1; }
+	};
+
+	// Largest element plus one
+	static size_t CountVertices(const std::vector<unsigned int>& elements)
+	{
+		return elements.empty() ? 0 : (size_t)*std::max_element(elements.begin(), elements.end()) + 1;
+	}
+
+	// Vertex shader runs drawing elements with the modelled cache
+	static size_t CountCacheMisses(const std::vector<unsigned int>& elements, size_t vertexCount)
+	{
+		VertexCacheModel cache(vertexCount);
+		size_t misses{ 0 };
+		for (unsigned int element : elements)
+			misses += cache.Use(element) ? 1 : 0;
+		return misses;
+	}
+
+	// Rasterises the triangles seen along axis (0 x, 1 y, 2 z), from the negative side or the positive one if
+	// flip, adding to the fragments that passed the depth test and the pixels covered at the end
+	static void RasteriseOverdrawView(const std::vector<unsigned int>& elements, const std::vector<glm::vec3>& vertices,
+		const glm::vec3& minExtents, const glm::vec3& scale, int axis, bool flip, std::vector<float>& depth, size_t& shaded, size_t& covered)
+	{
+		// Screen x and y are the other two axes, swapped when flipped so the view is mirrored rather than
+		// seen from behind, which keeps the same winding test for front faces either way
+		const int screenX{ flip ? (axis + 2) % 3 : (axis + 1) % 3 };
+		const int screenY{ flip ? (axis + 1) % 3 : (axis + 2) % 3 };
+		const float depthSign{ flip ? -1.0f : 1.0f };
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+		for (size_t e = 0; e + 2 < elements.size(); e += 3)
+		{
+			glm::vec3 corners[3];
+			for (int i = 0; i < 3; i++)
+			{
+				const glm::vec3 v{ (vertices[elements[e + i]] - minExtents) * scale };
+				corners[i] = glm::vec3(v[screenX], v[screenY], v[axis] * depthSign);
+			}
+
+			// With depth increasing away from the viewer a triangle facing it winds clockwise on screen
+			const float area{ (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[1].y - corners[0].y) * (corners[2].x - corners[0].x) };
+			if (area >= 0)
+				continue;
+			std::swap(corners[1], corners[2]);
+
+			const int left{ std::max((int)std::floor(std::min({ corners[0].x, corners[1].x, corners[2].x })), 0) };
+			const int right{ std::min((int)std::ceil(std::max({ corners[0].x, corners[1].x, corners[2].x })), kOverdrawViewSize - 1) };
+			const int bottom{ std::max((int)std::floor(std::min({ corners[0].y, corners[1].y, corners[2].y })), 0) };
+			const int top{ std::min((int)std::ceil(std::max({ corners[0].y, corners[1].y, corners[2].y })), kOverdrawViewSize - 1) };
+
+			const auto edge = [](const glm::vec3& a, const glm::vec3& b, float x, float y)
+			{
+				return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+			};
+
+			for (int y = bottom; y <= top; y++)
+			{
+				for (int x = left; x <= right; x++)
+				{
+					const float px{ x + 0.5f };
+					const float py{ y + 0.5f };
+					const float w0{ edge(corners[1], corners[2], px, py) };
+					const float w1{ edge(corners[2], corners[0], px, py) };
+					const float w2{ edge(corners[0], corners[1], px, py) };
+					if (w0 < 0 || w1 < 0 || w2 < 0)
+						continue;
+
+					const float z{ (w0 * corners[0].z + w1 * corners[1].z + w2 * corners[2].z) / -area };
+					float& stored{ depth[(size_t)y * kOverdrawViewSize + x] };
+					if (z < stored)
+					{
+						stored = z;
+						shaded++;
+					}
+				}
+			}
+		}
+
+		covered += (size_t)std::count_if(depth.begin(), depth.end(), [](float d) { return d != FLT_MAX; });
+	}
+
+	// Measures elements drawn from vertices
+	MeshDrawStats AnalyzeMeshDraw(const std::vector<unsigned int>& elements, const std::vector<glm::vec3>& vertices)
+	{
+		MeshDrawStats stats;
+		const size_t triangleCount{ elements.size() / 3 };
+		if (triangleCount == 0 || vertices.empty())
+			return stats;
+
+		const size_t misses{ CountCacheMisses(elements, vertices.size()) };
+		stats.acmr = (float)misses / triangleCount;
+		stats.atvr = (float)misses / vertices.size();
+
+		// Bounds scaled to the view, keeping the aspect ratio so triangles aren't stretched
+		glm::vec3 minExtents{ vertices[0] };
+		glm::vec3 maxExtents{ vertices[0] };
+		for (const glm::vec3& v : vertices)
+		{
+			minExtents = glm::min(minExtents, v);
+			maxExtents = glm::max(maxExtents, v);
+		}
+		const glm::vec3 size{ maxExtents - minExtents };
+		const float largest{ std::max({ size.x, size.y, size.z }) };
+		const glm::vec3 scale{ largest > 0 ? (kOverdrawViewSize - 1) / largest : 0.0f };
+
+		std::vector<float> depth((size_t)kOverdrawViewSize * kOverdrawViewSize);
+		size_t shaded{ 0 };
+		size_t covered{ 0 };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			RasteriseOverdrawView(elements, vertices, minExtents, scale, axis, false, depth, shaded, covered);
+			RasteriseOverdrawView(elements, vertices, minExtents, scale, axis, true, depth, shaded, covered);
+		}
+		stats.overdraw = covered ? (float)shaded / covered : 0.0f;
+		return stats;
+	}
+
+	// Tipsify
+	void OptimizeVertexCache(std::vector<unsigned int>& elements, size_t vertexCount, std::vector<size_t>* clusters)
+	{
+		const size_t triangleCount{ elements.size() / 3 };
+		vertexCount = std::max(vertexCount, CountVertices(elements));
+		if (clusters)
+			clusters->clear();
+		if (triangleCount == 0)
+			return;
+
+		// Triangles using each vertex, and how many of those are still to be emitted
+		std::vector<unsigned int> live(vertexCount, 0);
+		for (unsigned int element : elements)
+			live[element]++;
+
+		std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			firstTriangle[v + 1] = firstTriangle[v] + live[v];
+
+		std::vector<unsigned int> vertexTriangles(elements.size());
+		{
+			std::vector<size_t> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+			for (size_t e = 0; e < elements.size(); e++)
+				vertexTriangles[cursor[elements[e]]++] = (unsigned int)(e / 3);
+		}
+
+		VertexCacheModel cache(vertexCount);
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<unsigned int> deadEnds;
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> result;
+		result.reserve(elements.size());
+
+		size_t nextUnused{ 0 };
+		size_t fanVertex{ elements[0] };
+		bool coldStart{ true };
+		while (fanVertex != SIZE_MAX)
+		{
+			if (coldStart && clusters)
+				clusters->push_back(result.size() / 3);
+
+			// Emit every triangle left around the fanning vertex
+			candidates.clear();
+			for (size_t i = firstTriangle[fanVertex]; i < firstTriangle[fanVertex + 1]; i++)
+			{
+				const unsigned int triangle{ vertexTriangles[i] };
+				if (emitted[triangle])
+					continue;
+
+				for (size_t c = 0; c < 3; c++)
+				{
+					const unsigned int vertex{ elements[(size_t)triangle * 3 + c] };
+					result.push_back(vertex);
+					deadEnds.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+					cache.Use(vertex);
+				}
+				emitted[triangle] = true;
+			}
+
+			// Next fan around the candidate that will stay in the cache longest while its triangles are emitted
+			size_t best{ SIZE_MAX };
+			size_t bestPriority{ 0 };
+			for (unsigned int vertex : candidates)
+			{
+				if (live[vertex] == 0)
+					continue;
+
+				size_t priority{ 0 };
+				if (cache.Age(vertex) + 2 * live[vertex] <= kVertexCacheSize)
+					priority = cache.Age(vertex);
+
+				if (best == SIZE_MAX || priority > bestPriority)
+				{
+					best = vertex;
+					bestPriority = priority;
+				}
+			}
+
+			// Dead end, go back to a recently used vertex with triangles left or failing that any vertex
+			coldStart = best == SIZE_MAX;
+			while (best == SIZE_MAX && !deadEnds.empty())
+			{
+				const unsigned int vertex{ deadEnds.back() };
+				deadEnds.pop_back();
+				if (live[vertex] > 0)
+					best = vertex;
+			}
+
+			while (best == SIZE_MAX && nextUnused < vertexCount)
+			{
+				if (live[nextUnused] > 0)
+					best = nextUnused;
+				nextUnused++;
+			}
+
+			fanVertex = best;
+		}
+
+		elements.swap(result);
+	}
+
+	// Splits into smaller clusters then sorts them outward facing first
+	void OptimizeOverdraw(std::vector<unsigned int>& elements, const std::vector<glm::vec3>& vertices, const std::vector<size_t>& clusters,
+		float threshold)
+	{
+		const size_t triangleCount{ elements.size() / 3 };
+		if (triangleCount == 0 || clusters.empty())
+			return;
+
+		// A new cluster starts once the triangles since the last start have a miss rate within threshold of
+		// their whole cache cluster's, so the cluster pays for its cold start
+		VertexCacheModel cache(vertices.size());
+		std::vector<size_t> starts;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const size_t begin{ clusters[c] };
+			const size_t end{ c + 1 < clusters.size() ? clusters[c + 1] : triangleCount };
+
+			cache.Flush();
+			size_t clusterMisses{ 0 };
+			for (size_t e = begin * 3; e < end * 3; e++)
+				clusterMisses += cache.Use(elements[e]) ? 1 : 0;
+			const float missLimit{ threshold * clusterMisses / (end - begin) };
+
+			cache.Flush();
+			starts.push_back(begin);
+			size_t misses{ 0 };
+			for (size_t t = begin; t < end; t++)
+			{
+				for (size_t e = t * 3; e < t * 3 + 3; e++)
+					misses += cache.Use(elements[e]) ? 1 : 0;
+
+				if (t + 1 < end && misses <= missLimit * (t + 1 - starts.back()))
+				{
+					starts.push_back(t + 1);
+					cache.Flush();
+					misses = 0;
+				}
+			}
+		}
+
+		// Area weighted centroid and normal of each cluster
+		struct Cluster
+		{
+			size_t begin;
+			size_t end;
+			glm::vec3 centroid;
+			glm::vec3 normal;
+			float sortKey;
+		};
+		std::vector<Cluster> sorted(starts.size());
+		glm::vec3 meshCentroid{ 0 };
+		float meshArea{ 0 };
+		for (size_t c = 0; c < starts.size(); c++)
+		{
+			Cluster& cluster{ sorted[c] };
+			cluster.begin = starts[c];
+			cluster.end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+			cluster.centroid = glm::vec3(0);
+			cluster.normal = glm::vec3(0);
+
+			float clusterArea{ 0 };
+			for (size_t t = cluster.begin; t < cluster.end; t++)
+			{
+				const glm::vec3& a{ vertices[elements[t * 3]] };
+				const glm::vec3& b{ vertices[elements[t * 3 + 1]] };
+				const glm::vec3& d{ vertices[elements[t * 3 + 2]] };
+				const glm::vec3 normal{ glm::cross(b - a, d - a) };
+				const float area{ glm::length(normal) };
+
+				cluster.centroid += (a + b + d) * (area / 3.0f);
+				cluster.normal += normal;
+				clusterArea += area;
+			}
+
+			meshCentroid += cluster.centroid;
+			meshArea += clusterArea;
+			cluster.centroid = clusterArea > 0 ? cluster.centroid / clusterArea : vertices[elements[cluster.begin * 3]];
+		}
+		meshCentroid = meshArea > 0 ? meshCentroid / meshArea : glm::vec3(0);
+
+		for (Cluster& cluster : sorted)
+		{
+			const float length{ glm::length(cluster.normal) };
+			cluster.sortKey = length > 0 ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length) : -FLT_MAX;
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+		std::vector<unsigned int> result;
+		result.reserve(elements.size());
+		for (const Cluster& cluster : sorted)
+			result.insert(result.end(), elements.begin() + cluster.begin * 3, elements.begin() + cluster.end * 3);
+		elements.swap(result);
+	}
+
+	// First use order
+	void OptimizeVertexFetch(Mesh& mesh)
+	{
+		const size_t vertexCount{ mesh.vertices.size() };
+		std::vector<unsigned int> remap(vertexCount, UINT_MAX);
+		unsigned int used{ 0 };
+		for (unsigned int& element : mesh.elements)
+		{
+			if (remap[element] == UINT_MAX)
+				remap[element] = used++;
+			element = remap[element];
+		}
+
+		const auto reorder = [&](auto& stream)
+		{
+			if (stream.size() != vertexCount)
+				return;
+
+			std::remove_reference_t<decltype(stream)> reordered(used);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				if (remap[v] != UINT_MAX)
+					reordered[remap[v]] = stream[v];
+			}
+			stream.swap(reordered);
+		};
+		reorder(mesh.vertices);
+		reorder(mesh.normals);
+		reorder(mesh.uvCoords);
+	}
+
+	// Cache, overdraw then fetch
+	void OptimizeMesh(Mesh& mesh)
+	{
+		// Small meshes are sometimes already in a better order than Tipsify finds, those keep it as one cluster
+		std::vector<unsigned int> elements{ mesh.elements };
+		std::vector<size_t> clusters;
+		OptimizeVertexCache(elements, mesh.vertices.size(), &clusters);
+		if (CountCacheMisses(elements, mesh.vertices.size()) <= CountCacheMisses(mesh.elements, mesh.vertices.size()))
+			mesh.elements.swap(elements);
+		else
+			clusters.assign(1, 0);
+
+		// Sorting breaks the cache reuse across cluster edges, it is only kept if that stays within the threshold
+		const size_t cacheMisses{ CountCacheMisses(mesh.elements, mesh.vertices.size()) };
+		elements = mesh.elements;
+		OptimizeOverdraw(elements, mesh.vertices, clusters);
+		if (CountCacheMisses(elements, mesh.vertices.size()) <= kOverdrawClusterThreshold * cacheMisses)
+			mesh.elements.swap(elements);
+
+		OptimizeVertexFetch(mesh);
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+// Reorders a mesh's triangles and vertices for faster drawing, and measures how well a mesh draws.
+// The triangle order is made vertex cache friendly with Tipsify (Sander et al. 2007), which fans around each
+// vertex while its triangles are still in the cache, then the clusters that produces are sorted so outward
+// facing ones are drawn first and cover what is behind them. Finally the vertices are put in the order they are
+// first used so vertex fetch reads memory front to back. ModelLoader runs all three on import.
+
+#include "Mesh.h"
+
+namespace Helpers
+{
+	// Post transform cache modelled, a FIFO of this many vertices is close to what GPUs reuse in practice
+	constexpr size_t kVertexCacheSize{ 16 };
+
+	// How much worse than its own cluster's cache miss rate a smaller cluster may be. Smaller clusters sort
+	// better for overdraw but cost vertex cache hits
+	constexpr float kOverdrawClusterThreshold{ 1.05f };
+
+	struct MeshDrawStats
+	{
+		// Average cache miss ratio, vertex shader runs per triangle. 0.5 is ideal for a large grid, 3 is the worst
+		float acmr{ 0 };
+
+		// Average transformed vertex ratio, vertex shader runs per vertex. 1 is ideal
+		float atvr{ 0 };
+
+		// Pixels shaded per pixel covered, drawn with a depth test from the six axis directions. 1 is ideal
+		float overdraw{ 0 };
+	};
+
+	// Measures elements drawn from vertices with the modelled vertex cache and a small software rasteriser
+	MeshDrawStats AnalyzeMeshDraw(const std::vector<unsigned int>& elements, const std::vector<glm::vec3>& vertices);
+
+	// Tipsify. Reorders the triangles in elements for the vertex cache. If clusters is given it receives the
+	// first triangle of each run that starts with a cold cache
+	void OptimizeVertexCache(std::vector<unsigned int>& elements, size_t vertexCount, std::vector<size_t>* clusters = nullptr);
+
+	// Splits the cache optimised triangles further where that costs little, see kOverdrawClusterThreshold, then
+	// sorts the clusters so those facing out from the middle of the mesh are drawn first
+	void OptimizeOverdraw(std::vector<unsigned int>& elements, const std::vector<glm::vec3>& vertices, const std::vector<size_t>& clusters,
+		float threshold = kOverdrawClusterThreshold);
+
+	// Puts the vertices and their normals and uvs in the order the triangles first use them, dropping unused ones
+	void OptimizeVertexFetch(Mesh& mesh);
+
+	// All three in order
+	void OptimizeMesh(Mesh& mesh);
+}
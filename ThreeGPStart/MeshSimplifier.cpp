@@ -0,0 +1,634 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <unordered_map>
+
+namespace Helpers
+{
+	// Most cells along any side of the grid used to find the nearest triangle to a point
+	constexpr float kMaxGridCells{ 256.0f };
+
+	// Most points a triangle edge is split into when sampling a level's distance from the full detail surface
+	constexpr int kMaxSampleSteps{ 8 };
+
+	// Boundary edges get a plane at right angles to their face with this weight times their squared length,
+	// which keeps open edges of the mesh in place
+	constexpr double kBoundaryWeight{ 10.0 };
+
+	// Sum of squared distances to a set of planes, with the total weight so it can give an average
+	struct Quadric
+	{
+		double a2{ 0 }, ab{ 0 }, ac{ 0 }, ad{ 0 };
+		double b2{ 0 }, bc{ 0 }, bd{ 0 };
+		double c2{ 0 }, cd{ 0 };
+		double d2{ 0 };
+		double weight{ 0 };
+
+		void AddPlane(const glm::dvec3& normal, double d, double planeWeight)
+		{
+			a2 += planeWeight * normal.x * normal.x; ab += planeWeight * normal.x * normal.y; ac += planeWeight * normal.x * normal.z; ad += planeWeight * normal.x * d;
+			b2 += planeWeight * normal.y * normal.y; bc += planeWeight * normal.y * normal.z; bd += planeWeight * normal.y * d;
+			c2 += planeWeight * normal.z * normal.z; cd += planeWeight * normal.z * d;
+			d2 += planeWeight * d * d;
+			weight += planeWeight;
+		}
+
+		void Add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			weight += other.weight;
+		}
+
+		// Weighted average squared distance of point from the planes
+		double Error(const glm::vec3& point) const
+		{
+			const double x{ point.x }, y{ point.y }, z{ point.z };
+			const double sum{ a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+				b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+				c2 * z * z + 2 * cd * z + d2 };
+			return weight > 0 ? std::max(sum / weight, 0.0) : 0.0;
+		}
+	};
+
+	// Hashes a position by its bits, with -0 made +0 first so equal positions match
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& position) const
+		{
+			const glm::vec3 p{ position + glm::vec3(0.0f) };
+			UINT32 bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+		}
+	};
+
+	// An edge between two position groups and the cheaper way to collapse it
+	struct CollapseCandidate
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	// Simplification state for one mesh
+	class QuadricSimplifier
+	{
+	private:
+		const Mesh& m_mesh;
+		float m_attributeScale;
+
+		// Position group of each vertex, and each group's position, quadric and vertices still in use
+		std::vector<unsigned int> m_group;
+		std::vector<glm::vec3> m_groupPositions;
+		std::vector<Quadric> m_quadrics;
+		std::vector<std::vector<unsigned int>> m_members;
+
+		// Where each vertex went when its group collapsed, itself if it hasn't
+		std::vector<unsigned int> m_collapsedTo;
+
+		std::vector<unsigned int> m_elements;
+
+		// Triangles touching each group, rebuilt every pass
+		std::vector<size_t> m_firstTriangle;
+		std::vector<unsigned int> m_groupTriangles;
+
+		unsigned int Resolve(unsigned int vertex)
+		{
+			unsigned int target{ vertex };
+			while (m_collapsedTo[target] != target)
+				target = m_collapsedTo[target];
+			while (m_collapsedTo[vertex] != target)
+			{
+				const unsigned int next{ m_collapsedTo[vertex] };
+				m_collapsedTo[vertex] = target;
+				vertex = next;
+			}
+			return target;
+		}
+
+		float AttributeDistance(unsigned int a, unsigned int b) const
+		{
+			float distance{ 0 };
+			if (!m_mesh.normals.empty())
+				distance += glm::dot(m_mesh.normals[a] - m_mesh.normals[b], m_mesh.normals[a] - m_mesh.normals[b]);
+			if (!m_mesh.uvCoords.empty())
+				distance += glm::dot(m_mesh.uvCoords[a] - m_mesh.uvCoords[b], m_mesh.uvCoords[a] - m_mesh.uvCoords[b]);
+			return distance;
+		}
+
+		// The vertex of group to that vertex should become
+		unsigned int ClosestMember(unsigned int vertex, unsigned int to, float& distance) const
+		{
+			unsigned int best{ m_members[to][0] };
+			distance = FLT_MAX;
+			for (unsigned int member : m_members[to])
+			{
+				const float d{ AttributeDistance(vertex, member) };
+				if (d < distance)
+				{
+					distance = d;
+					best = member;
+				}
+			}
+			return best;
+		}
+
+		// True if moving group from onto to would turn any of the triangles around from over
+		bool Flips(unsigned int from, unsigned int to) const
+		{
+			for (size_t i = m_firstTriangle[from]; i < m_firstTriangle[from + 1]; i++)
+			{
+				const unsigned int* triangle{ &m_elements[(size_t)m_groupTriangles[i] * 3] };
+				glm::vec3 before[3];
+				glm::vec3 after[3];
+				bool hasTo{ false };
+				for (int c = 0; c < 3; c++)
+				{
+					const unsigned int group{ m_group[triangle[c]] };
+					hasTo = hasTo || group == to;
+					before[c] = m_groupPositions[group];
+					after[c] = group == from ? m_groupPositions[to] : before[c];
+				}
+				if (hasTo)
+					continue;
+
+				const glm::vec3 normalBefore{ glm::cross(before[1] - before[0], before[2] - before[0]) };
+				const glm::vec3 normalAfter{ glm::cross(after[1] - after[0], after[2] - after[0]) };
+				if (glm::dot(normalBefore, normalAfter) <= 0)
+					return true;
+			}
+			return false;
+		}
+
+		// Drops triangles that collapsed and rebuilds the group to triangle lists
+		void Compact()
+		{
+			size_t kept{ 0 };
+			for (size_t e = 0; e + 2 < m_elements.size(); e += 3)
+			{
+				const unsigned int a{ Resolve(m_elements[e]) };
+				const unsigned int b{ Resolve(m_elements[e + 1]) };
+				const unsigned int c{ Resolve(m_elements[e + 2]) };
+				if (m_group[a] == m_group[b] || m_group[b] == m_group[c] || m_group[a] == m_group[c])
+					continue;
+
+				m_elements[kept++] = a;
+				m_elements[kept++] = b;
+				m_elements[kept++] = c;
+			}
+			m_elements.resize(kept);
+
+			std::fill(m_firstTriangle.begin(), m_firstTriangle.end(), 0);
+			for (unsigned int vertex : m_elements)
+				m_firstTriangle[m_group[vertex] + 1]++;
+			for (size_t g = 1; g < m_firstTriangle.size(); g++)
+				m_firstTriangle[g] += m_firstTriangle[g - 1];
+
+			m_groupTriangles.resize(m_elements.size());
+			std::vector<size_t> cursor(m_firstTriangle.begin(), m_firstTriangle.end() - 1);
+			for (size_t e = 0; e < m_elements.size(); e++)
+				m_groupTriangles[cursor[m_group[m_elements[e]]]++] = (unsigned int)(e / 3);
+		}
+	public:
+		QuadricSimplifier(const Mesh& mesh, float attributeWeight) : m_mesh(mesh), m_elements(mesh.elements)
+		{
+			const size_t vertexCount{ mesh.vertices.size() };
+
+			// Weld vertices in the same place into groups
+			std::unordered_map<glm::vec3, unsigned int, PositionHash> groups;
+			groups.reserve(vertexCount);
+			m_group.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				const auto found{ groups.try_emplace(mesh.vertices[v], (unsigned int)m_groupPositions.size()) };
+				if (found.second)
+				{
+					m_groupPositions.push_back(mesh.vertices[v]);
+					m_members.emplace_back();
+				}
+				m_group[v] = found.first->second;
+			}
+
+			m_collapsedTo.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+				m_collapsedTo[v] = (unsigned int)v;
+
+			// Only vertices that are drawn can be collapse targets
+			std::vector<bool> used(vertexCount, false);
+			for (unsigned int element : m_elements)
+			{
+				if (!used[element])
+					m_members[m_group[element]].push_back(element);
+				used[element] = true;
+			}
+
+			glm::vec3 minExtents{ 0 }, maxExtents{ 0 };
+			mesh.GetLocalExtents(minExtents, maxExtents);
+			m_attributeScale = glm::length(maxExtents - minExtents) * attributeWeight;
+			m_firstTriangle.resize(m_groupPositions.size() + 1);
+
+			// Face planes weighted by area, and planes along the boundary edges
+			m_quadrics.resize(m_groupPositions.size());
+			std::unordered_map<UINT64, int> edgeUse;
+			for (size_t e = 0; e + 2 < m_elements.size(); e += 3)
+			{
+				const unsigned int g[3]{ m_group[m_elements[e]], m_group[m_elements[e + 1]], m_group[m_elements[e + 2]] };
+				const glm::dvec3 p0{ m_groupPositions[g[0]] };
+				const glm::dvec3 normal{ glm::cross(glm::dvec3(m_groupPositions[g[1]]) - p0, glm::dvec3(m_groupPositions[g[2]]) - p0) };
+				const double area{ glm::length(normal) };
+				if (area <= 0)
+					continue;
+
+				const glm::dvec3 unit{ normal / area };
+				for (int c = 0; c < 3; c++)
+				{
+					m_quadrics[g[c]].AddPlane(unit, -glm::dot(unit, p0), area * 0.5);
+					const unsigned int low{ std::min(g[c], g[(c + 1) % 3]) };
+					const unsigned int high{ std::max(g[c], g[(c + 1) % 3]) };
+					edgeUse[((UINT64)low << 32) | high]++;
+				}
+			}
+
+			for (size_t e = 0; e + 2 < m_elements.size(); e += 3)
+			{
+				const unsigned int g[3]{ m_group[m_elements[e]], m_group[m_elements[e + 1]], m_group[m_elements[e + 2]] };
+				const glm::dvec3 p0{ m_groupPositions[g[0]] };
+				const glm::dvec3 normal{ glm::cross(glm::dvec3(m_groupPositions[g[1]]) - p0, glm::dvec3(m_groupPositions[g[2]]) - p0) };
+				const double area{ glm::length(normal) };
+				if (area <= 0)
+					continue;
+
+				for (int c = 0; c < 3; c++)
+				{
+					const unsigned int a{ g[c] };
+					const unsigned int b{ g[(c + 1) % 3] };
+					if (edgeUse[((UINT64)std::min(a, b) << 32) | std::max(a, b)] != 1)
+						continue;
+
+					const glm::dvec3 edge{ glm::dvec3(m_groupPositions[b]) - glm::dvec3(m_groupPositions[a]) };
+					const glm::dvec3 side{ glm::cross(edge, normal / area) };
+					const double length{ glm::length(side) };
+					if (length <= 0)
+						continue;
+
+					const glm::dvec3 unit{ side / length };
+					const double d{ -glm::dot(unit, glm::dvec3(m_groupPositions[a])) };
+					const double weight{ kBoundaryWeight * glm::dot(edge, edge) };
+					m_quadrics[a].AddPlane(unit, d, weight);
+					m_quadrics[b].AddPlane(unit, d, weight);
+				}
+			}
+
+			Compact();
+		}
+
+		size_t TriangleCount() const { return m_elements.size() / 3; }
+		const std::vector<unsigned int>& Elements() const { return m_elements; }
+
+		// One pass of collapses, cheapest first, none touching a group another collapse in the pass changed.
+		// Stops once the mesh is down to targetTriangles. Returns false if nothing could be collapsed
+		bool Pass(size_t targetTriangles)
+		{
+			std::vector<UINT64> edges;
+			edges.reserve(m_elements.size());
+			for (size_t e = 0; e < m_elements.size(); e += 3)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					const unsigned int a{ m_group[m_elements[e + c]] };
+					const unsigned int b{ m_group[m_elements[e + (c + 1) % 3]] };
+					edges.push_back(((UINT64)std::min(a, b) << 32) | std::max(a, b));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			// Cost of moving a group onto the other, the quadric error at the new place plus how far its
+			// vertices' normals and uvs are from the ones they become
+			std::vector<CollapseCandidate> candidates;
+			candidates.reserve(edges.size());
+			const double attributeScale{ (double)m_attributeScale * m_attributeScale };
+			for (UINT64 edge : edges)
+			{
+				CollapseCandidate best{ 0, 0, DBL_MAX };
+				for (int direction = 0; direction < 2; direction++)
+				{
+					const unsigned int from{ (unsigned int)(direction == 0 ? edge >> 32 : edge & 0xFFFFFFFF) };
+					const unsigned int to{ (unsigned int)(direction == 0 ? edge & 0xFFFFFFFF : edge >> 32) };
+
+					Quadric combined{ m_quadrics[from] };
+					combined.Add(m_quadrics[to]);
+					const double error{ combined.Error(m_groupPositions[to]) };
+
+					double attributes{ 0 };
+					for (unsigned int member : m_members[from])
+					{
+						float distance{ 0 };
+						ClosestMember(member, to, distance);
+						attributes += distance;
+					}
+
+					const double cost{ error + attributes * attributeScale };
+					if (cost < best.cost)
+						best = CollapseCandidate{ from, to, cost };
+				}
+				candidates.push_back(best);
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const CollapseCandidate& a, const CollapseCandidate& b) { return a.cost < b.cost; });
+
+			std::vector<bool> locked(m_groupPositions.size(), false);
+			size_t triangles{ TriangleCount() };
+			bool collapsed{ false };
+			for (const CollapseCandidate& candidate : candidates)
+			{
+				if (triangles <= targetTriangles)
+					break;
+				if (locked[candidate.from] || locked[candidate.to] || Flips(candidate.from, candidate.to))
+					continue;
+
+				for (unsigned int member : m_members[candidate.from])
+				{
+					float distance{ 0 };
+					m_collapsedTo[member] = ClosestMember(member, candidate.to, distance);
+				}
+				m_members[candidate.from].clear();
+				m_quadrics[candidate.to].Add(m_quadrics[candidate.from]);
+
+				// Everything around from changes so none of it can be collapsed again until the next pass
+				for (size_t i = m_firstTriangle[candidate.from]; i < m_firstTriangle[candidate.from + 1]; i++)
+				{
+					const unsigned int* triangle{ &m_elements[(size_t)m_groupTriangles[i] * 3] };
+					bool hasTo{ false };
+					for (int c = 0; c < 3; c++)
+					{
+						locked[m_group[triangle[c]]] = true;
+						hasTo = hasTo || m_group[triangle[c]] == candidate.to;
+					}
+					triangles -= hasTo ? 1 : 0;
+				}
+				collapsed = true;
+			}
+
+			Compact();
+			return collapsed;
+		}
+	};
+
+	// Closest point to p on triangle abc, from Ericson's Real-Time Collision Detection
+	static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		const glm::vec3 ab{ b - a }, ac{ c - a }, ap{ p - a };
+		const float d1{ glm::dot(ab, ap) }, d2{ glm::dot(ac, ap) };
+		if (d1 <= 0 && d2 <= 0)
+			return a;
+
+		const glm::vec3 bp{ p - b };
+		const float d3{ glm::dot(ab, bp) }, d4{ glm::dot(ac, bp) };
+		if (d3 >= 0 && d4 <= d3)
+			return b;
+
+		const float vc{ d1 * d4 - d3 * d2 };
+		if (vc <= 0 && d1 >= 0 && d3 <= 0)
+			return a + ab * (d1 / (d1 - d3));
+
+		const glm::vec3 cp{ p - c };
+		const float d5{ glm::dot(ab, cp) }, d6{ glm::dot(ac, cp) };
+		if (d6 >= 0 && d5 <= d6)
+			return c;
+
+		const float vb{ d5 * d2 - d1 * d6 };
+		if (vb <= 0 && d2 >= 0 && d6 <= 0)
+			return a + ac * (d2 / (d2 - d6));
+
+		const float va{ d3 * d6 - d5 * d4 };
+		if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		const float denominator{ 1.0f / (va + vb + vc) };
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// Triangles bucketed into a uniform grid by their bounds, for finding the nearest surface to a point
+	class TriangleGrid
+	{
+	private:
+		const std::vector<glm::vec3>& m_vertices;
+		const std::vector<unsigned int>& m_elements;
+
+		glm::vec3 m_origin{ 0 };
+		float m_cellSize{ 1 };
+		glm::ivec3 m_cells{ 1 };
+
+		// Triangles overlapping each cell
+		std::vector<size_t> m_firstTriangle;
+		std::vector<unsigned int> m_triangles;
+
+		// Query each triangle was last tested in, so ones spanning several cells are tested once
+		mutable std::vector<unsigned int> m_tested;
+		mutable unsigned int m_query{ 0 };
+
+		glm::ivec3 Cell(const glm::vec3& point) const
+		{
+			return glm::clamp(glm::ivec3(glm::floor((point - m_origin) / m_cellSize)), glm::ivec3(0), m_cells - 1);
+		}
+
+		size_t CellIndex(const glm::ivec3& cell) const
+		{
+			return ((size_t)cell.z * m_cells.y + cell.y) * m_cells.x + cell.x;
+		}
+
+		template<typename Func>
+		void ForEachCell(size_t triangle, Func&& func) const
+		{
+			const glm::vec3& a{ m_vertices[m_elements[triangle * 3]] };
+			const glm::vec3& b{ m_vertices[m_elements[triangle * 3 + 1]] };
+			const glm::vec3& c{ m_vertices[m_elements[triangle * 3 + 2]] };
+			const glm::ivec3 low{ Cell(glm::min(a, glm::min(b, c))) };
+			const glm::ivec3 high{ Cell(glm::max(a, glm::max(b, c))) };
+			for (int z = low.z; z <= high.z; z++)
+				for (int y = low.y; y <= high.y; y++)
+					for (int x = low.x; x <= high.x; x++)
+						func(CellIndex(glm::ivec3(x, y, z)));
+		}
+	public:
+		TriangleGrid(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& elements) :
+			m_vertices(vertices), m_elements(elements)
+		{
+			const size_t triangleCount{ elements.size() / 3 };
+			glm::vec3 minExtents{ FLT_MAX }, maxExtents{ -FLT_MAX };
+			for (unsigned int element : elements)
+			{
+				minExtents = glm::min(minExtents, vertices[element]);
+				maxExtents = glm::max(maxExtents, vertices[element]);
+			}
+			if (triangleCount == 0)
+				minExtents = maxExtents = glm::vec3(0);
+
+			// About as many cells as triangles, with flat meshes kept to kMaxGridCells across
+			const glm::vec3 size{ maxExtents - minExtents };
+			const float largest{ std::max(size.x, std::max(size.y, size.z)) };
+			const float volumePerTriangle{ size.x * size.y * size.z / std::max<float>((float)triangleCount, 1.0f) };
+			m_cellSize = largest > 0 ? std::max(std::cbrt(volumePerTriangle), largest / kMaxGridCells) : 1.0f;
+			m_origin = minExtents;
+			m_cells = glm::max(glm::ivec3(glm::floor(size / m_cellSize)) + 1, glm::ivec3(1));
+
+			m_firstTriangle.assign((size_t)m_cells.x * m_cells.y * m_cells.z + 1, 0);
+			for (size_t t = 0; t < triangleCount; t++)
+				ForEachCell(t, [&](size_t cell) { m_firstTriangle[cell + 1]++; });
+			for (size_t c = 1; c < m_firstTriangle.size(); c++)
+				m_firstTriangle[c] += m_firstTriangle[c - 1];
+
+			m_triangles.resize(m_firstTriangle.back());
+			std::vector<size_t> cursor(m_firstTriangle.begin(), m_firstTriangle.end() - 1);
+			for (size_t t = 0; t < triangleCount; t++)
+				ForEachCell(t, [&](size_t cell) { m_triangles[cursor[cell]++] = (unsigned int)t; });
+
+			m_tested.assign(triangleCount, 0);
+		}
+
+		// Distance from point to the nearest triangle. Searches shells of cells outwards from the point's cell
+		// until the next shell is further away than the nearest triangle found. Any triangle within enough ends
+		// the search early, its distance is returned and may not be the nearest
+		float Distance(const glm::vec3& point, float enough) const
+		{
+			if (m_triangles.empty())
+				return 0;
+
+			m_query++;
+			const glm::ivec3 centre{ Cell(point) };
+			const int maxShell{ std::max(m_cells.x, std::max(m_cells.y, m_cells.z)) };
+			float best{ FLT_MAX };
+			for (int shell = 0; shell <= maxShell; shell++)
+			{
+				const glm::ivec3 low{ glm::max(centre - shell, glm::ivec3(0)) };
+				const glm::ivec3 high{ glm::min(centre + shell, m_cells - 1) };
+				for (int z = low.z; z <= high.z; z++)
+				{
+					for (int y = low.y; y <= high.y; y++)
+					{
+						for (int x = low.x; x <= high.x; x++)
+						{
+							// Only the surface of the shell, the inside was searched already
+							if (std::max(std::abs(x - centre.x), std::max(std::abs(y - centre.y), std::abs(z - centre.z))) != shell)
+								continue;
+
+							const size_t cell{ CellIndex(glm::ivec3(x, y, z)) };
+							for (size_t i = m_firstTriangle[cell]; i < m_firstTriangle[cell + 1]; i++)
+							{
+								const unsigned int triangle{ m_triangles[i] };
+								if (m_tested[triangle] == m_query)
+									continue;
+								m_tested[triangle] = m_query;
+
+								const glm::vec3 closest{ ClosestPointOnTriangle(point, m_vertices[m_elements[triangle * 3]],
+									m_vertices[m_elements[triangle * 3 + 1]], m_vertices[m_elements[triangle * 3 + 2]]) };
+								best = std::min(best, glm::distance(point, closest));
+								if (best <= enough)
+									return best;
+							}
+						}
+					}
+				}
+
+				// Anything in the next shell is at least this far away
+				if (best <= shell * m_cellSize)
+					break;
+			}
+			return best;
+		}
+	};
+
+	// Points across the triangles no further apart than spacing passed to func, each vertex used once
+	template<typename Func>
+	static void SampleTriangles(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& elements, float spacing, Func&& func)
+	{
+		std::vector<bool> sampled(vertices.size(), false);
+		for (unsigned int element : elements)
+		{
+			if (!sampled[element])
+				func(vertices[element]);
+			sampled[element] = true;
+		}
+
+		for (size_t e = 0; e + 2 < elements.size(); e += 3)
+		{
+			const glm::vec3& a{ vertices[elements[e]] };
+			const glm::vec3& b{ vertices[elements[e + 1]] };
+			const glm::vec3& c{ vertices[elements[e + 2]] };
+			const float longest{ std::max(glm::distance(a, b), std::max(glm::distance(b, c), glm::distance(c, a))) };
+			const int steps{ spacing > 0 ? std::clamp((int)std::ceil(longest / spacing), 1, kMaxSampleSteps) : 1 };
+			for (int i = 0; i <= steps; i++)
+			{
+				for (int j = 0; i + j <= steps; j++)
+				{
+					const bool corner{ (i == 0 && j == 0) || i == steps || j == steps };
+					const float u{ (float)i / steps }, v{ (float)j / steps };
+					if (!corner)
+						func(a + (b - a) * u + (c - a) * v);
+				}
+			}
+		}
+	}
+
+	// Hausdorff distance between the surfaces of two sets of triangles over the same vertices, measured at points
+	// spread across each surface no further apart than spacing. Only the largest distance matters, so a point's
+	// search stops as soon as it finds the other surface no further than the largest so far
+	static float SurfaceDistance(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& elementsA,
+		const std::vector<unsigned int>& elementsB, float spacing)
+	{
+		const TriangleGrid gridA(vertices, elementsA);
+		const TriangleGrid gridB(vertices, elementsB);
+		float distance{ 0 };
+		SampleTriangles(vertices, elementsA, spacing, [&](const glm::vec3& point) { distance = std::max(distance, gridB.Distance(point, distance)); });
+		SampleTriangles(vertices, elementsB, spacing, [&](const glm::vec3& point) { distance = std::max(distance, gridA.Distance(point, distance)); });
+		return distance;
+	}
+
+	// Simplifies level after level, each carrying on from the one before
+	void GenerateMeshLods(Mesh& mesh, const LodSettings& settings)
+	{
+		mesh.lods.clear();
+		if (mesh.elements.size() / 3 <= settings.minTriangles)
+			return;
+
+		QuadricSimplifier simplifier(mesh, settings.attributeWeight);
+		size_t previousTriangles{ mesh.elements.size() / 3 };
+
+		// Levels are measured at points about as far apart as the full detail mesh's vertices
+		glm::vec3 minExtents{ 0 }, maxExtents{ 0 };
+		mesh.GetLocalExtents(minExtents, maxExtents);
+		const float spacing{ glm::length(maxExtents - minExtents) / std::sqrt((float)previousTriangles) };
+		while ((int)mesh.lods.size() < settings.maxLevels)
+		{
+			const size_t target{ std::max((size_t)(previousTriangles * settings.reduction), settings.minTriangles) };
+			while (simplifier.TriangleCount() > target && simplifier.Pass(target))
+				;
+
+			// A level that barely changed isn't worth drawing
+			const size_t triangles{ simplifier.TriangleCount() };
+			if (triangles == 0 || triangles > previousTriangles * (1.0f + settings.reduction) * 0.5f)
+				break;
+
+			MeshLod lod;
+			lod.elements = simplifier.Elements();
+			lod.error = SurfaceDistance(mesh.vertices, mesh.elements, lod.elements, spacing);
+			OptimizeVertexCache(lod.elements, mesh.vertices.size());
+			mesh.lods.push_back(std::move(lod));
+
+			previousTriangles = triangles;
+			if (triangles <= settings.minTriangles)
+				break;
+		}
+	}
+
+	// Pixels covered by a length at distance
+	float ProjectedLength(float length, float distance, float fovY, float viewportHeight)
+	{
+		return viewportHeight * length / (2.0f * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f));
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+// Level of detail generation. A mesh is simplified with quadric error metrics (Garland and Heckbert 1997),
+// collapsing edges onto one of their ends so every level draws a subset of the mesh's own vertices and only
+// needs its own elements. Vertices are welded by position first, so meshes split at uv or normal seams still
+// simplify as one surface, and a collapsed vertex moves to the vertex at its new position with the nearest
+// normal and uv, with that difference added to the cost so seams and creases go last.
+
+#include "Mesh.h"
+
+namespace Helpers
+{
+	struct LodSettings
+	{
+		// Each level aims for this fraction of the triangles of the level before
+		float reduction{ 0.5f };
+
+		// No level is made with fewer triangles than this, and at most maxLevels are made
+		size_t minTriangles{ 32 };
+		int maxLevels{ 6 };
+
+		// Cost of a normal or uv difference, as a fraction of the mesh size moved
+		float attributeWeight{ 0.05f };
+	};
+
+	// Replaces mesh.lods with a chain of simplified levels, coarsest last. Each records its geometric error, the
+	// Hausdorff distance in model units between its surface and the original's, measured at sample points
+	void GenerateMeshLods(Mesh& mesh, const LodSettings& settings = LodSettings());
+
+	// Pixels a length in model units covers on screen at distance, used to turn a LOD's error into pixels
+	float ProjectedLength(float length, float distance, float fovY, float viewportHeight);
+}
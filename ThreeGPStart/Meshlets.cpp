@@ -0,0 +1,273 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+
+namespace Helpers
+{
+	// When a meshlet has no unused neighbours left, the nearest of this many unused triangles that follow in
+	// the cache order carries it on, which joins pieces split at uv seams or made of separate parts
+	constexpr size_t kMeshletSearchWindow{ 32 };
+
+	// Sphere around the meshlet's vertices, and the cone around its face normals
+	static void ComputeMeshletBounds(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& elements, Meshlet& meshlet)
+	{
+		glm::vec3 minExtents{ FLT_MAX }, maxExtents{ -FLT_MAX };
+		for (unsigned int i = meshlet.firstElement; i < meshlet.firstElement + meshlet.elementCount; i++)
+		{
+			minExtents = glm::min(minExtents, vertices[elements[i]]);
+			maxExtents = glm::max(maxExtents, vertices[elements[i]]);
+		}
+		meshlet.centre = (minExtents + maxExtents) * 0.5f;
+		meshlet.radius = 0;
+		for (unsigned int i = meshlet.firstElement; i < meshlet.firstElement + meshlet.elementCount; i++)
+			meshlet.radius = std::max(meshlet.radius, glm::distance(meshlet.centre, vertices[elements[i]]));
+
+		// Degenerate triangles have no normal and don't limit the cone
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshlet.elementCount / 3);
+		glm::vec3 normalSum{ 0 };
+		for (unsigned int i = meshlet.firstElement; i < meshlet.firstElement + meshlet.elementCount; i += 3)
+		{
+			const glm::vec3 p0{ vertices[elements[i]] };
+			const glm::vec3 normal{ glm::cross(vertices[elements[i + 1]] - p0, vertices[elements[i + 2]] - p0) };
+			const float length{ glm::length(normal) };
+			if (length <= 0)
+				continue;
+			normals.push_back(normal / length);
+			normalSum += normals.back();
+		}
+
+		meshlet.coneAxis = glm::vec3(0);
+		meshlet.coneCutoff = 1;
+		const float sumLength{ glm::length(normalSum) };
+		if (sumLength <= 0)
+			return;
+
+		meshlet.coneAxis = normalSum / sumLength;
+		float minDot{ 1 };
+		for (const glm::vec3& normal : normals)
+			minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+		// Faces more than a right angle apart can't all face away at once
+		if (minDot > 0)
+			meshlet.coneCutoff = std::sqrt(1 - minDot * minDot);
+	}
+
+	// Greedy growth from the first unused triangle each time
+	void BuildMeshlets(Mesh& mesh)
+	{
+		mesh.meshlets.clear();
+		const size_t triangleCount{ mesh.elements.size() / 3 };
+		const size_t vertexCount{ mesh.vertices.size() };
+		if (triangleCount == 0)
+			return;
+
+		// Vertices split at uv seams or hard edges share a position, neighbours are found through that
+		std::vector<unsigned int> byPosition(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			byPosition[v] = (unsigned int)v;
+		std::sort(byPosition.begin(), byPosition.end(), [&](unsigned int a, unsigned int b)
+		{
+			const glm::vec3& pa{ mesh.vertices[a] };
+			const glm::vec3& pb{ mesh.vertices[b] };
+			return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+		});
+		std::vector<unsigned int> position(vertexCount);
+		size_t positionCount{ 0 };
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			if (i > 0 && mesh.vertices[byPosition[i]] != mesh.vertices[byPosition[i - 1]])
+				positionCount++;
+			position[byPosition[i]] = (unsigned int)positionCount;
+		}
+		positionCount++;
+
+		// Triangles using each position
+		std::vector<size_t> firstUse(positionCount + 1, 0);
+		for (unsigned int element : mesh.elements)
+			firstUse[position[element] + 1]++;
+		for (size_t p = 0; p < positionCount; p++)
+			firstUse[p + 1] += firstUse[p];
+		std::vector<unsigned int> uses(firstUse[positionCount]);
+		{
+			std::vector<size_t> next(firstUse.begin(), firstUse.end() - 1);
+			for (size_t i = 0; i < triangleCount * 3; i++)
+				uses[next[position[mesh.elements[i]]]++] = (unsigned int)(i / 3);
+		}
+
+		std::vector<glm::vec3> centroids(triangleCount);
+		std::vector<glm::vec3> faceNormals(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const glm::vec3 p0{ mesh.vertices[mesh.elements[t * 3]] };
+			const glm::vec3 p1{ mesh.vertices[mesh.elements[t * 3 + 1]] };
+			const glm::vec3 p2{ mesh.vertices[mesh.elements[t * 3 + 2]] };
+			centroids[t] = (p0 + p1 + p2) / 3.0f;
+			const glm::vec3 normal{ glm::cross(p1 - p0, p2 - p0) };
+			const float length{ glm::length(normal) };
+			faceNormals[t] = length > 0 ? normal / length : glm::vec3(0);
+		}
+
+		// How far a candidate is from the meshlet is scaled by up to this much more the further its face turns
+		// from the meshlet's, so meshlets stop at creases and keep tight normal cones
+		constexpr float kMeshletConeWeight{ 4.0f };
+		const auto score = [&](size_t triangle, const glm::vec3& centre, const glm::vec3& axis)
+		{
+			return glm::distance(centroids[triangle], centre) * (1 + kMeshletConeWeight * (1 - glm::dot(faceNormals[triangle], axis)));
+		};
+
+		std::vector<bool> used(triangleCount, false);
+
+		// The meshlet each vertex was last added to
+		std::vector<unsigned int> vertexMeshlet(vertexCount, UINT_MAX);
+
+		std::vector<unsigned int> elements;
+		elements.reserve(mesh.elements.size());
+		std::vector<unsigned int> triangles;
+		std::vector<unsigned int> candidates;
+		size_t seed{ 0 };
+		while (true)
+		{
+			while (seed < triangleCount && used[seed])
+				seed++;
+			if (seed == triangleCount)
+				break;
+
+			const unsigned int meshletIndex{ (unsigned int)mesh.meshlets.size() };
+			const auto newVertices = [&](size_t triangle)
+			{
+				size_t count{ 0 };
+				for (size_t c = 0; c < 3; c++)
+					count += vertexMeshlet[mesh.elements[triangle * 3 + c]] != meshletIndex ? 1 : 0;
+				return count;
+			};
+
+			triangles.clear();
+			candidates.clear();
+			size_t meshletVertices{ 0 };
+			glm::vec3 centroidSum{ 0 };
+			glm::vec3 normalSum{ 0 };
+			size_t next{ seed };
+			while (true)
+			{
+				used[next] = true;
+				triangles.push_back((unsigned int)next);
+				centroidSum += centroids[next];
+				normalSum += faceNormals[next];
+				for (size_t c = 0; c < 3; c++)
+				{
+					const unsigned int vertex{ mesh.elements[next * 3 + c] };
+					if (vertexMeshlet[vertex] == meshletIndex)
+						continue;
+
+					vertexMeshlet[vertex] = meshletIndex;
+					meshletVertices++;
+					for (size_t i = firstUse[position[vertex]]; i < firstUse[position[vertex] + 1]; i++)
+					{
+						if (!used[uses[i]])
+							candidates.push_back(uses[i]);
+					}
+				}
+				if (triangles.size() == kMeshletMaxTriangles)
+					break;
+
+				// Fewest new vertices first, then the closest to the middle of the meshlet so far and facing its way
+				const glm::vec3 centre{ centroidSum / (float)triangles.size() };
+				const glm::vec3 axis{ glm::length(normalSum) > 0 ? glm::normalize(normalSum) : glm::vec3(0) };
+				size_t best{ SIZE_MAX };
+				size_t bestNew{ 4 };
+				float bestDistance{ FLT_MAX };
+				size_t kept{ 0 };
+				for (unsigned int candidate : candidates)
+				{
+					if (used[candidate])
+						continue;
+					candidates[kept++] = candidate;
+
+					const size_t added{ newVertices(candidate) };
+					const float distance{ score(candidate, centre, axis) };
+					if (meshletVertices + added <= kMeshletMaxVertices && (added < bestNew || (added == bestNew && distance < bestDistance)))
+					{
+						best = candidate;
+						bestNew = added;
+						bestDistance = distance;
+					}
+				}
+				candidates.resize(kept);
+
+				if (best == SIZE_MAX)
+				{
+					size_t looked{ 0 };
+					for (size_t t = seed; t < triangleCount && looked < kMeshletSearchWindow; t++)
+					{
+						if (used[t])
+							continue;
+						looked++;
+
+						const float distance{ score(t, centre, axis) };
+						if (meshletVertices + newVertices(t) <= kMeshletMaxVertices && distance < bestDistance)
+						{
+							best = t;
+							bestDistance = distance;
+						}
+					}
+				}
+				if (best == SIZE_MAX)
+					break;
+
+				next = best;
+			}
+
+			// Back in the order the vertex cache optimiser left them
+			std::sort(triangles.begin(), triangles.end());
+
+			Meshlet meshlet;
+			meshlet.firstElement = (unsigned int)elements.size();
+			meshlet.elementCount = (unsigned int)triangles.size() * 3;
+			for (unsigned int triangle : triangles)
+				elements.insert(elements.end(), mesh.elements.begin() + triangle * 3, mesh.elements.begin() + triangle * 3 + 3);
+			ComputeMeshletBounds(mesh.vertices, elements, meshlet);
+			mesh.meshlets.push_back(meshlet);
+		}
+
+		mesh.elements.swap(elements);
+	}
+
+	// Gribb and Hartmann, each plane is the last row of the matrix plus or minus one of the others
+	std::array<glm::vec4, 6> FrustumPlanes(const glm::mat4& xform)
+	{
+		const auto row = [&](int i) { return glm::vec4(xform[0][i], xform[1][i], xform[2][i], xform[3][i]); };
+
+		std::array<glm::vec4, 6> planes{ row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(3) + row(2), row(3) - row(2) };
+		for (glm::vec4& plane : planes)
+			plane /= glm::length(glm::vec3(plane));
+		return planes;
+	}
+
+	size_t CullMeshlets(const std::vector<Meshlet>& meshlets, const std::array<glm::vec4, 6>& frustum, const glm::vec3& eye,
+		std::vector<ElementRange>& ranges)
+	{
+		ranges.clear();
+		size_t visible{ 0 };
+		for (const Meshlet& meshlet : meshlets)
+		{
+			bool inside{ true };
+			for (const glm::vec4& plane : frustum)
+				inside = inside && glm::dot(glm::vec3(plane), meshlet.centre) + plane.w >= -meshlet.radius;
+			if (!inside)
+				continue;
+
+			const glm::vec3 toCentre{ meshlet.centre - eye };
+			if (glm::dot(toCentre, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCentre) + meshlet.radius)
+				continue;
+
+			visible++;
+			if (!ranges.empty() && ranges.back().firstElement + ranges.back().elementCount == meshlet.firstElement)
+				ranges.back().elementCount += meshlet.elementCount;
+			else
+				ranges.push_back({ meshlet.firstElement, meshlet.elementCount });
+		}
+		return visible;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+// Meshlets split a mesh into small clusters of triangles that can be culled one by one. They are grown from
+// the mesh's cache optimised triangle order, always adding the neighbour that brings in fewest new vertices,
+// so each stays compact. Each gets a bounding sphere for frustum culling and a cone holding its face normals,
+// which rejects clusters facing away from the eye. ModelLoader builds them on import.
+
+#include "Mesh.h"
+
+#include <array>
+
+namespace Helpers
+{
+	// Limits per meshlet, the sizes mesh shaders are tuned for
+	constexpr size_t kMeshletMaxVertices{ 64 };
+	constexpr size_t kMeshletMaxTriangles{ 124 };
+
+	// Groups the mesh's triangles into meshlets, reordering elements so each meshlet is a contiguous run. The
+	// order within a meshlet is kept, so it stays vertex cache friendly
+	void BuildMeshlets(Mesh& mesh);
+
+	// Frustum planes, normals pointing in, from a combined projection, view and model matrix so they are in
+	// model coordinates
+	std::array<glm::vec4, 6> FrustumPlanes(const glm::mat4& xform);
+
+	// Part of a mesh's elements to draw
+	struct ElementRange
+	{
+		unsigned int firstElement{ 0 };
+		unsigned int elementCount{ 0 };
+	};
+
+	// Replaces ranges with the elements of the meshlets inside the frustum and facing eye, in model coordinates.
+	// Neighbouring meshlets are joined into one range. Returns the number of meshlets that passed
+	size_t CullMeshlets(const std::vector<Meshlet>& meshlets, const std::array<glm::vec4, 6>& frustum, const glm::vec3& eye,
+		std::vector<ElementRange>& ranges);
+}
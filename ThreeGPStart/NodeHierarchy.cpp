@@ -0,0 +1,99 @@
+#include "NodeHierarchy.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cassert>
+
+namespace Helpers
+{
+	// result = a * b for column major matrices. Each column of the result is the columns of a weighted by the
+	// matching column of b. result must not be a or b
+	static void MultiplyTransforms(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+	{
+		const __m128 a0{ _mm_loadu_ps(&a[0][0]) };
+		const __m128 a1{ _mm_loadu_ps(&a[1][0]) };
+		const __m128 a2{ _mm_loadu_ps(&a[2][0]) };
+		const __m128 a3{ _mm_loadu_ps(&a[3][0]) };
+		for (int column = 0; column < 4; column++)
+		{
+			__m128 sum{ _mm_mul_ps(a0, _mm_set1_ps(b[column][0])) };
+			sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+			sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+			_mm_storeu_ps(&result[column][0], sum);
+		}
+	}
+
+	size_t NodeHierarchy::Add(Node node, int parent, const glm::mat4& localTransform)
+	{
+		assert(parent == kNoNode || (parent >= 0 && (size_t)parent < m_nodes.size()));
+
+		m_nameIndex.emplace(node.name, (int)m_nodes.size());
+		m_nodes.push_back(std::move(node));
+		m_parents.push_back(parent);
+		m_localTransforms.push_back(localTransform);
+		m_worldTransforms.push_back(localTransform);
+		m_dirty.push_back(1);
+		m_anyDirty = true;
+		return m_nodes.size() - 1;
+	}
+
+	void NodeHierarchy::Reserve(size_t count)
+	{
+		m_nodes.reserve(count);
+		m_parents.reserve(count);
+		m_localTransforms.reserve(count);
+		m_worldTransforms.reserve(count);
+		m_dirty.reserve(count);
+		m_nameIndex.reserve(count);
+	}
+
+	void NodeHierarchy::Clear()
+	{
+		m_nodes.clear();
+		m_parents.clear();
+		m_localTransforms.clear();
+		m_worldTransforms.clear();
+		m_dirty.clear();
+		m_nameIndex.clear();
+		m_anyDirty = false;
+	}
+
+	void NodeHierarchy::SetLocalTransform(size_t index, const glm::mat4& transform)
+	{
+		m_localTransforms[index] = transform;
+		m_dirty[index] = 1;
+		m_anyDirty = true;
+	}
+
+	// Parents come first so theirs are always up to date by the time a child is reached
+	void NodeHierarchy::UpdateWorldTransforms()
+	{
+		if (!m_anyDirty)
+			return;
+
+		const size_t count{ m_parents.size() };
+		for (size_t i = 0; i < count; i++)
+		{
+			const int parent{ m_parents[i] };
+			if (parent == kNoNode)
+			{
+				if (m_dirty[i])
+					m_worldTransforms[i] = m_localTransforms[i];
+				continue;
+			}
+
+			m_dirty[i] |= m_dirty[parent];
+			if (m_dirty[i])
+				MultiplyTransforms(m_worldTransforms[parent], m_localTransforms[i], m_worldTransforms[i]);
+		}
+
+		std::fill(m_dirty.begin(), m_dirty.end(), (unsigned char)0);
+		m_anyDirty = false;
+	}
+
+	int NodeHierarchy::Find(const std::string& name) const
+	{
+		const auto found{ m_nameIndex.find(name) };
+		return found != m_nameIndex.end() ? found->second : kNoNode;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+// A model's node hierarchy stored flat. Nodes are referred to by index and kept in topological order, every
+// parent before its children, so world transforms are worked out in one pass front to back with no recursion
+// or pointer chasing. The transforms and parent indices are parallel arrays kept apart from the names and
+// meshes, so that pass only reads the data it needs. Animation, see AnimationSampler.h, sets local transforms.
+
+#include "ExternalLibraryHeaders.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Helpers
+{
+	// Everything about a node apart from its transforms
+	struct Node
+	{
+		std::string name;
+		std::vector<unsigned int> meshIndices;
+	};
+
+	class NodeHierarchy
+	{
+	private:
+		std::vector<Node> m_nodes;
+		std::vector<int> m_parents;
+		std::vector<glm::mat4> m_localTransforms;
+		std::vector<glm::mat4> m_worldTransforms;
+
+		// Set when a local transform changes, the update spreads it to the children
+		std::vector<unsigned char> m_dirty;
+		bool m_anyDirty{ false };
+
+		// First node with each name, kept up to date by Add so Find doesn't search
+		std::unordered_map<std::string, int> m_nameIndex;
+	public:
+		static constexpr int kNoNode{ -1 };
+
+		// Adds a node under parent, which must already have been added, or as a root. Returns its index.
+		// Its name is indexed for Find so must not be changed afterwards
+		size_t Add(Node node, int parent, const glm::mat4& localTransform);
+
+		void Reserve(size_t count);
+		void Clear();
+
+		size_t Size() const { return m_nodes.size(); }
+		bool Empty() const { return m_nodes.empty(); }
+
+		Node& GetNode(size_t index) { return m_nodes[index]; }
+		const Node& GetNode(size_t index) const { return m_nodes[index]; }
+		int GetParent(size_t index) const { return m_parents[index]; }
+
+		const glm::mat4& GetLocalTransform(size_t index) const { return m_localTransforms[index]; }
+		void SetLocalTransform(size_t index, const glm::mat4& transform);
+
+		// Model space transforms, current as of the last UpdateWorldTransforms
+		const glm::mat4& GetWorldTransform(size_t index) const { return m_worldTransforms[index]; }
+		const std::vector<glm::mat4>& GetWorldTransforms() const { return m_worldTransforms; }
+
+		// Recalculates the world transform of every node whose local transform, or an ancestor's, has changed
+		void UpdateWorldTransforms();
+
+		// Index of the first node called name, or kNoNode if there isn't one
+		int Find(const std::string& name) const;
+	};
+}
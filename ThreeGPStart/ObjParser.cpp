@@ -0,0 +1,671 @@
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include <atomic>
+#include <charconv>
+#include <fstream>
+#include <unordered_map>
+
+// Native Wavefront OBJ and MTL reader used by ModelLoader in place of assimp for .obj files.
+// The file is mapped and cut into line aligned chunks that are parsed on their own threads, each keeping its
+// own streams and faces. Indices are then made global, faces grouped into one mesh per object and material
+// and every mesh's corners deduplicated by value with a hash table, which gives the same meshes, materials and
+// nodes assimp produces with the post processing LoadFromFile asks for. Values must match exactly where assimp
+// allows a tiny epsilon, so vertices differing only by rounding noise stay separate here.
+
+namespace Helpers
+{
+	// Files smaller than this are parsed on one thread
+	constexpr size_t kObjMinChunkBytes{ 1 << 20 };
+
+	// One corner of a triangle as 0 based indices into the file's streams, -1 where the face leaves one out.
+	// Negative (relative) indices are local to the chunk until its stream offsets are added
+	struct ObjCorner
+	{
+		INT32 position;
+		INT32 uv;
+		INT32 normal;
+		UINT32 relative;	// bit 0 position, 1 uv, 2 normal
+
+		bool operator==(const ObjCorner& other) const
+		{
+			return position == other.position && uv == other.uv && normal == other.normal;
+		}
+	};
+
+	// An o, g or usemtl line, applying to the triangles from firstCorner on
+	struct ObjStatement
+	{
+		size_t firstCorner;
+		bool material;
+		std::string name;
+	};
+
+	// What one thread parsed from its part of the file
+	struct ObjChunk
+	{
+		const char* begin{ nullptr };
+		const char* end{ nullptr };
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+
+		// Faces fanned into triangles, three corners each
+		std::vector<ObjCorner> corners;
+		std::vector<ObjStatement> statements;
+		std::vector<std::string> materialLibraries;
+
+		bool ok{ true };
+	};
+
+	// Triangles of one object and material from one chunk
+	struct ObjRun
+	{
+		size_t chunk;
+		size_t firstCorner;
+		size_t endCorner;
+	};
+
+	static const char* SkipSpaces(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		return p;
+	}
+
+	// Rest of the line without surrounding white space
+	static std::string RestOfLine(const char* p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+			end--;
+		return std::string(p, end);
+	}
+
+	// Returns nullptr if there isn't a number next
+	static const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		p = SkipSpaces(p, end);
+		if (p < end && *p == '+')
+			p++;
+
+		const std::from_chars_result result{ std::from_chars(p, end, value) };
+		return result.ec == std::errc() ? result.ptr : nullptr;
+	}
+
+	// Converts a 1 based OBJ index, negative ones count back from the last element read so far in the chunk
+	static bool ObjIndex(int index, size_t localCount, INT32& out, UINT32& relative, UINT32 relativeBit)
+	{
+		if (index > 0)
+			out = index - 1;
+		else if (index < 0)
+		{
+			out = (INT32)localCount + index;
+			relative |= relativeBit;
+		}
+		else
+			return false;
+
+		return true;
+	}
+
+	// Parses one f line, "v", "v/vt", "v//vn" or "v/vt/vn" per corner, and fans it into triangles
+	static bool ParseFace(const char* p, const char* end, ObjChunk& chunk, std::vector<ObjCorner>& polygon)
+	{
+		polygon.clear();
+		for (p = SkipSpaces(p, end); p < end && *p != '\r'; p = SkipSpaces(p, end))
+		{
+			ObjCorner corner{ -1, -1, -1, 0 };
+			int index{ 0 };
+			std::from_chars_result result{ std::from_chars(p, end, index) };
+			if (result.ec != std::errc() || !ObjIndex(index, chunk.positions.size(), corner.position, corner.relative, 1))
+				return false;
+			p = result.ptr;
+
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (p < end && *p != '/')
+				{
+					result = std::from_chars(p, end, index);
+					if (result.ec != std::errc() || !ObjIndex(index, chunk.uvs.size(), corner.uv, corner.relative, 2))
+						return false;
+					p = result.ptr;
+				}
+
+				if (p < end && *p == '/')
+				{
+					result = std::from_chars(p + 1, end, index);
+					if (result.ec != std::errc() || !ObjIndex(index, chunk.normals.size(), corner.normal, corner.relative, 4))
+						return false;
+					p = result.ptr;
+				}
+			}
+
+			polygon.push_back(corner);
+		}
+
+		// Fewer than three corners is a line or point, which assimp is told to drop
+		for (size_t i = 2; i < polygon.size(); i++)
+		{
+			chunk.corners.push_back(polygon[0]);
+			chunk.corners.push_back(polygon[i - 1]);
+			chunk.corners.push_back(polygon[i]);
+		}
+		return true;
+	}
+
+	// Parses the lines of one chunk. Keywords that don't affect the meshes (s, vp, l, p ...) are skipped
+	static void ParseObjChunk(ObjChunk& chunk)
+	{
+		std::vector<ObjCorner> polygon;
+		const char* line{ chunk.begin };
+		while (line < chunk.end && chunk.ok)
+		{
+			const char* lineEnd{ (const char*)memchr(line, '\n', chunk.end - line) };
+			if (!lineEnd)
+				lineEnd = chunk.end;
+
+			const char* p{ SkipSpaces(line, lineEnd) };
+			const size_t length{ (size_t)(lineEnd - p) };
+			const auto keyword = [&](const char* word, size_t wordLength)
+			{
+				return length > wordLength && memcmp(p, word, wordLength) == 0 && (p[wordLength] == ' ' || p[wordLength] == '\t');
+			};
+
+			if (keyword("v", 1))
+			{
+				glm::vec3 position;
+				const char* q{ ParseFloat(p + 1, lineEnd, position.x) };
+				q = q ? ParseFloat(q, lineEnd, position.y) : nullptr;
+				q = q ? ParseFloat(q, lineEnd, position.z) : nullptr;
+				chunk.ok = q != nullptr;
+				chunk.positions.push_back(position);
+			}
+			else if (keyword("vt", 2))
+			{
+				// v is optional
+				glm::vec2 uv{ 0 };
+				const char* q{ ParseFloat(p + 2, lineEnd, uv.x) };
+				if (q && !ParseFloat(q, lineEnd, uv.y))
+					uv.y = 0;
+				chunk.ok = q != nullptr;
+				chunk.uvs.push_back(uv);
+			}
+			else if (keyword("vn", 2))
+			{
+				glm::vec3 normal;
+				const char* q{ ParseFloat(p + 2, lineEnd, normal.x) };
+				q = q ? ParseFloat(q, lineEnd, normal.y) : nullptr;
+				q = q ? ParseFloat(q, lineEnd, normal.z) : nullptr;
+				chunk.ok = q != nullptr;
+				chunk.normals.push_back(normal);
+			}
+			else if (keyword("f", 1))
+				chunk.ok = ParseFace(p + 1, lineEnd, chunk, polygon);
+			else if (keyword("o", 1) || keyword("g", 1))
+				chunk.statements.push_back(ObjStatement{ chunk.corners.size(), false, RestOfLine(p + 1, lineEnd) });
+			else if (keyword("usemtl", 6))
+				chunk.statements.push_back(ObjStatement{ chunk.corners.size(), true, RestOfLine(p + 6, lineEnd) });
+			else if (keyword("mtllib", 6))
+				chunk.materialLibraries.push_back(RestOfLine(p + 6, lineEnd));
+
+			line = lineEnd + 1;
+		}
+	}
+
+	// Reads the materials of an MTL file into materials, with their names in names. Assimp's OBJ defaults are
+	// used for anything the file doesn't set
+	static bool ParseMtlFile(const std::string& filename, std::vector<Material>& materials, std::vector<std::string>& names)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cout << "Could not open material library: " << filename << std::endl;
+			return false;
+		}
+
+		// Lines before the first newmtl have nothing to apply to
+		const size_t firstMaterial{ materials.size() };
+		std::string text;
+		while (std::getline(file, text))
+		{
+			const char* line{ text.c_str() };
+			const char* end{ line + text.size() };
+			const char* p{ SkipSpaces(line, end) };
+			const char* q{ p };
+			while (q < end && *q != ' ' && *q != '\t')
+				q++;
+			const std::string keyword(p, q);
+
+			if (keyword == "newmtl")
+			{
+				Material material;
+				material.diffuseColour = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+				material.ambientColour = glm::vec4(0, 0, 0, 1);
+				material.specularColour = glm::vec4(0, 0, 0, 1);
+				material.emissiveColour = glm::vec4(0, 0, 0, 1);
+				material.specularFactor = 0;
+				materials.push_back(material);
+				names.push_back(RestOfLine(q, end));
+				continue;
+			}
+
+			if (materials.size() == firstMaterial)
+				continue;
+
+			Material& material{ materials.back() };
+			glm::vec4* colour{ nullptr };
+			if (keyword == "Kd")
+				colour = &material.diffuseColour;
+			else if (keyword == "Ka")
+				colour = &material.ambientColour;
+			else if (keyword == "Ks")
+				colour = &material.specularColour;
+			else if (keyword == "Ke")
+				colour = &material.emissiveColour;
+
+			if (colour)
+			{
+				glm::vec3 value;
+				const char* r{ ParseFloat(q, end, value.r) };
+				r = r ? ParseFloat(r, end, value.g) : nullptr;
+				r = r ? ParseFloat(r, end, value.b) : nullptr;
+				if (r)
+					*colour = glm::vec4(value, 1.0f);
+			}
+			else if (keyword == "Ns")
+			{
+				// Read back from assimp as an unsigned int so the fraction is lost there too
+				float shininess{ 0 };
+				if (ParseFloat(q, end, shininess))
+					material.specularFactor = (float)(unsigned int)std::max(shininess, 0.0f);
+			}
+			else if (keyword == "map_Kd" || keyword == "map_Ks")
+			{
+				// Options such as -bm 0.5 come before the filename
+				std::string filename{ RestOfLine(q, end) };
+				if (!filename.empty() && filename[0] == '-')
+					filename = filename.substr(std::min(filename.find_last_of(" \t") + 1, filename.size()));
+
+				if (keyword == "map_Kd")
+					material.diffuseTextureFilename = filename;
+				else
+					material.specularTextureFilename = filename;
+			}
+		}
+
+		return true;
+	}
+
+	// Hashes a vector by the bits of its components, with -0 made +0 first so equal values match
+	struct ObjValueHash
+	{
+		template<typename Vector>
+		size_t operator()(const Vector& value) const
+		{
+			size_t hash{ 0 };
+			for (int i = 0; i < Vector::length(); i++)
+			{
+				const float component{ value[i] + 0.0f };
+				UINT32 bits;
+				memcpy(&bits, &component, sizeof(bits));
+				hash = hash * 0x9E3779B1u ^ bits;
+			}
+			return hash;
+		}
+	};
+
+	// Index of the first entry in values equal to each one. Files often repeat v, vt or vn lines, pointing
+	// corners at the first copy makes deduplicating them by index the same as by value as assimp does
+	template<typename Vector>
+	static std::vector<INT32> FirstEqualValues(const std::vector<Vector>& values)
+	{
+		std::unordered_map<Vector, INT32, ObjValueHash> firstIndex;
+		firstIndex.reserve(values.size());
+		std::vector<INT32> first(values.size());
+		for (size_t i = 0; i < values.size(); i++)
+			first[i] = firstIndex.emplace(values[i], (INT32)i).first->second;
+		return first;
+	}
+
+	// Builds one mesh from its runs of triangles. Corners are deduplicated by their three indices with an open
+	// addressing hash table and normals are generated, smoothed across each position, if any corner lacks one
+	static void BuildObjMesh(const std::vector<ObjChunk>& chunks, const std::vector<ObjRun>& runs, const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec2>& uvs, const std::vector<glm::vec3>& normals, Mesh& mesh)
+	{
+		size_t cornerCount{ 0 };
+		bool hasUVs{ false };
+		bool hasNormals{ true };
+		for (const ObjRun& run : runs)
+		{
+			cornerCount += run.endCorner - run.firstCorner;
+			for (size_t c = run.firstCorner; c < run.endCorner; c++)
+			{
+				hasUVs = hasUVs || chunks[run.chunk].corners[c].uv >= 0;
+				hasNormals = hasNormals && chunks[run.chunk].corners[c].normal >= 0;
+			}
+		}
+
+		size_t tableSize{ 16 };
+		while (tableSize < cornerCount * 2)
+			tableSize *= 2;
+		std::vector<UINT32> table(tableSize, 0);
+		std::vector<ObjCorner> vertexCorners;
+		vertexCorners.reserve(cornerCount / 2);
+		mesh.elements.reserve(cornerCount);
+
+		for (const ObjRun& run : runs)
+		{
+			const ObjCorner* corners{ chunks[run.chunk].corners.data() };
+			for (size_t c = run.firstCorner; c < run.endCorner; c += 3)
+			{
+				// Triangles with two corners in the same place are dropped as assimp's FindDegenerates does
+				const glm::vec3& a{ positions[corners[c].position] };
+				const glm::vec3& b{ positions[corners[c + 1].position] };
+				const glm::vec3& d{ positions[corners[c + 2].position] };
+				if (a == b || b == d || a == d)
+					continue;
+
+				for (size_t i = c; i < c + 3; i++)
+				{
+					ObjCorner key{ corners[i] };
+					key.normal = hasNormals ? key.normal : -1;
+					key.relative = 0;
+
+					size_t slot{ ((size_t)(UINT32)key.position * 0x9E3779B1u ^ (size_t)(UINT32)key.uv * 0x85EBCA77u ^ (size_t)(UINT32)key.normal * 0xC2B2AE3Du) & (tableSize - 1) };
+					while (table[slot] != 0 && !(vertexCorners[table[slot] - 1] == key))
+						slot = (slot + 1) & (tableSize - 1);
+
+					if (table[slot] == 0)
+					{
+						vertexCorners.push_back(key);
+						table[slot] = (UINT32)vertexCorners.size();
+					}
+					mesh.elements.push_back(table[slot] - 1);
+				}
+			}
+		}
+
+		const size_t vertexCount{ vertexCorners.size() };
+		mesh.vertices.resize(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			mesh.vertices[v] = positions[vertexCorners[v].position];
+
+		if (hasUVs)
+		{
+			mesh.uvCoords.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; v++)
+				mesh.uvCoords[v] = vertexCorners[v].uv >= 0 ? uvs[vertexCorners[v].uv] : glm::vec2(0);
+		}
+
+		mesh.normals.resize(vertexCount);
+		if (hasNormals)
+		{
+			for (size_t v = 0; v < vertexCount; v++)
+				mesh.normals[v] = normals[vertexCorners[v].normal];
+			return;
+		}
+
+		// Sum of the unit face normals touching each position, like assimp's GenSmoothNormals. Equal positions
+		// share an index by now so this joins them by value as it does
+		std::unordered_map<INT32, glm::vec3> smoothNormals;
+		smoothNormals.reserve(vertexCount);
+		for (size_t e = 0; e < mesh.elements.size(); e += 3)
+		{
+			const glm::vec3& a{ mesh.vertices[mesh.elements[e]] };
+			const glm::vec3 faceNormal{ glm::cross(mesh.vertices[mesh.elements[e + 1]] - a, mesh.vertices[mesh.elements[e + 2]] - a) };
+			const float length{ glm::length(faceNormal) };
+			if (length <= 0)
+				continue;
+
+			for (size_t i = e; i < e + 3; i++)
+				smoothNormals[vertexCorners[mesh.elements[i]].position] += faceNormal / length;
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const glm::vec3 sum{ smoothNormals[vertexCorners[v].position] };
+			const float length{ glm::length(sum) };
+			mesh.normals[v] = length > 0 ? sum / length : glm::vec3(0);
+		}
+	}
+
+	// Reads a Wavefront OBJ and its material libraries without assimp
+	bool ModelLoader::PopulateFromObjFile(const std::string& filename)
+	{
+		MappedFile file;
+		if (!file.Open(filename))
+			return false;
+
+		const char* data{ (const char*)file.Data() };
+		const size_t size{ file.Size() };
+
+		// Chunk boundaries are moved on to the start of the next line
+		const auto lineStart = [&](size_t offset)
+		{
+			if (offset == 0 || offset >= size)
+				return data + std::min(offset, size);
+			const char* newline{ (const char*)memchr(data + offset - 1, '\n', size - offset + 1) };
+			return newline ? newline + 1 : data + size;
+		};
+
+		const size_t numChunks{ std::max<size_t>(std::min(WorkerThreadCount(), size / kObjMinChunkBytes), 1) };
+		std::vector<ObjChunk> chunks(numChunks);
+		for (size_t c = 0; c < numChunks; c++)
+		{
+			chunks[c].begin = lineStart(size * c / numChunks);
+			chunks[c].end = lineStart(size * (c + 1) / numChunks);
+		}
+
+		ParallelFor(numChunks, 1, [&](size_t first, size_t last)
+		{
+			for (size_t c = first; c < last; c++)
+				ParseObjChunk(chunks[c]);
+		});
+
+		// Join the streams, each chunk's indices are relative to where its own streams start
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> uvs;
+		std::vector<glm::vec3> normals;
+		std::vector<size_t> positionBase(numChunks), uvBase(numChunks), normalBase(numChunks);
+		for (size_t c = 0; c < numChunks; c++)
+		{
+			if (!chunks[c].ok)
+			{
+				std::cout << "Could not parse " << filename << std::endl;
+				return false;
+			}
+
+			positionBase[c] = positions.size();
+			uvBase[c] = uvs.size();
+			normalBase[c] = normals.size();
+			positions.insert(positions.end(), chunks[c].positions.begin(), chunks[c].positions.end());
+			uvs.insert(uvs.end(), chunks[c].uvs.begin(), chunks[c].uvs.end());
+			normals.insert(normals.end(), chunks[c].normals.begin(), chunks[c].normals.end());
+		}
+
+		// Chunks are checked on several threads at once
+		std::atomic<bool> indicesOk{ true };
+		ParallelFor(numChunks, 1, [&](size_t first, size_t last)
+		{
+			for (size_t c = first; c < last; c++)
+			{
+				for (ObjCorner& corner : chunks[c].corners)
+				{
+					corner.position += (corner.relative & 1) ? (INT32)positionBase[c] : 0;
+					corner.uv += (corner.relative & 2) ? (INT32)uvBase[c] : 0;
+					corner.normal += (corner.relative & 4) ? (INT32)normalBase[c] : 0;
+
+					if (corner.position < 0 || (size_t)corner.position >= positions.size() ||
+						((corner.relative & 2) ? corner.uv < 0 : corner.uv < -1) || corner.uv >= (INT32)uvs.size() ||
+						((corner.relative & 4) ? corner.normal < 0 : corner.normal < -1) || corner.normal >= (INT32)normals.size())
+						indicesOk.store(false, std::memory_order_relaxed);
+				}
+			}
+		});
+
+		if (!indicesOk.load())
+		{
+			std::cout << "Face index out of range in " << filename << std::endl;
+			return false;
+		}
+
+		const std::vector<INT32> firstPosition{ FirstEqualValues(positions) };
+		const std::vector<INT32> firstUV{ FirstEqualValues(uvs) };
+		const std::vector<INT32> firstNormal{ FirstEqualValues(normals) };
+		ParallelFor(numChunks, 1, [&](size_t first, size_t last)
+		{
+			for (size_t c = first; c < last; c++)
+			{
+				for (ObjCorner& corner : chunks[c].corners)
+				{
+					corner.position = firstPosition[corner.position];
+					corner.uv = corner.uv >= 0 ? firstUV[corner.uv] : -1;
+					corner.normal = corner.normal >= 0 ? firstNormal[corner.normal] : -1;
+				}
+			}
+		});
+
+		// Materials, the first is assimp's default for faces before any usemtl or naming an unknown material
+		std::vector<Material> materials(1);
+		std::vector<std::string> materialNames{ "DefaultMaterial" };
+		materials[0].diffuseColour = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+		materials[0].ambientColour = glm::vec4(0, 0, 0, 1);
+		materials[0].specularColour = glm::vec4(0, 0, 0, 1);
+		materials[0].emissiveColour = glm::vec4(0, 0, 0, 1);
+		materials[0].specularFactor = 0;
+
+		const std::string folder{ filename.substr(0, filename.find_last_of("\\/") + 1) };
+		for (const ObjChunk& chunk : chunks)
+		{
+			for (const std::string& library : chunk.materialLibraries)
+				ParseMtlFile(folder + library, materials, materialNames);
+		}
+
+		// Each o or g starts an object which gets a node, with one mesh for each material its faces use
+		struct ObjObject
+		{
+			std::string name;
+			std::vector<std::pair<size_t, size_t>> materialMeshes;
+		};
+		std::vector<ObjObject> objects;
+		std::vector<std::vector<ObjRun>> meshRuns;
+		std::vector<size_t> meshMaterials;
+		std::vector<size_t> meshObjects;
+
+		size_t objectIndex{ 0 };
+		size_t materialIndex{ 0 };
+		objects.push_back(ObjObject{ "defaultobject", {} });
+
+		const auto addRun = [&](size_t chunk, size_t firstCorner, size_t endCorner)
+		{
+			if (firstCorner == endCorner)
+				return;
+
+			ObjObject& object{ objects[objectIndex] };
+			auto found{ std::find_if(object.materialMeshes.begin(), object.materialMeshes.end(),
+				[&](const std::pair<size_t, size_t>& entry) { return entry.first == materialIndex; }) };
+			if (found == object.materialMeshes.end())
+			{
+				object.materialMeshes.emplace_back(materialIndex, meshRuns.size());
+				found = object.materialMeshes.end() - 1;
+				meshRuns.emplace_back();
+				meshMaterials.push_back(materialIndex);
+				meshObjects.push_back(objectIndex);
+			}
+			meshRuns[found->second].push_back(ObjRun{ chunk, firstCorner, endCorner });
+		};
+
+		for (size_t c = 0; c < numChunks; c++)
+		{
+			size_t corner{ 0 };
+			for (const ObjStatement& statement : chunks[c].statements)
+			{
+				addRun(c, corner, statement.firstCorner);
+				corner = statement.firstCorner;
+
+				if (statement.material)
+				{
+					const auto found{ std::find(materialNames.begin(), materialNames.end(), statement.name) };
+					materialIndex = found == materialNames.end() ? 0 : (size_t)(found - materialNames.begin());
+				}
+				else
+				{
+					objectIndex = objects.size();
+					objects.push_back(ObjObject{ statement.name, {} });
+				}
+			}
+			addRun(c, corner, chunks[c].corners.size());
+		}
+
+		if (meshRuns.empty())
+		{
+			std::cout << "No faces in " << filename << std::endl;
+			return false;
+		}
+
+		std::vector<Mesh> meshes(meshRuns.size());
+		ParallelFor(meshes.size(), 1, [&](size_t first, size_t last)
+		{
+			for (size_t m = first; m < last; m++)
+			{
+				BuildObjMesh(chunks, meshRuns[m], positions, uvs, normals, meshes[m]);
+				meshes[m].name = objects[meshObjects[m]].name;
+			}
+		});
+
+		// Only materials in use are kept and identical ones merged, as RemoveRedundantMaterials does
+		std::vector<Material> usedMaterials;
+		std::vector<size_t> materialRemap(materials.size(), SIZE_MAX);
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			size_t& remapped{ materialRemap[meshMaterials[m]] };
+			if (remapped == SIZE_MAX)
+			{
+				const Material& material{ materials[meshMaterials[m]] };
+				for (size_t u = 0; u < usedMaterials.size() && remapped == SIZE_MAX; u++)
+				{
+					const Material& used{ usedMaterials[u] };
+					if (used.diffuseTextureFilename == material.diffuseTextureFilename && used.specularTextureFilename == material.specularTextureFilename &&
+						used.diffuseColour == material.diffuseColour && used.ambientColour == material.ambientColour &&
+						used.emissiveColour == material.emissiveColour && used.specularColour == material.specularColour &&
+						used.specularFactor == material.specularFactor)
+						remapped = u;
+				}
+
+				if (remapped == SIZE_MAX)
+				{
+					remapped = usedMaterials.size();
+					usedMaterials.push_back(material);
+				}
+			}
+			meshes[m].materialIndex = remapped;
+		}
+
+		// A root named after the file with a child for each object that has faces
+		m_nodes.Clear();
+		Node root;
+		root.name = filename.substr(filename.find_last_of("\\/") + 1);
+		const int rootIndex{ (int)m_nodes.Add(std::move(root), NodeHierarchy::kNoNode, glm::mat4(1)) };
+		for (const ObjObject& object : objects)
+		{
+			if (object.materialMeshes.empty())
+				continue;
+
+			Node node;
+			node.name = object.name;
+			for (const auto& entry : object.materialMeshes)
+				node.meshIndices.push_back((unsigned int)entry.second);
+			m_nodes.Add(std::move(node), rootIndex, glm::mat4(1));
+		}
+
+		m_meshVector = std::move(meshes);
+		m_materials = std::move(usedMaterials);
+		m_animations.clear();
+
+		std::cout << "Loaded OK" << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+// Small helpers for splitting CPU work across threads
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Helpers
+{
+	// Number of worker threads to use for data parallel work, always at least 1
+	inline size_t WorkerThreadCount()
+	{
+		const unsigned int hw{ std::thread::hardware_concurrency() };
+		return hw == 0 ? 1 : (size_t)hw;
+	}
+
+	// Whether ParallelFor runs in place on this thread. Set on threads that already share the CPU with others,
+	// such as ThreadPool workers, so jobs running side by side don't each start a thread per core
+	inline bool& ParallelForRunsSerially()
+	{
+		thread_local bool serial{ false };
+		return serial;
+	}
+
+	// Splits [0, count) into contiguous chunks of at least minChunk items and calls func(begin, end) for each chunk.
+	// The chunks run on their own threads with the last chunk on the calling thread, or all in turn on the calling
+	// thread where ParallelForRunsSerially is set. Blocks until all are done.
+	template<typename Func>
+	void ParallelFor(size_t count, size_t minChunk, Func&& func)
+	{
+		if (count == 0)
+			return;
+
+		minChunk = std::max<size_t>(minChunk, 1);
+		const size_t numChunks{ std::min(WorkerThreadCount(), (count + minChunk - 1) / minChunk) };
+		if (numChunks <= 1 || ParallelForRunsSerially())
+		{
+			func((size_t)0, count);
+			return;
+		}
+
+		const size_t chunkSize{ (count + numChunks - 1) / numChunks };
+
+		std::vector<std::thread> threads;
+		threads.reserve(numChunks - 1);
+
+		size_t begin{ 0 };
+		for (size_t i = 0; i < numChunks - 1 && begin < count; i++, begin += chunkSize)
+		{
+			const size_t end{ std::min(begin + chunkSize, count) };
+			threads.emplace_back([&func, begin, end]() { func(begin, end); });
+		}
+
+		if (begin < count)
+			func(begin, count);
+
+		for (std::thread& t : threads)
+			t.join();
+	}
+}
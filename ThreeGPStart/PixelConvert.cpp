@@ -0,0 +1,157 @@
+#include "PixelConvert.h"
+#include "Simd.h"
+
+namespace Helpers
+{
+	// Widens 16 grey bytes to 16 RGBA texels with alpha 255
+	static inline void StoreGreyAsRGBA(__m128i grey, BYTE* destination)
+	{
+		const __m128i alpha{ _mm_set1_epi8((char)0xFF) };
+		const __m128i lo{ _mm_unpacklo_epi8(grey, grey) };
+		const __m128i hi{ _mm_unpackhi_epi8(grey, grey) };
+		const __m128i loAlpha{ _mm_unpacklo_epi8(grey, alpha) };
+		const __m128i hiAlpha{ _mm_unpackhi_epi8(grey, alpha) };
+
+		__m128i* out{ (__m128i*)destination };
+		_mm_storeu_si128(out, _mm_unpacklo_epi16(lo, loAlpha));
+		_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, loAlpha));
+		_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, hiAlpha));
+		_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, hiAlpha));
+	}
+
+	// 8 bit grey to RGBA, grey copied to red, green and blue with alpha 255
+	void GreyToRGBA(const BYTE* source, BYTE* destination, size_t count)
+	{
+		size_t i{ 0 };
+		for (; i + 16 <= count; i += 16)
+			StoreGreyAsRGBA(_mm_loadu_si128((const __m128i*)(source + i)), destination + i * 4);
+
+		for (; i < count; i++)
+		{
+			destination[i * 4] = destination[i * 4 + 1] = destination[i * 4 + 2] = source[i];
+			destination[i * 4 + 3] = 255;
+		}
+	}
+
+	// 16 bit grey to RGBA keeping the top 8 bits, alpha 255
+	void Grey16ToRGBA(const UINT16* source, BYTE* destination, size_t count)
+	{
+		size_t i{ 0 };
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i a{ _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(source + i)), 8) };
+			const __m128i b{ _mm_srli_epi16(_mm_loadu_si128((const __m128i*)(source + i + 8)), 8) };
+			StoreGreyAsRGBA(_mm_packus_epi16(a, b), destination + i * 4);
+		}
+
+		for (; i < count; i++)
+		{
+			destination[i * 4] = destination[i * 4 + 1] = destination[i * 4 + 2] = (BYTE)(source[i] >> 8);
+			destination[i * 4 + 3] = 255;
+		}
+	}
+
+	// 24 bit RGB to RGBA with alpha 255
+	void RGBToRGBA(const BYTE* source, BYTE* destination, size_t count)
+	{
+		const __m128i alpha{ _mm_set1_epi32((int)0xFF000000) };
+
+		// Each step uses 4 texels (12 bytes) of a 16 byte load, so stop while 16 bytes can still be read
+		size_t i{ 0 };
+		for (; i + 6 <= count; i += 4)
+		{
+			const __m128i v{ _mm_loadu_si128((const __m128i*)(source + i * 3)) };
+
+			// Lane n of each shifted copy starts at texel n, interleave the first lanes together
+			const __m128i t01{ _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3)) };
+			const __m128i t23{ _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9)) };
+			const __m128i rgbx{ _mm_unpacklo_epi64(t01, t23) };
+
+			_mm_storeu_si128((__m128i*)(destination + i * 4), _mm_or_si128(rgbx, alpha));
+		}
+
+		for (; i < count; i++)
+		{
+			destination[i * 4] = source[i * 3];
+			destination[i * 4 + 1] = source[i * 3 + 1];
+			destination[i * 4 + 2] = source[i * 3 + 2];
+			destination[i * 4 + 3] = 255;
+		}
+	}
+
+	// Swaps red and blue of 32 bit texels. source may equal destination
+	void SwapRedBlue(const BYTE* source, BYTE* destination, size_t count)
+	{
+		const __m128i greenAlphaMask{ _mm_set1_epi32((int)0xFF00FF00) };
+		const __m128i redBlueMask{ _mm_set1_epi32(0x00FF00FF) };
+
+		size_t i{ 0 };
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i v{ _mm_loadu_si128((const __m128i*)(source + i * 4)) };
+
+			// Red and blue sit in the low byte of the two 16 bit halves of each texel, so swap the halves
+			__m128i redBlue{ _mm_and_si128(v, redBlueMask) };
+			redBlue = _mm_shufflelo_epi16(redBlue, _MM_SHUFFLE(2, 3, 0, 1));
+			redBlue = _mm_shufflehi_epi16(redBlue, _MM_SHUFFLE(2, 3, 0, 1));
+
+			_mm_storeu_si128((__m128i*)(destination + i * 4), _mm_or_si128(redBlue, _mm_and_si128(v, greenAlphaMask)));
+		}
+
+		for (; i < count; i++)
+		{
+			const BYTE red{ source[i * 4] };
+			destination[i * 4] = source[i * 4 + 2];
+			destination[i * 4 + 1] = source[i * 4 + 1];
+			destination[i * 4 + 2] = red;
+			destination[i * 4 + 3] = source[i * 4 + 3];
+		}
+	}
+
+	// Copies one channel (0 red to 3 alpha) of RGBA texels out to a single channel
+	void ExtractChannel(const BYTE* rgba, BYTE* destination, size_t count, int channel)
+	{
+		const __m128i shift{ _mm_cvtsi32_si128(channel * 8) };
+		const __m128i mask{ _mm_set1_epi32(0xFF) };
+
+		size_t i{ 0 };
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i* in{ (const __m128i*)(rgba + i * 4) };
+			const __m128i a{ _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(in), shift), mask) };
+			const __m128i b{ _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(in + 1), shift), mask) };
+			const __m128i c{ _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(in + 2), shift), mask) };
+			const __m128i d{ _mm_and_si128(_mm_srl_epi32(_mm_loadu_si128(in + 3), shift), mask) };
+
+			// Values are 0-255 so the signed 32 to 16 bit pack cannot saturate
+			_mm_storeu_si128((__m128i*)(destination + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		}
+
+		for (; i < count; i++)
+			destination[i] = rgba[i * 4 + channel];
+	}
+
+	// Halves an RGBA image with a 2x2 box filter. Rows run in parallel
+	void DownsampleRGBA(const BYTE* source, int width, int height, BYTE* destination, int destWidth, int destHeight)
+	{
+		const size_t sourceRow{ (size_t)width * 4 };
+		const int stepX{ width > 1 ? 4 : 0 };
+		const size_t stepY{ height > 1 ? sourceRow : 0 };
+
+		ConvertImageRows(destHeight, [=](int y)
+		{
+			const BYTE* row0{ source + (size_t)(height > 1 ? y * 2 : 0) * sourceRow };
+			const BYTE* row1{ row0 + stepY };
+			BYTE* out{ destination + (size_t)y * destWidth * 4 };
+			for (int x = 0; x < destWidth; x++)
+			{
+				const size_t sx{ (size_t)(width > 1 ? x * 2 : 0) * 4 };
+				for (int c = 0; c < 4; c++)
+				{
+					const int sum{ row0[sx + c] + row0[sx + stepX + c] + row1[sx + c] + row1[sx + stepX + c] };
+					out[x * 4 + c] = (BYTE)((sum + 2) / 4);
+				}
+			}
+		});
+	}
+}
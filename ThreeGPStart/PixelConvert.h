@@ -0,0 +1,43 @@
+#pragma once
+// SSE2 kernels for converting spans of texels between the layouts ImageLoader deals with.
+// All work on count texels and handle any count, with no alignment requirements.
+// Callers split images by rows with ParallelFor (see ConvertImageRows) to use every core.
+
+#include "ExternalLibraryHeaders.h"
+#include "Parallel.h"
+
+namespace Helpers
+{
+	// 8 bit grey to RGBA, grey copied to red, green and blue with alpha 255
+	void GreyToRGBA(const BYTE* source, BYTE* destination, size_t count);
+
+	// 16 bit grey to RGBA keeping the top 8 bits, alpha 255
+	void Grey16ToRGBA(const UINT16* source, BYTE* destination, size_t count);
+
+	// 24 bit RGB to RGBA with alpha 255
+	void RGBToRGBA(const BYTE* source, BYTE* destination, size_t count);
+
+	// Swaps red and blue of 32 bit texels, converting BGRA to RGBA or back. source may equal destination
+	void SwapRedBlue(const BYTE* source, BYTE* destination, size_t count);
+
+	// Copies one channel (0 red to 3 alpha) of RGBA texels out to a single channel
+	void ExtractChannel(const BYTE* rgba, BYTE* destination, size_t count, int channel);
+
+	// Halves an RGBA image with a 2x2 box filter, the same filter glGenerateMipmap typically uses.
+	// Odd sized sources drop their last row / column, a source of size 1 is reused on that axis. Rows run in parallel
+	void DownsampleRGBA(const BYTE* source, int width, int height, BYTE* destination, int destWidth, int destHeight);
+
+	// Rows handed to each thread at minimum, below this threads cost more than they save
+	constexpr size_t kMinConvertRowsPerThread{ 64 };
+
+	// Calls convertRow(y) for every row of an image, spread over the worker threads
+	template<typename ConvertRow>
+	void ConvertImageRows(int height, ConvertRow&& convertRow)
+	{
+		ParallelFor((size_t)std::max(height, 0), kMinConvertRowsPerThread, [&convertRow](size_t begin, size_t end)
+		{
+			for (size_t y = begin; y < end; y++)
+				convertRow((int)y);
+		});
+	}
+}
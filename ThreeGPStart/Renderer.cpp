@@ -1,6 +1,11 @@
 #include "Renderer.h"
 #include "Camera.h"
 #include "ImageLoader.h"
+#include "MeshSimplifier.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+#include <filesystem>
+namespace fs = std::filesystem;
 
 GLuint j_VAO;
 
@@ -16,6 +21,17 @@ Renderer::~Renderer()
 	// TODO: clean up any memory used including OpenGL objects via glDelete* calls
 	glDeleteProgram(terrainProgram);
 	glDeleteBuffers(1, &j_VAO);
+
+	// A worker may still be writing into the mapped pending terrain buffers so let it finish first
+	if (m_terrainBuild.valid())
+		m_terrainBuild.wait();
+	if (m_terrainCopy.valid())
+		m_terrainCopy.wait();
+	if (m_pendingTerrainFence)
+		glDeleteSync(m_pendingTerrainFence);
+
+	DeleteTerrainBuffers(m_pendingTerrain);
+	DeleteTerrainBuffers(m_terrain);
 }
 
 // Use IMGUI for a simple on screen GUI
@@ -30,6 +46,70 @@ void Renderer::DefineGUI()
 
 	ImGui::Checkbox("Wireframe", &m_wireframe);	// A checkbox linked to a member variable
 
+	ImGui::Text("Terrain.");
+
+	// Picking a heightmap starts a rebuild in the background, the old terrain renders until it is done
+	const std::string currentHeightmap{ m_heightmapFiles.empty() ? "" : fs::path(m_heightmapFiles[m_heightmapIndex]).filename().string() };
+	if (ImGui::BeginCombo("Heightmap", currentHeightmap.c_str()))
+	{
+		for (int i = 0; i < (int)m_heightmapFiles.size(); i++)
+		{
+			const bool selected{ i == m_heightmapIndex };
+			if (ImGui::Selectable(fs::path(m_heightmapFiles[i]).filename().string().c_str(), selected) && !selected)
+				RequestTerrain(i);
+			if (selected)
+				ImGui::SetItemDefaultFocus();
+		}
+		ImGui::EndCombo();
+	}
+
+	ImGui::SliderFloat("Height smoothing", &m_terrainSettings.heightFilter.gaussianSigma, 0.0f, 4.0f);
+	if (ImGui::IsItemDeactivatedAfterEdit())
+		RequestTerrain(m_heightmapIndex);
+
+	if (m_terrainSwitchState != TerrainSwitchState::Idle)
+		ImGui::Text("Building terrain...");
+
+	if (m_terrainAlbedo.IsOpen())
+	{
+		ImGui::Checkbox("Virtual texture", &m_virtualTexturing);
+		ImGui::Text("Albedo %d x %d, %d / %d pages resident, %d loading", m_terrainAlbedo.Width(), m_terrainAlbedo.Height(),
+			m_terrainAlbedo.ResidentPages(), m_terrainAlbedo.CachePages(), m_terrainAlbedo.PendingPages());
+	}
+	else if (m_terrainAlbedoBake.valid())
+		ImGui::Text("Baking terrain albedo pages...");
+
+	ImGui::Text("Textures.");
+
+	if (ImGui::SliderInt("Texture budget (MB)", &m_textureBudgetMB, 16, 2048))
+		m_textures.SetBudget((size_t)m_textureBudgetMB * 1024 * 1024);
+	ImGui::Text("Texture memory %.1f MB, jeep texture mip %d", m_textures.ResidentBytes() / (1024.0f * 1024.0f), m_jeepTexture ? m_jeepTexture->ResidentBaseLevel() : 0);
+
+	ImGui::Text("Level of detail.");
+
+	ImGui::SliderFloat("LOD pixel error", &m_lodPixelError, 0.1f, 16.0f);
+	if (!m_jeepLods.empty())
+		ImGui::Text("Jeep LOD %d of %d, %d triangles", (int)m_jeepLodDrawn, (int)m_jeepLods.size() - 1, (int)m_jeepLods[m_jeepLodDrawn].numElements / 3);
+
+	ImGui::Checkbox("Meshlet culling", &m_meshletCulling);
+	if (m_meshletCulling && m_jeepLodDrawn == 0)
+		ImGui::Text("Jeep meshlets drawn %d of %d", (int)m_jeepMeshletsDrawn, (int)m_jeepMeshlets.size());
+
+	ImGui::Text("Capture.");
+
+	if (ImGui::Button("Screenshot"))
+		m_capture.RequestScreenshot("Screenshots\\screenshot_" + Helpers::CaptureTimestamp());
+	ImGui::SameLine();
+	if (!m_capture.IsRecording() && ImGui::Button("Record frames"))
+		m_capture.StartRecording("Captures\\" + Helpers::CaptureTimestamp());
+	else if (m_capture.IsRecording() && ImGui::Button("Stop recording"))
+		m_capture.StopRecording();
+
+	if (m_capture.IsRecording() || m_capture.RecordedFrames() > 0)
+		ImGui::Text("Recorded %d frames, dropped %d, %d waiting to be written", m_capture.RecordedFrames(), m_capture.DroppedFrames(), m_capture.QueuedFrames());
+	if (m_capture.FailedWrites() > 0)
+		ImGui::Text("%d frames could not be written", m_capture.FailedWrites());
+
 	ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		
 	ImGui::End();
@@ -68,14 +148,199 @@ GLuint Renderer::CreateProgram(std::string vertPath, std::string fragPath)
 	return program;
 }
 
-float Noise(int x, int y)
+// Copies terrain data into buffers mapped by CreateTerrainBuffers. Makes no OpenGL calls so is safe on any thread
+static void CopyTerrainGeometry(const Helpers::TerrainGeometry& terrain, void* const mapped[4])
 {
-	int n = x + y * 57;  // 57 is the seed  can be tweaked
-	n = (n >> 13) ^ n;
-	int nn = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
-	return 1.0f - ((float)nn / 1073741824.0f);
+	memcpy(mapped[0], terrain.vertices.data(), sizeof(glm::vec3) * terrain.vertices.size());
+	memcpy(mapped[1], terrain.uvCoords.data(), sizeof(glm::vec2) * terrain.uvCoords.size());
+	memcpy(mapped[2], terrain.normals.data(), sizeof(glm::vec3) * terrain.normals.size());
+	memcpy(mapped[3], terrain.elements.data(), sizeof(GLuint) * terrain.elements.size());
 }
 
+// Allocates buffers big enough for terrain and maps them for writing.
+// mapped receives the positions, uvs, normals and elements pointers in that order
+Renderer::TerrainBuffers Renderer::CreateTerrainBuffers(const Helpers::TerrainGeometry& terrain, void* mapped[4])
+{
+	TerrainBuffers buffers;
+	buffers.numElements = (GLuint)terrain.elements.size();
+
+	GLuint* ids[4]{ &buffers.positionsVBO, &buffers.uvVBO, &buffers.normalsVBO, &buffers.elementEBO };
+	const GLsizeiptr sizes[4]{
+		(GLsizeiptr)(sizeof(glm::vec3) * terrain.vertices.size()),
+		(GLsizeiptr)(sizeof(glm::vec2) * terrain.uvCoords.size()),
+		(GLsizeiptr)(sizeof(glm::vec3) * terrain.normals.size()),
+		(GLsizeiptr)(sizeof(GLuint) * terrain.elements.size()) };
+
+	for (int i = 0; i < 4; i++)
+	{
+		glCreateBuffers(1, ids[i]);
+		glNamedBufferStorage(*ids[i], sizes[i], nullptr, GL_MAP_WRITE_BIT);
+		mapped[i] = glMapNamedBufferRange(*ids[i], 0, sizes[i], GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	}
+
+	return buffers;
+}
+
+// Unmaps the buffers and builds the vertex array object. Returns false if the buffer contents were lost
+bool Renderer::FinishTerrainBuffers(TerrainBuffers& buffers)
+{
+	bool ok{ true };
+	for (GLuint id : { buffers.positionsVBO, buffers.uvVBO, buffers.normalsVBO, buffers.elementEBO })
+		ok = (glUnmapNamedBuffer(id) == GL_TRUE) && ok;
+
+	if (!ok)
+		return false;
+
+	glGenVertexArrays(1, &buffers.vao);
+	glBindVertexArray(buffers.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.positionsVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(
+		0,
+		3,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		(void*)0
+	);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.uvVBO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(
+		1,
+		2,
+		GL_FLOAT,
+		GL_FALSE,
+		0,
+		(void*)0
+	);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers.normalsVBO);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(
+		2,                                // attribute
+		3,                                // size
+		GL_FLOAT,                         // type
+		GL_FALSE,                         // normalized
+		0,                                // stride
+		(void*)0                          // array buffer offset
+	);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.elementEBO);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+void Renderer::DeleteTerrainBuffers(TerrainBuffers& buffers)
+{
+	glDeleteVertexArrays(1, &buffers.vao);
+	GLuint ids[4]{ buffers.positionsVBO, buffers.uvVBO, buffers.normalsVBO, buffers.elementEBO };
+	glDeleteBuffers(4, ids);
+	buffers = TerrainBuffers();
+}
+
+// Starts building terrain from the heightmap at heightmapIndex on a worker thread.
+// If a switch is already in progress the request is queued and started once it completes
+void Renderer::RequestTerrain(int heightmapIndex)
+{
+	if (heightmapIndex < 0 || heightmapIndex >= (int)m_heightmapFiles.size())
+		return;
+
+	m_heightmapIndex = heightmapIndex;
+
+	if (m_terrainSwitchState != TerrainSwitchState::Idle)
+	{
+		m_queuedHeightmapIndex = heightmapIndex;
+		return;
+	}
+
+	const std::string filename{ m_heightmapFiles[heightmapIndex] };
+	const Helpers::TerrainSettings settings{ m_terrainSettings };
+	m_terrainBuild = std::async(std::launch::async, [filename, settings]()
+	{
+		auto terrain{ std::make_unique<Helpers::TerrainGeometry>() };
+		Helpers::BuildTerrainGeometry(filename, settings, *terrain);
+		return terrain;
+	});
+
+	m_terrainSwitchState = TerrainSwitchState::Building;
+}
+
+// Moves any heightmap switch on to its next stage. Called once per frame and never waits on
+// a worker thread or the GPU, so the current terrain keeps rendering at full rate
+void Renderer::UpdateTerrainSwitch()
+{
+	const auto isReady = [](const auto& future) {
+		return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	};
+
+	switch (m_terrainSwitchState)
+	{
+	case TerrainSwitchState::Idle:
+		break;
+	case TerrainSwitchState::Building:
+	{
+		if (!isReady(m_terrainBuild))
+			break;
+
+		// Geometry is built, allocate and map the GPU buffers so a worker can copy straight into them
+		m_pendingGeometry = m_terrainBuild.get();
+
+		void* mapped[4];
+		m_pendingTerrain = CreateTerrainBuffers(*m_pendingGeometry, mapped);
+
+		const Helpers::TerrainGeometry* geometry{ m_pendingGeometry.get() };
+		m_terrainCopy = std::async(std::launch::async, [geometry, mapped]() { CopyTerrainGeometry(*geometry, mapped); });
+
+		m_terrainSwitchState = TerrainSwitchState::Copying;
+		break;
+	}
+	case TerrainSwitchState::Copying:
+		if (!isReady(m_terrainCopy))
+			break;
+
+		m_terrainCopy.get();
+		m_pendingGeometry.reset();
+
+		if (!FinishTerrainBuffers(m_pendingTerrain))
+		{
+			// Buffer contents can be lost e.g. on a display mode change, just try again
+			std::cout << "Terrain buffer contents lost during upload, rebuilding" << std::endl;
+			DeleteTerrainBuffers(m_pendingTerrain);
+			m_terrainSwitchState = TerrainSwitchState::Idle;
+			if (m_queuedHeightmapIndex < 0)
+				m_queuedHeightmapIndex = m_heightmapIndex;
+			break;
+		}
+
+		// Only swap once the GPU has actually consumed the data
+		m_pendingTerrainFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_terrainSwitchState = TerrainSwitchState::Uploading;
+		break;
+	case TerrainSwitchState::Uploading:
+	{
+		const GLenum result{ glClientWaitSync(m_pendingTerrainFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) };
+		if (result == GL_TIMEOUT_EXPIRED)
+			break;
+
+		glDeleteSync(m_pendingTerrainFence);
+		m_pendingTerrainFence = nullptr;
+
+		// OpenGL defers deleting the old buffers until any draws still using them are done
+		DeleteTerrainBuffers(m_terrain);
+		m_terrain = m_pendingTerrain;
+		m_pendingTerrain = TerrainBuffers();
+		m_terrainSwitchState = TerrainSwitchState::Idle;
+		break;
+	}
+	}
+
+	if (m_terrainSwitchState == TerrainSwitchState::Idle && m_queuedHeightmapIndex >= 0)
+	{
+		const int next{ m_queuedHeightmapIndex };
+		m_queuedHeightmapIndex = -1;
+		RequestTerrain(next);
+	}
+}
 
 // Load / create geometry into OpenGL buffers	
 bool Renderer::InitialiseGeometry()
@@ -86,6 +351,28 @@ bool Renderer::InitialiseGeometry()
 	terrainProgram = CreateProgram("Data/Shaders/vertex_shader.vert", "Data/Shaders/fragment_shader.frag");
 	jeepProgram = CreateProgram("Data/Shaders/jeep_vertex_shader.vert", "Data/Shaders/jeep_fragment_shader.frag");
 	skyboxProgram = CreateProgram("Data/Shaders/skybox_vertex_shader.vert", "Data/Shaders/skybox_fragment_shader.frag");
+	terrainFeedbackProgram = CreateProgram("Data/Shaders/vertex_shader.vert", "Data/Shaders/vt_feedback.frag");
+
+	// Models load on the loading pool while the shaders, textures and other geometry are set up below
+	const std::vector<std::string> modelFilenames{ "Data\\Models\\Jeep\\jeep.obj" };
+	std::vector<std::future<std::unique_ptr<Helpers::ModelLoader>>> models{ Helpers::LoadModelsAsync(modelFilenames, true) };
+
+	// Start decoding every texture now so they load in parallel with each other and with the geometry below.
+	// Only the checks that they loaded wait for them, after that the cache streams them in. Model textures start
+	// once their model's materials are loaded
+	m_terrainTexture = m_textures.Acquire("Data\\Textures\\dirt_earth-n-moss_df_.dds");
+
+	// Cube map order: +X, -X, +Y, -Y, +Z, -Z
+	const char* skyboxFaceFiles[6]{
+		"Data\\Models\\Sky\\Mars\\Mar_R.dds",
+		"Data\\Models\\Sky\\Mars\\Mar_L.dds",
+		"Data\\Models\\Sky\\Mars\\Mar_D.dds",
+		"Data\\Models\\Sky\\Mars\\Mar_U.dds",
+		"Data\\Models\\Sky\\Mars\\Mar_B.dds",
+		"Data\\Models\\Sky\\Mars\\Mar_F.dds" };
+	std::future<Helpers::ImageLoader> skyboxImages[6];
+	for (int i = 0; i < 6; i++)
+		skyboxImages[i] = Helpers::LoadImageAsync(skyboxFaceFiles[i]);
 
 	//Cube
 	glm::vec3 cubeMaxValues = { 10, 10, 10 };
@@ -258,35 +545,31 @@ bool Renderer::InitialiseGeometry()
 	glBindVertexArray(0);
 
 	//Jeep
-	Helpers::ModelLoader loader;
-	if (!loader.LoadFromFile("Data\\Models\\Jeep\\jeep.obj"))
-	return false;
-
-	Helpers::ImageLoader Jeep;
-	if (Jeep.Load("Data\\Models\\Jeep\\jeep_rood.jpg"))
-	{
-		glGenTextures(1, &tex);
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-			GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Jeep.Width(), Jeep.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, Jeep.GetData());
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-	}
-	else
-	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
+	const std::unique_ptr<Helpers::ModelLoader> jeep{ models[0].get() };
+	if (!jeep)
 		return false;
-	}
-
 
-	for (const Helpers::Mesh& mesh : loader.GetMeshVector())
+	for (const Helpers::Mesh& mesh : jeep->GetMeshVector())
 	{
 		j_numElements = mesh.elements.size();
 
+		// Model textures come from their materials. The one exception is the jeep, whose material asks for the
+		// army paint job while the red one is drawn instead
+		Helpers::Material material{ jeep->GetMaterialVector()[mesh.materialIndex] };
+		material.diffuseTextureFilename = "jeep_rood.jpg";
+		m_jeepTexture = m_textures.AcquireDiffuse(material, modelFilenames[0]);
+		if (!m_jeepTexture || !m_jeepTexture->FinishLoading())
+		{
+			MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
+			return false;
+		}
+
+		// Bounding sphere for working out how much texture detail the jeep needs on screen
+		glm::vec3 minExtents, maxExtents;
+		mesh.GetLocalExtents(minExtents, maxExtents);
+		m_jeepCentre = (minExtents + maxExtents) * 0.5f;
+		m_jeepRadius = std::max(glm::length(maxExtents - minExtents) * 0.5f, 1.0f);
+
 		GLuint jeepPositionsVBO;
 		glGenBuffers(1, &jeepPositionsVBO);
 		glBindBuffer(GL_ARRAY_BUFFER, jeepPositionsVBO);
@@ -298,10 +581,21 @@ bool Renderer::InitialiseGeometry()
 		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * mesh.uvCoords.size(), mesh.uvCoords.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+		m_jeepMeshlets = mesh.meshlets;
+
+		// Every level of detail shares the vertices, their elements follow the full mesh's in one buffer
+		m_jeepLods.clear();
+		m_jeepLods.push_back({ 0, j_numElements, 0.0f });
+		for (const Helpers::MeshLod& lod : mesh.lods)
+			m_jeepLods.push_back({ m_jeepLods.back().firstElement + m_jeepLods.back().numElements, (GLuint)lod.elements.size(), lod.error });
+
 		GLuint jeepElementEBO;
 		glGenBuffers(1, &jeepElementEBO);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, jeepElementEBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * mesh.elements.size(), mesh.elements.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * (m_jeepLods.back().firstElement + m_jeepLods.back().numElements), nullptr, GL_STATIC_DRAW);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLuint) * mesh.elements.size(), mesh.elements.data());
+		for (size_t i = 0; i < mesh.lods.size(); i++)
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * m_jeepLods[i + 1].firstElement, sizeof(GLuint) * mesh.lods[i].elements.size(), mesh.lods[i].elements.data());
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 		glGenVertexArrays(1, &j_VAO);
@@ -333,220 +627,60 @@ bool Renderer::InitialiseGeometry()
 
 	}
 
-	////Terrain + Height map + texture + noise
-	std::vector<glm::vec3> vertices;
-	std::vector<GLuint> elements;
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec3> colours;	
-	std::vector<glm::vec2> UVCoords;
-
-	float numCellX = 500;
-	float numCellZ = 500;
-
-	int numVertX = numCellX + 1;
-	int numVertZ = numCellZ + 1;
-	Helpers::ImageLoader HeightMap;
-	if (!HeightMap.Load("Data\\Heightmaps\\sf1.gif"))
+	//Terrain + Height map + texture
+	// Any image in the heightmaps folder can be switched to at runtime from the GUI
+	std::error_code dirError;
+	for (const auto& entry : fs::directory_iterator("Data\\Heightmaps", dirError))
 	{
-
-		for (int i = 0; i < numVertX; i++)
-		{
-			for (int j = 0; j < numVertZ; j++)
-			{
-				vertices.push_back(glm::vec3(i * 8, 0, j * 8));
-
-				UVCoords.push_back(glm::vec2(j / numCellZ, i / numCellX));
-
-				normals.push_back(glm::vec3(0, 0, 0));
-			}
-		}
+		if (entry.is_regular_file())
+			m_heightmapFiles.push_back(entry.path().string());
 	}
-	else
-	{
-		float vertexXtoImage = ((float)HeightMap.Width() -1) / numVertX;
-		float vertexZtoImage = ((float)HeightMap.Height() -1) / numVertZ;
-
-		BYTE* imageData = HeightMap.GetData();
-
-		 for (size_t x = 0; x < numVertX; x++)
-		{
-			 for (size_t z = 0; z < numVertZ; z++)
-			{
-				int imagex = vertexXtoImage * (numVertX - x);
-				int imagez = vertexZtoImage * z;
+	std::sort(m_heightmapFiles.begin(), m_heightmapFiles.end());
 
-				size_t offset = ((size_t)imagex + (size_t)imagez * HeightMap.Width()) * 4;
-				BYTE height = imageData[offset];
+	std::string heightmapFilename{ "Data\\Heightmaps\\sf1.gif" };
+	const auto defaultHeightmap = std::find(m_heightmapFiles.begin(), m_heightmapFiles.end(), heightmapFilename);
+	if (defaultHeightmap != m_heightmapFiles.end())
+		m_heightmapIndex = (int)(defaultHeightmap - m_heightmapFiles.begin());
 
-				vertices.push_back(glm::vec3(x * 8, (float)height, z * 8));
-				UVCoords.push_back(glm::vec2(x / numCellZ, z / numCellX));
-				normals.push_back(glm::vec3(0, 0, 0));
-
-
-			}
-		}
-	}
-
-	for (int cellZ = 0; cellZ < numCellZ; cellZ++)
-	{
-		for (int cellX = 0; cellX < numCellX; cellX++)
-		{
-			int startVertIndex = (cellZ * numVertX) + cellX;
-			if (Swap)
-			{
-				elements.push_back(startVertIndex);
-				elements.push_back(startVertIndex + 1);
-				elements.push_back(startVertIndex + numVertX);
-
-				elements.push_back(startVertIndex + 1);
-				elements.push_back(startVertIndex + numVertX + 1);
-				elements.push_back(startVertIndex + numVertX);
-			}
-			else
-			{
-				elements.push_back(startVertIndex);
-				elements.push_back(startVertIndex + numVertX + 1);
-				elements.push_back(startVertIndex + numVertX);
-
-				elements.push_back(startVertIndex + 1);
-				elements.push_back(startVertIndex + numVertX + 1);
-				elements.push_back(startVertIndex);
-			}
-			Swap = !Swap;
-		}
-		Swap = !Swap;
-	}
+	// The first terrain is built on this thread as there is nothing else to show yet
+	Helpers::TerrainGeometry terrainGeometry;
+	Helpers::BuildTerrainGeometry(heightmapFilename, m_terrainSettings, terrainGeometry);
 
-	if (NoiseGen)
+	void* mapped[4];
+	m_terrain = CreateTerrainBuffers(terrainGeometry, mapped);
+	CopyTerrainGeometry(terrainGeometry, mapped);
+	if (!FinishTerrainBuffers(m_terrain))
 	{
-		for (int i = 0; i < numVertX; i++)
-		{
-			for (int j = 0; j < numVertZ; j++)
-			{
-				NoiseVal = Noise(i, j);
-				NoiseVal = NoiseVal + 1.25 / 2;
-				glm::vec3 NoiseVec = vertices[Index];
-
-				if (!ExtraNoise)
-				{
-					NoiseVal = NoiseVal * 2;
-				}
-
-				NoiseVec.y = NoiseVec.y + NoiseVal;
-				vertices[Index] = NoiseVec;
-				Index++;
-
-			}
-		}
+		MessageBox(NULL, L"Terrain upload failed", L"Error", MB_OK | MB_ICONEXCLAMATION);
+		return false;
 	}
 
-	Helpers::ImageLoader Terrain;
-	if (Terrain.Load("Data\\Textures\\dirt_earth-n-moss_df_.dds"))
-	{
-		glGenTextures(1, &t_tex);
-		glBindTexture(GL_TEXTURE_2D, t_tex);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-			GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Terrain.Width(), Terrain.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, Terrain.GetData());
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-	}
-	else
+	if (!m_terrainTexture->FinishLoading())
 	{
 		MessageBox(NULL, L"Texture not found", L"Error", MB_OK | MB_ICONEXCLAMATION);
 		return false;
 	}
-	for (glm::vec3& n : normals)
-		n = glm::vec3(0, 0, 0);
 
-	for (size_t index = 0; index < elements.size(); index += 3)
+	// The albedo is cut into pages the first time, or after the source changes, on a worker thread.
+	// Until the map has its own albedo painted the grass image stands in for it
+	for (const char* albedo : { "Data\\Textures\\terrain_albedo.bmp", "Data\\Textures\\grass11.bmp" })
 	{
-		glm::vec3 v0{ vertices[elements[index]] };
-		glm::vec3 v1{ vertices[elements[index + 1]] };
-		glm::vec3 v2{ vertices[elements[index + 2]] };
-
-		glm::vec3 side1 = v1 - v0;
-		glm::vec3 side2 = v2 - v0;
-
-		glm::vec3 TriNorm = glm::normalize(glm::cross(side1, side2));
-
-		normals[elements[index]] += TriNorm;
-		normals[elements[index + 1]] += TriNorm;
-		normals[elements[index + 2]] += TriNorm;
+		std::error_code error;
+		if (fs::exists(fs::path(albedo), error) || fs::exists(fs::path(Helpers::VirtualTexturePath(albedo)), error))
+		{
+			m_terrainAlbedoSource = albedo;
+			break;
+		}
 	}
 
-	for (size_t normIndex = 0; normIndex < normals.size(); normIndex++)
+	if (!m_terrainAlbedoSource.empty())
 	{
-		glm::normalize(normals[normIndex]);
+		const std::string source{ m_terrainAlbedoSource };
+		m_terrainAlbedoBake = Helpers::LoadingPool().Submit([source]()
+		{
+			return Helpers::IsVirtualTextureCurrent(source) || Helpers::BakeVirtualTexture(source, Helpers::VirtualTexturePath(source));
+		});
 	}
-	
-	 m_numElements = elements.size();
-
-	GLuint TerrainVBO;
-	glGenBuffers(1, &TerrainVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, TerrainVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	GLuint TerrainColVBO;
-	glGenBuffers(1, &TerrainColVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, TerrainColVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * UVCoords.size(), UVCoords.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	GLuint elementEBO;
-	glGenBuffers(1, &elementEBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * elements.size(), elements.data(), GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-	GLuint normalbuffer;
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-
-	glGenVertexArrays(1, &t_VAO);
-	glBindVertexArray(t_VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, TerrainVBO);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(
-		0,
-		3,
-		GL_FLOAT,
-		GL_FALSE,
-		0,
-		(void*)0
-	);
-	glBindVertexArray(0);
-	glBindVertexArray(t_VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, TerrainColVBO);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(
-		1,
-		2,
-		GL_FLOAT,
-		GL_FALSE,
-		0,
-		(void*)0
-	);
-	glBindVertexArray(0);
-	glBindVertexArray(t_VAO);
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glVertexAttribPointer(
-		2,                                // attribute
-		3,                                // size
-		GL_FLOAT,                         // type
-		GL_FALSE,                         // normalized
-		0,                                // stride
-		(void*)0                          // array buffer offset
-	);
-	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementEBO);
-	glBindVertexArray(0);
 
 	//Skybox
 	std::vector<GLfloat> skyboxVerts =
@@ -594,60 +728,21 @@ bool Renderer::InitialiseGeometry()
 		 10.0f, -10.0f,  10.0f
 	};
 
-	Helpers::ImageLoader skyboxRight;
-	Helpers::ImageLoader skyboxLeft;
-	Helpers::ImageLoader skyboxTop;
-	Helpers::ImageLoader skyboxBottom;
-	Helpers::ImageLoader skyboxFront;
-	Helpers::ImageLoader skyboxBack;
-
-	if (!skyboxRight.Load("Data\\Models\\Sky\\Mars\\Mar_R.dds"))
-	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
-		return false;
-	}
-	else if (!skyboxLeft.Load("Data\\Models\\Sky\\Mars\\Mar_L.dds"))
+	Helpers::ImageLoader skyboxFaces[6];
+	const Helpers::ImageLoader* skyboxFacePointers[6];
+	for (int i = 0; i < 6; i++)
 	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
-		return false;
-	}
-	else if (!skyboxTop.Load("Data\\Models\\Sky\\Mars\\Mar_U.dds"))
-	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
-		return false;
+		skyboxFaces[i] = skyboxImages[i].get();
+		skyboxFacePointers[i] = &skyboxFaces[i];
 	}
-	else if (!skyboxBottom.Load("Data\\Models\\Sky\\Mars\\Mar_D.dds"))
-	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
-		return false;
-	}
-	else if (!skyboxFront.Load("Data\\Models\\Sky\\Mars\\Mar_F.dds"))
-	{
-		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
-		return false;
-	}
-	else if (!skyboxBack.Load("Data\\Models\\Sky\\Mars\\Mar_B.dds"))
+
+	skyboxMap = Helpers::CreateCubeMap(skyboxFacePointers);
+	if (!skyboxMap)
 	{
 		MessageBox(NULL, L"Texture not found", L"Error, you're an idiot", MB_OK | MB_ICONEXCLAMATION);
 		return false;
 	}
 
-	glGenTextures(1, &skyboxMap);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxMap);
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGBA, skyboxRight.Width(), skyboxRight.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxRight.GetData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGBA, skyboxLeft.Width(), skyboxLeft.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxLeft.GetData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGBA, skyboxTop.Width(), skyboxTop.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxTop.GetData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGBA, skyboxBottom.Width(), skyboxBottom.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxBottom.GetData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGBA, skyboxFront.Width(), skyboxFront.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxFront.GetData());
-	glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGBA, skyboxBack.Width(), skyboxBack.Height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, skyboxBack.GetData());
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-
-
 	GLuint skyMeshVBO;
 	glGenBuffers(1, &skyMeshVBO);
 	glBindBuffer(GL_ARRAY_BUFFER, skyMeshVBO);
@@ -663,6 +758,8 @@ bool Renderer::InitialiseGeometry()
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 	glBindVertexArray(0);
+
+	return true;
 };
 
 
@@ -670,6 +767,16 @@ bool Renderer::InitialiseGeometry()
 // Render the scene. Passed the delta time since last called.
 void Renderer::Render(const Helpers::Camera& camera, float deltaTime)
 {			
+	// Swap in a new terrain if a heightmap switch has finished
+	UpdateTerrainSwitch();
+
+	// Start streaming the terrain albedo once its pages are baked
+	if (m_terrainAlbedoBake.valid() && m_terrainAlbedoBake.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		if (m_terrainAlbedoBake.get())
+			m_terrainAlbedo.Open(Helpers::VirtualTexturePath(m_terrainAlbedoSource));
+	}
+
 	// Configure pipeline settings
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
@@ -735,14 +842,44 @@ void Renderer::Render(const Helpers::Camera& camera, float deltaTime)
 	GLuint combined_xform_id = glGetUniformLocation(jeepProgram, "combined_xform");
 	glUniformMatrix4fv(combined_xform_id, 1, GL_FALSE, glm::value_ptr(combined_xform));
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tex);
+	const float jeepScreenSize{ Helpers::ProjectedSize(m_jeepCentre, m_jeepRadius, camera.GetPosition(), glm::radians(45.0f), (float)viewportSize[3]) };
+	glBindTexture(GL_TEXTURE_2D, m_textures.Use(m_jeepTexture, jeepScreenSize));
 	glUniform1i(glGetUniformLocation(jeepProgram, "sampler_tex"), 0);
 	// Send the model matrix to the shader in a uniform
 	GLuint model_xform_id = glGetUniformLocation(jeepProgram, "model_xform");
 	glUniformMatrix4fv(model_xform_id, 1, GL_FALSE, glm::value_ptr(model_xform));
 	//// Bind our VAO and render
+	// Coarsest level that stays within the pixel error, measured from the nearest point of the bounding sphere
+	const float jeepDistance{ std::max(glm::length(m_jeepCentre - camera.GetPosition()) - m_jeepRadius, 1.0f) };
+	m_jeepLodDrawn = 0;
+	for (size_t i = 1; i < m_jeepLods.size(); i++)
+	{
+		if (Helpers::ProjectedLength(m_jeepLods[i].error, jeepDistance, glm::radians(45.0f), (float)viewportSize[3]) > m_lodPixelError)
+			break;
+		m_jeepLodDrawn = i;
+	}
+	const JeepLod jeepLod{ m_jeepLods.empty() ? JeepLod{ 0, j_numElements, 0.0f } : m_jeepLods[m_jeepLodDrawn] };
 	glBindVertexArray(j_VAO);
-	glDrawElements(GL_TRIANGLES, j_numElements, GL_UNSIGNED_INT, (void*)0);
+	if (m_meshletCulling && m_jeepLodDrawn == 0 && !m_jeepMeshlets.empty())
+	{
+		// Meshlets are culled in model space
+		const glm::vec3 jeepEye{ glm::inverse(model_xform) * glm::vec4(camera.GetPosition(), 1.0f) };
+		m_jeepMeshletsDrawn = Helpers::CullMeshlets(m_jeepMeshlets, Helpers::FrustumPlanes(combined_xform * model_xform), jeepEye, m_jeepVisibleRanges);
+
+		m_jeepDrawCounts.clear();
+		m_jeepDrawOffsets.clear();
+		for (const Helpers::ElementRange& range : m_jeepVisibleRanges)
+		{
+			m_jeepDrawCounts.push_back((GLsizei)range.elementCount);
+			m_jeepDrawOffsets.push_back((const void*)(sizeof(GLuint) * range.firstElement));
+		}
+		if (!m_jeepDrawCounts.empty())
+			glMultiDrawElements(GL_TRIANGLES, m_jeepDrawCounts.data(), GL_UNSIGNED_INT, m_jeepDrawOffsets.data(), (GLsizei)m_jeepDrawCounts.size());
+	}
+	else
+	{
+		glDrawElements(GL_TRIANGLES, jeepLod.numElements, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * jeepLod.firstElement));
+	}
 	glBindVertexArray(0);
 
 	//Terrain renderer
@@ -751,14 +888,43 @@ void Renderer::Render(const Helpers::Camera& camera, float deltaTime)
 	GLuint terrain_combined_xform_id = glGetUniformLocation(terrainProgram, "combined_xform");
 	glUniformMatrix4fv(terrain_combined_xform_id, 1, GL_FALSE, glm::value_ptr(terrain_combined_xform));
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, t_tex);
+	// The terrain runs right up to the camera so always needs full detail
+	glBindTexture(GL_TEXTURE_2D, m_textures.Use(m_terrainTexture));
 	glUniform1i(glGetUniformLocation(terrainProgram, "sampler_tex"), 0);
+	const bool virtualAlbedo{ m_virtualTexturing && m_terrainAlbedo.IsOpen() };
+	glUniform1i(glGetUniformLocation(terrainProgram, "vt_enabled"), virtualAlbedo);
+	if (virtualAlbedo)
+		m_terrainAlbedo.Bind(terrainProgram, 1, 2);
+	else
+	{
+		// Samplers of different types can't share a unit even when unused
+		glUniform1i(glGetUniformLocation(terrainProgram, "vt_page_table"), 1);
+		glUniform1i(glGetUniformLocation(terrainProgram, "vt_cache"), 2);
+	}
 	model_xform = glm::mat4(1);
 	GLuint terrain_model_xform_id = glGetUniformLocation(terrainProgram, "model_xform");
 	glUniformMatrix4fv(terrain_model_xform_id, 1, GL_FALSE, glm::value_ptr(model_xform));
-	glBindVertexArray(t_VAO);
-	glDrawElements(GL_TRIANGLES, m_numElements, GL_UNSIGNED_INT, (void*)0);
+	glBindVertexArray(m_terrain.vao);
+	glDrawElements(GL_TRIANGLES, m_terrain.numElements, GL_UNSIGNED_INT, (void*)0);
 	glBindVertexArray(0);
+
+	// Draw the terrain again small, recording the albedo pages it needs. Always filled so wireframe still asks for them
+	if (virtualAlbedo)
+	{
+		m_terrainAlbedo.BeginFeedback();
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glUseProgram(terrainFeedbackProgram);
+		glUniformMatrix4fv(glGetUniformLocation(terrainFeedbackProgram, "combined_xform"), 1, GL_FALSE, glm::value_ptr(terrain_combined_xform));
+		glUniformMatrix4fv(glGetUniformLocation(terrainFeedbackProgram, "model_xform"), 1, GL_FALSE, glm::value_ptr(model_xform));
+		m_terrainAlbedo.Bind(terrainFeedbackProgram, 1, 2, m_terrainAlbedo.FeedbackLodBias());
+		glBindVertexArray(m_terrain.vao);
+		glDrawElements(GL_TRIANGLES, m_terrain.numElements, GL_UNSIGNED_INT, (void*)0);
+		glBindVertexArray(0);
+		m_terrainAlbedo.EndFeedback();
+
+		if (m_wireframe)
+			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	}
 	
 	//Cube renderer
 	glUseProgram(cubeProgram);
@@ -794,5 +960,10 @@ void Renderer::Render(const Helpers::Camera& camera, float deltaTime)
 	glDrawElements(GL_TRIANGLES, c_numElements, GL_UNSIGNED_INT, (void*)0);
 	glBindVertexArray(0);
 
+	m_terrainAlbedo.Update();
+	m_textures.Update();
+
+	// Before the GUI is drawn so it isn't in the captures
+	m_capture.Update();
 }
 
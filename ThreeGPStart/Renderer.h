@@ -4,7 +4,14 @@
 
 #include "Helper.h"
 #include "Mesh.h"
+#include "Meshlets.h"
 #include "Camera.h"
+#include "Terrain.h"
+#include "FrameCapture.h"
+#include "TextureCache.h"
+#include "VirtualTexture.h"
+
+#include <future>
 
 
 
@@ -16,16 +23,47 @@ private:
 	GLuint cubeProgram{ 0 };
 	GLuint jeepProgram{ 0 };
 	GLuint skyboxProgram{ 0 };
+	GLuint terrainFeedbackProgram{ 0 };
 	//Cube
 	GLuint c_VAO{ 0 };
 	GLuint c_numElements{ 0 };
 	//Jeep
-	GLuint tex{0};
+	Helpers::TextureHandle m_jeepTexture;
+	glm::vec3 m_jeepCentre{ 0 };
+	float m_jeepRadius{ 1.0f };
 	GLuint j_VAO{ 0 };
 	GLuint j_numElements{ 0 };
+
+	// Part of the jeep's element buffer drawn at one level of detail, the full mesh first
+	struct JeepLod
+	{
+		GLuint firstElement{ 0 };
+		GLuint numElements{ 0 };
+		float error{ 0 };
+	};
+	std::vector<JeepLod> m_jeepLods;
+	size_t m_jeepLodDrawn{ 0 };
+
+	// The coarsest level whose error covers no more than this many pixels is drawn
+	float m_lodPixelError{ 1.0f };
+
+	// At full detail the jeep's meshlets outside the view or facing away are skipped, the rest are drawn with
+	// one call. The ranges and draw arrays are kept to save allocating them each frame
+	std::vector<Helpers::Meshlet> m_jeepMeshlets;
+	std::vector<Helpers::ElementRange> m_jeepVisibleRanges;
+	std::vector<GLsizei> m_jeepDrawCounts;
+	std::vector<const void*> m_jeepDrawOffsets;
+	size_t m_jeepMeshletsDrawn{ 0 };
+	bool m_meshletCulling{ true };
 	//Terrain
-	GLuint t_tex{ 0 };
-	GLuint t_VAO{ 0 };
+	Helpers::TextureHandle m_terrainTexture;
+
+	// Unique albedo over the whole terrain, streamed as a virtual texture once its pages are baked.
+	// m_terrainTexture is drawn until then
+	Helpers::VirtualTexture m_terrainAlbedo;
+	std::string m_terrainAlbedoSource;
+	std::future<bool> m_terrainAlbedoBake;
+	bool m_virtualTexturing{ true };
 	//Skybox
 	GLuint s_numElements{0};
 	GLuint s_VAO{0};
@@ -34,22 +72,53 @@ private:
 	
 
 
-	// Vertex Array Object to wrap all render settings
-	
-
-	// Number of elments to use when rendering
-	GLuint m_numElements{ 0 };
-	
+	// OpenGL objects making up one uploaded terrain
+	struct TerrainBuffers
+	{
+		GLuint vao{ 0 };
+		GLuint positionsVBO{ 0 };
+		GLuint uvVBO{ 0 };
+		GLuint normalsVBO{ 0 };
+		GLuint elementEBO{ 0 };
+		GLuint numElements{ 0 };
+	};
+
+	// The terrain currently being rendered
+	TerrainBuffers m_terrain;
+	Helpers::TerrainSettings m_terrainSettings;
+
+	// Runtime heightmap switching. A new terrain is built and copied into mapped buffers on worker threads
+	// while the current one keeps rendering, then swapped in once the GPU has the data
+	enum class TerrainSwitchState { Idle, Building, Copying, Uploading };
+	TerrainSwitchState m_terrainSwitchState{ TerrainSwitchState::Idle };
+
+	std::vector<std::string> m_heightmapFiles;
+	int m_heightmapIndex{ 0 };
+	int m_queuedHeightmapIndex{ -1 };
+
+	std::future<std::unique_ptr<Helpers::TerrainGeometry>> m_terrainBuild;
+	std::future<void> m_terrainCopy;
+	std::unique_ptr<Helpers::TerrainGeometry> m_pendingGeometry;
+	TerrainBuffers m_pendingTerrain;
+	GLsync m_pendingTerrainFence{ nullptr };
 
 	bool m_wireframe{ false };
 
+	// Every 2D texture comes from here so files used in several places are only loaded once.
+	// It also keeps them within a video memory budget
+	Helpers::TextureCache m_textures;
+	int m_textureBudgetMB{ (int)(Helpers::kDefaultTextureBudget / (1024 * 1024)) };
+
+	// Screenshots and frame recording, reads back the scene without the GUI
+	Helpers::FrameCapture m_capture;
+
 	GLuint CreateProgram(std::string, std::string);
 
-	bool Swap = false;
-	bool NoiseGen = true;
-	bool ExtraNoise = false;
-	float NoiseVal{0};
-	size_t Index{ 0 };
+	TerrainBuffers CreateTerrainBuffers(const Helpers::TerrainGeometry& terrain, void* mapped[4]);
+	bool FinishTerrainBuffers(TerrainBuffers& buffers);
+	void DeleteTerrainBuffers(TerrainBuffers& buffers);
+	void RequestTerrain(int heightmapIndex);
+	void UpdateTerrainSwitch();
 
 public:
 	Renderer();
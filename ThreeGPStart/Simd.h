@@ -0,0 +1,5 @@
+#pragma once
+// SSE and SSE2 are part of x64, the only platform this builds for, so code can use them without runtime checks or
+// scalar fallbacks. Anything newer, SSE4 or AVX, would need checking for first
+
+#include <emmintrin.h>
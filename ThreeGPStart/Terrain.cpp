@@ -0,0 +1,160 @@
+#include "Terrain.h"
+#include "ImageLoader.h"
+#include "TexelSampler.h"
+
+namespace Helpers
+{
+	static float Noise(int x, int y)
+	{
+		int n = x + y * 57;  // 57 is the seed - can be tweaked
+		n = (n >> 13) ^ n;
+		int nn = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+		return 1.0f - ((float)nn / 1073741824.0f);
+	}
+
+	// Builds a terrain grid with heights taken from heightmapFilename.
+	// If the heightmap cannot be loaded a flat grid is built and false is returned.
+	bool BuildTerrainGeometry(const std::string& heightmapFilename, const TerrainSettings& settings, TerrainGeometry& terrain)
+	{
+		const float numCellX = (float)settings.numCellsX;
+		const float numCellZ = (float)settings.numCellsZ;
+
+		const int numVertX = settings.numCellsX + 1;
+		const int numVertZ = settings.numCellsZ + 1;
+		const size_t numVerts = (size_t)numVertX * numVertZ;
+
+		std::vector<glm::vec3>& vertices = terrain.vertices;
+		std::vector<glm::vec3>& normals = terrain.normals;
+		std::vector<glm::vec2>& UVCoords = terrain.uvCoords;
+		std::vector<GLuint>& elements = terrain.elements;
+
+		vertices.clear();
+		UVCoords.clear();
+		elements.clear();
+		vertices.reserve(numVerts);
+		UVCoords.reserve(numVerts);
+		elements.reserve((size_t)settings.numCellsX * settings.numCellsZ * 6);
+		normals.assign(numVerts, glm::vec3(0, 0, 0));
+
+		// Single channel keeps 16 bit and float heightmaps at full precision and is a quarter the size of RGBA
+		Helpers::ImageLoader HeightMap;
+		const bool loaded = HeightMap.Load(heightmapFilename, Helpers::ImageLoadMode::SingleChannel);
+		if (!loaded)
+		{
+			for (int i = 0; i < numVertX; i++)
+			{
+				for (int j = 0; j < numVertZ; j++)
+				{
+					vertices.push_back(glm::vec3(i * settings.cellSize, 0, j * settings.cellSize));
+
+					UVCoords.push_back(glm::vec2(j / numCellZ, i / numCellX));
+				}
+			}
+		}
+		else
+		{
+			float vertexXtoImage = ((float)HeightMap.Width() - 1) / numVertX;
+			float vertexZtoImage = ((float)HeightMap.Height() - 1) / numVertZ;
+
+			// Smooth any 8 bit steps out of the heights before sampling
+			Helpers::HeightField heightField;
+			Helpers::HeightFieldFromImage(HeightMap, heightField);
+			Helpers::FilterHeightField(heightField, settings.heightFilter);
+
+			// Heights are sampled a column of vertices at a time. Bilinear so vertices between texels
+			// blend their neighbours rather than snapping to one
+			Helpers::TexelSampler heightSampler(heightField, Helpers::SampleFilter::Bilinear, Helpers::SampleAddress::Clamp);
+			std::vector<float> us(numVertZ);
+			std::vector<float> vs(numVertZ);
+			std::vector<float> heights(numVertZ);
+			for (int z = 0; z < numVertZ; z++)
+				vs[z] = (vertexZtoImage * z + 0.5f) / heightField.height;
+
+			for (int x = 0; x < numVertX; x++)
+			{
+				std::fill(us.begin(), us.end(), (vertexXtoImage * (numVertX - x) + 0.5f) / heightField.width);
+				heightSampler.Sample(us.data(), vs.data(), heights.data(), heights.size());
+
+				for (int z = 0; z < numVertZ; z++)
+				{
+					vertices.push_back(glm::vec3(x * settings.cellSize, heights[z], z * settings.cellSize));
+					UVCoords.push_back(glm::vec2(x / numCellZ, z / numCellX));
+				}
+			}
+		}
+
+		// Alternate the diagonal direction of each cell
+		bool Swap = false;
+		for (int cellZ = 0; cellZ < settings.numCellsZ; cellZ++)
+		{
+			for (int cellX = 0; cellX < settings.numCellsX; cellX++)
+			{
+				GLuint startVertIndex = (cellZ * numVertX) + cellX;
+				if (Swap)
+				{
+					elements.push_back(startVertIndex);
+					elements.push_back(startVertIndex + 1);
+					elements.push_back(startVertIndex + numVertX);
+
+					elements.push_back(startVertIndex + 1);
+					elements.push_back(startVertIndex + numVertX + 1);
+					elements.push_back(startVertIndex + numVertX);
+				}
+				else
+				{
+					elements.push_back(startVertIndex);
+					elements.push_back(startVertIndex + numVertX + 1);
+					elements.push_back(startVertIndex + numVertX);
+
+					elements.push_back(startVertIndex + 1);
+					elements.push_back(startVertIndex + numVertX + 1);
+					elements.push_back(startVertIndex);
+				}
+				Swap = !Swap;
+			}
+			Swap = !Swap;
+		}
+
+		if (settings.addNoise)
+		{
+			size_t Index{ 0 };
+			for (int i = 0; i < numVertX; i++)
+			{
+				for (int j = 0; j < numVertZ; j++)
+				{
+					float NoiseVal = Noise(i, j);
+					NoiseVal = NoiseVal + 1.25f / 2;
+
+					if (!settings.extraNoise)
+					{
+						NoiseVal = NoiseVal * 2;
+					}
+
+					vertices[Index].y += NoiseVal;
+					Index++;
+				}
+			}
+		}
+
+		for (size_t index = 0; index < elements.size(); index += 3)
+		{
+			glm::vec3 v0{ vertices[elements[index]] };
+			glm::vec3 v1{ vertices[elements[index + 1]] };
+			glm::vec3 v2{ vertices[elements[index + 2]] };
+
+			glm::vec3 side1 = v1 - v0;
+			glm::vec3 side2 = v2 - v0;
+
+			glm::vec3 TriNorm = glm::normalize(glm::cross(side1, side2));
+
+			normals[elements[index]] += TriNorm;
+			normals[elements[index + 1]] += TriNorm;
+			normals[elements[index + 2]] += TriNorm;
+		}
+
+		for (glm::vec3& n : normals)
+			n = glm::normalize(n);
+
+		return loaded;
+	}
+}
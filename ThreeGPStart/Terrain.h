@@ -0,0 +1,39 @@
+#pragma once
+// CPU side terrain generation from a heightmap. No OpenGL calls so it can run on a worker thread
+
+#include "ExternalLibraryHeaders.h"
+#include "HeightmapFilter.h"
+
+namespace Helpers
+{
+	// Settings used when building terrain geometry
+	struct TerrainSettings
+	{
+		// Grid size, there is one more vertex than cells on each axis
+		int numCellsX{ 500 };
+		int numCellsZ{ 500 };
+
+		// World distance between vertices
+		float cellSize{ 8.0f };
+
+		// Hash noise added to the heights. Was used to hide 8 bit steps before the height filter existed
+		bool addNoise{ false };
+		bool extraNoise{ false };
+
+		// Smoothing applied to the heightmap before it is sampled
+		HeightFilterSettings heightFilter;
+	};
+
+	// Terrain data ready to be copied into OpenGL buffers
+	struct TerrainGeometry
+	{
+		std::vector<glm::vec3> vertices;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> uvCoords;
+		std::vector<GLuint> elements;
+	};
+
+	// Builds a terrain grid with heights taken from heightmapFilename.
+	// If the heightmap cannot be loaded a flat grid is built and false is returned.
+	bool BuildTerrainGeometry(const std::string& heightmapFilename, const TerrainSettings& settings, TerrainGeometry& terrain);
+}
@@ -0,0 +1,250 @@
+#include "TexelSampler.h"
+#include "Simd.h"
+
+namespace Helpers
+{
+	// How many UV pairs are deinterleaved at a time by the glm::vec2 version
+	constexpr size_t kSampleChunk{ 256 };
+
+	TexelSampler::TexelSampler(const ImageLoader& image, int channel, SampleFilter filter, SampleAddress address) :
+		m_filter(filter), m_address(address)
+	{
+		if (!image.GetData() || image.IsCompressed() || image.Width() <= 0 || image.Height() <= 0)
+			return;
+
+		m_format = image.Format();
+		m_width = image.Width();
+		m_height = image.Height();
+		m_data = image.GetData();
+
+		if (m_format == ImageFormat::RGBA8)
+		{
+			m_data += std::clamp(channel, 0, 3);
+			m_texelStride = 4;
+		}
+	}
+
+	TexelSampler::TexelSampler(const HeightField& field, SampleFilter filter, SampleAddress address) :
+		m_filter(filter), m_address(address)
+	{
+		if (field.values.empty() || field.width <= 0 || field.height <= 0)
+			return;
+
+		m_format = ImageFormat::R32F;
+		m_width = field.width;
+		m_height = field.height;
+		m_data = (const BYTE*)field.values.data();
+	}
+
+	// SSE2 has no floor, truncate and step down where that went up. Fine for the texel ranges used here
+	static inline __m128 Floor(__m128 x)
+	{
+		const __m128 truncated{ _mm_cvtepi32_ps(_mm_cvttps_epi32(x)) };
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+	}
+
+	// Picks a where mask is set, otherwise b
+	static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Keeps texel coordinates inside the image. _mm_max_ps returns its second operand for NaN so bad UVs end up at 0
+	static inline __m128 ClampTexel(__m128 t, __m128 maxTexel)
+	{
+		return _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), maxTexel);
+	}
+
+	// Everything the 4 wide sampling needs, worked out once per batch
+	template<typename T>
+	struct SampleSource
+	{
+		const T* data;
+		size_t rowStride;
+		int texelStride;
+		float scale;
+		__m128 size[2];
+		__m128 maxTexel[2];
+		SampleFilter filter;
+		SampleAddress address;
+
+		float Fetch(int x, int y) const
+		{
+			return (float)data[(size_t)y * rowStride + (size_t)x * texelStride];
+		}
+	};
+
+	// Turns 4 coordinates along one axis into the texel(s) to read and, for bilinear, the blend weight
+	template<typename T>
+	static inline void TexelCoordinates(const SampleSource<T>& source, int axis, __m128 uv, __m128i& t0, __m128i& t1, __m128& weight)
+	{
+		const __m128 size{ source.size[axis] };
+		const __m128 maxTexel{ source.maxTexel[axis] };
+
+		// Past 2^23 floats have no fraction left so wrap to 0. NaN and infinities go to 0 too, the floor would turn
+		// them into NaN weights
+		if (source.address == SampleAddress::Wrap)
+		{
+			const __m128 magnitude{ _mm_andnot_ps(_mm_set1_ps(-0.0f), uv) };
+			uv = _mm_and_ps(uv, _mm_cmplt_ps(magnitude, _mm_set1_ps(8388608.0f)));
+			uv = _mm_sub_ps(uv, Floor(uv));
+		}
+		else
+			uv = _mm_min_ps(_mm_max_ps(uv, _mm_set1_ps(-1.0f)), _mm_set1_ps(2.0f));
+
+		if (source.filter == SampleFilter::Nearest)
+		{
+			t0 = _mm_cvttps_epi32(ClampTexel(Floor(_mm_mul_ps(uv, size)), maxTexel));
+			return;
+		}
+
+		const __m128 texel{ _mm_sub_ps(_mm_mul_ps(uv, size), _mm_set1_ps(0.5f)) };
+		__m128 first{ Floor(texel) };
+		__m128 second{ _mm_add_ps(first, _mm_set1_ps(1.0f)) };
+		weight = _mm_sub_ps(texel, first);
+
+		// Neighbours off the edge come from the other side when wrapping, clamping is then a no op
+		if (source.address == SampleAddress::Wrap)
+		{
+			first = Select(_mm_cmplt_ps(first, _mm_setzero_ps()), maxTexel, first);
+			second = Select(_mm_cmpgt_ps(second, maxTexel), _mm_setzero_ps(), second);
+		}
+
+		t0 = _mm_cvttps_epi32(ClampTexel(first, maxTexel));
+		t1 = _mm_cvttps_epi32(ClampTexel(second, maxTexel));
+	}
+
+	// Samples 4 UVs
+	template<typename T>
+	static inline __m128 Sample4(const SampleSource<T>& source, __m128 u, __m128 v)
+	{
+		__m128i x0, x1, y0, y1;
+		__m128 fx{ _mm_setzero_ps() };
+		__m128 fy{ _mm_setzero_ps() };
+		TexelCoordinates(source, 0, u, x0, x1, fx);
+		TexelCoordinates(source, 1, v, y0, y1, fy);
+
+		// No gather in SSE2 so the reads are scalar, the maths around them is not
+		alignas(16) int ix0[4];
+		alignas(16) int iy0[4];
+		_mm_store_si128((__m128i*)ix0, x0);
+		_mm_store_si128((__m128i*)iy0, y0);
+
+		if (source.filter == SampleFilter::Nearest)
+		{
+			const __m128 result{ _mm_setr_ps(source.Fetch(ix0[0], iy0[0]), source.Fetch(ix0[1], iy0[1]),
+				source.Fetch(ix0[2], iy0[2]), source.Fetch(ix0[3], iy0[3])) };
+			return _mm_mul_ps(result, _mm_set1_ps(source.scale));
+		}
+
+		alignas(16) int ix1[4];
+		alignas(16) int iy1[4];
+		_mm_store_si128((__m128i*)ix1, x1);
+		_mm_store_si128((__m128i*)iy1, y1);
+
+		alignas(16) float t00[4];
+		alignas(16) float t10[4];
+		alignas(16) float t01[4];
+		alignas(16) float t11[4];
+		for (int i = 0; i < 4; i++)
+		{
+			t00[i] = source.Fetch(ix0[i], iy0[i]);
+			t10[i] = source.Fetch(ix1[i], iy0[i]);
+			t01[i] = source.Fetch(ix0[i], iy1[i]);
+			t11[i] = source.Fetch(ix1[i], iy1[i]);
+		}
+
+		const __m128 a{ _mm_load_ps(t00) };
+		const __m128 b{ _mm_load_ps(t01) };
+		const __m128 top{ _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(t10), a), fx)) };
+		const __m128 bottom{ _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(t11), b), fx)) };
+		const __m128 result{ _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy)) };
+		return _mm_mul_ps(result, _mm_set1_ps(source.scale));
+	}
+
+	template<typename T>
+	static void SampleSpan(const SampleSource<T>& source, const float* u, const float* v, float* results, size_t count)
+	{
+		size_t i{ 0 };
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(results + i, Sample4(source, _mm_loadu_ps(u + i), _mm_loadu_ps(v + i)));
+
+		// Pad the last few out to 4
+		if (i < count)
+		{
+			alignas(16) float tailU[4]{};
+			alignas(16) float tailV[4]{};
+			alignas(16) float tailResults[4];
+			const size_t remaining{ count - i };
+			memcpy(tailU, u + i, remaining * sizeof(float));
+			memcpy(tailV, v + i, remaining * sizeof(float));
+			_mm_store_ps(tailResults, Sample4(source, _mm_load_ps(tailU), _mm_load_ps(tailV)));
+			memcpy(results + i, tailResults, remaining * sizeof(float));
+		}
+	}
+
+	template<typename T>
+	static SampleSource<T> MakeSource(const BYTE* data, int width, int height, int texelStride, float scale, SampleFilter filter, SampleAddress address)
+	{
+		SampleSource<T> source;
+		source.data = (const T*)data;
+		source.rowStride = (size_t)width * texelStride;
+		source.texelStride = texelStride;
+		source.scale = scale;
+		source.size[0] = _mm_set1_ps((float)width);
+		source.size[1] = _mm_set1_ps((float)height);
+		source.maxTexel[0] = _mm_set1_ps((float)(width - 1));
+		source.maxTexel[1] = _mm_set1_ps((float)(height - 1));
+		source.filter = filter;
+		source.address = address;
+		return source;
+	}
+
+	// Samples count UVs, results[i] is the value at (u[i], v[i])
+	void TexelSampler::Sample(const float* u, const float* v, float* results, size_t count) const
+	{
+		if (!m_data)
+		{
+			std::fill(results, results + count, 0.0f);
+			return;
+		}
+
+		switch (m_format)
+		{
+		case ImageFormat::R16:
+			SampleSpan(MakeSource<UINT16>(m_data, m_width, m_height, 1, 255.0f / 65535.0f, m_filter, m_address), u, v, results, count);
+			break;
+		case ImageFormat::R32F:
+			SampleSpan(MakeSource<float>(m_data, m_width, m_height, 1, 1.0f, m_filter, m_address), u, v, results, count);
+			break;
+		default:
+			SampleSpan(MakeSource<BYTE>(m_data, m_width, m_height, m_texelStride, 1.0f, m_filter, m_address), u, v, results, count);
+			break;
+		}
+	}
+
+	// Samples count UVs given as pairs
+	void TexelSampler::Sample(const glm::vec2* uvs, float* results, size_t count) const
+	{
+		float u[kSampleChunk];
+		float v[kSampleChunk];
+		for (size_t begin = 0; begin < count; begin += kSampleChunk)
+		{
+			const size_t chunk{ std::min(kSampleChunk, count - begin) };
+			for (size_t i = 0; i < chunk; i++)
+			{
+				u[i] = uvs[begin + i].x;
+				v[i] = uvs[begin + i].y;
+			}
+			Sample(u, v, results + begin, chunk);
+		}
+	}
+
+	// Single sample, prefer the batch versions for more than a handful
+	float TexelSampler::Sample(float u, float v) const
+	{
+		float result{ 0.0f };
+		Sample(&u, &v, &result, 1);
+		return result;
+	}
+}
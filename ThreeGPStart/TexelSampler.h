@@ -0,0 +1,64 @@
+#pragma once
+// CPU texture sampling for things like terrain building and scattering objects over a texture.
+// Meant to be called with many UVs at once, the batch version works on 4 samples at a time with SSE2.
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+#include "HeightmapFilter.h"
+
+namespace Helpers
+{
+	enum class SampleFilter
+	{
+		Nearest,
+		Bilinear
+	};
+
+	// What happens to UVs outside 0-1
+	enum class SampleAddress
+	{
+		Wrap,
+		Clamp
+	};
+
+	// Samples one channel of an image or a height field using OpenGL conventions, so a UV of (x + 0.5) / width
+	// hits the centre of texel x. Values come back in the same units as HeightFieldFromImage: 0-255 for 8 bit
+	// data, R16 scaled to 0-255 and floats as they are.
+	// Only keeps a pointer to the data, which must outlive the sampler. Compressed images can't be sampled.
+	class TexelSampler
+	{
+	private:
+		const BYTE* m_data{ nullptr };
+		ImageFormat m_format{ ImageFormat::R32F };
+		int m_width{ 0 };
+		int m_height{ 0 };
+
+		// Elements between neighbouring texels, 4 when reading one channel of RGBA
+		int m_texelStride{ 1 };
+
+		SampleFilter m_filter{ SampleFilter::Bilinear };
+		SampleAddress m_address{ SampleAddress::Wrap };
+	public:
+		TexelSampler() = default;
+
+		// Samples channel (0 red to 3 alpha) of RGBA images or the only channel of single channel ones
+		TexelSampler(const ImageLoader& image, int channel = 0, SampleFilter filter = SampleFilter::Bilinear, SampleAddress address = SampleAddress::Wrap);
+
+		TexelSampler(const HeightField& field, SampleFilter filter = SampleFilter::Bilinear, SampleAddress address = SampleAddress::Clamp);
+
+		// False if there is nothing to sample e.g. the image was compressed or empty
+		bool IsValid() const { return m_data != nullptr; }
+
+		void SetFilter(SampleFilter filter) { m_filter = filter; }
+		void SetAddress(SampleAddress address) { m_address = address; }
+
+		// Samples count UVs, results[i] is the value at (u[i], v[i])
+		void Sample(const float* u, const float* v, float* results, size_t count) const;
+
+		// Samples count UVs given as pairs
+		void Sample(const glm::vec2* uvs, float* results, size_t count) const;
+
+		// Single sample, prefer the batch versions for more than a handful
+		float Sample(float u, float v) const;
+	};
+}
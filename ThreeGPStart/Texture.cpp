@@ -0,0 +1,179 @@
+#include "Texture.h"
+
+namespace Helpers
+{
+	// OpenGL internal format for a block compressed image format
+	static GLenum CompressedInternalFormat(ImageFormat format)
+	{
+		switch (format)
+		{
+		case ImageFormat::BC1:
+			return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		case ImageFormat::BC2:
+			return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		case ImageFormat::BC3:
+			return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		default:
+			return 0;
+		}
+	}
+
+	// OpenGL formats for an uncompressed image format
+	static void UncompressedFormats(ImageFormat format, GLint& internalFormat, GLenum& pixelFormat, GLenum& type)
+	{
+		switch (format)
+		{
+		case ImageFormat::R8:
+			internalFormat = GL_R8;
+			pixelFormat = GL_RED;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		case ImageFormat::R16:
+			internalFormat = GL_R16;
+			pixelFormat = GL_RED;
+			type = GL_UNSIGNED_SHORT;
+			break;
+		case ImageFormat::R32F:
+			internalFormat = GL_R32F;
+			pixelFormat = GL_RED;
+			type = GL_FLOAT;
+			break;
+		default:
+			internalFormat = GL_RGBA8;
+			pixelFormat = GL_RGBA;
+			type = GL_UNSIGNED_BYTE;
+			break;
+		}
+	}
+
+	// Uploads image to target (a 2D texture or one cube map face). Compressed images and baked containers
+	// upload their stored mip chain as is. Returns the number of mip levels uploaded.
+	static int UploadImage(GLenum target, const ImageLoader& image)
+	{
+		const GLenum compressedFormat{ CompressedInternalFormat(image.Format()) };
+		GLint internalFormat{ 0 };
+		GLenum pixelFormat{ 0 };
+		GLenum type{ 0 };
+		UncompressedFormats(image.Format(), internalFormat, pixelFormat, type);
+
+		// Single channel rows are not necessarily a multiple of 4 bytes
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int i = 0; i < image.MipLevelCount(); i++)
+		{
+			const ImageMipLevel level{ image.GetMipLevel(i) };
+			if (image.IsCompressed())
+				glCompressedTexImage2D(target, i, compressedFormat, level.width, level.height, 0, (GLsizei)level.size, image.GetData() + level.offset);
+			else
+				glTexImage2D(target, i, internalFormat, level.width, level.height, 0, pixelFormat, type, image.GetData() + level.offset);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		return image.MipLevelCount();
+	}
+
+	// Creates a mipmapped 2D texture from image. Returns 0 if the image has no data.
+	GLuint CreateTexture2D(const ImageLoader& image, GLint wrapMode)
+	{
+		if (!image.GetData())
+			return 0;
+
+		GLuint texture{ 0 };
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapMode);
+
+		const int numLevels{ UploadImage(GL_TEXTURE_2D, image) };
+		if (numLevels == 1 && !image.IsCompressed())
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		else
+		{
+			// Mips come from the file. Mip generation isn't reliably supported for compressed formats anyway
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		}
+
+		return texture;
+	}
+
+	// Creates an immutable 2D texture from mip levels firstLevel onwards of image. Levels that retained holds,
+	// it starting at level retainedFirstLevel of image, are copied from it on the GPU instead. Returns 0 on error
+	GLuint CreateTexture2DFromLevel(const ImageLoader& image, int firstLevel, GLint wrapMode, GLuint retained, int retainedFirstLevel)
+	{
+		if (!image.GetData() || firstLevel < 0 || firstLevel >= image.MipLevelCount())
+			return 0;
+
+		const GLenum compressedFormat{ CompressedInternalFormat(image.Format()) };
+		GLint internalFormat{ 0 };
+		GLenum pixelFormat{ 0 };
+		GLenum type{ 0 };
+		UncompressedFormats(image.Format(), internalFormat, pixelFormat, type);
+
+		// Immutable storage needs the level count up front
+		const ImageMipLevel top{ image.GetMipLevel(firstLevel) };
+		const bool generateMips{ image.MipLevelCount() == 1 && !image.IsCompressed() };
+		const int numLevels{ generateMips ? (int)std::log2(std::max(top.width, top.height)) + 1 : image.MipLevelCount() - firstLevel };
+
+		GLuint texture{ 0 };
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, numLevels, image.IsCompressed() ? compressedFormat : (GLenum)internalFormat, top.width, top.height);
+
+		// Generated chains are made whole, so there is nothing to copy
+		const int firstRetained{ retained && !generateMips ? std::max(retainedFirstLevel, firstLevel) : image.MipLevelCount() };
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int i = 0; i < (generateMips ? 1 : numLevels); i++)
+		{
+			const ImageMipLevel level{ image.GetMipLevel(firstLevel + i) };
+			if (firstLevel + i >= firstRetained)
+				glCopyImageSubData(retained, GL_TEXTURE_2D, firstLevel + i - retainedFirstLevel, 0, 0, 0, texture, GL_TEXTURE_2D, i, 0, 0, 0, level.width, level.height, 1);
+			else if (image.IsCompressed())
+				glCompressedTextureSubImage2D(texture, i, 0, 0, level.width, level.height, compressedFormat, (GLsizei)level.size, image.GetData() + level.offset);
+			else
+				glTextureSubImage2D(texture, i, 0, 0, level.width, level.height, pixelFormat, type, image.GetData() + level.offset);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (generateMips)
+			glGenerateTextureMipmap(texture);
+
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, wrapMode);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, wrapMode);
+
+		return texture;
+	}
+
+	// Creates a cube map from six faces given in OpenGL order: +X, -X, +Y, -Y, +Z, -Z.
+	GLuint CreateCubeMap(const ImageLoader* const faces[6])
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			if (!faces[i] || !faces[i]->GetData())
+				return 0;
+		}
+
+		GLuint texture{ 0 };
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+		// Faces can in theory have different numbers of mips so only use the levels they all have
+		int numLevels{ 1000 };
+		for (int i = 0; i < 6; i++)
+			numLevels = std::min(numLevels, UploadImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, *faces[i]));
+
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+		return texture;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+// Helpers for creating OpenGL textures from loaded images
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+
+namespace Helpers
+{
+	// Creates a mipmapped 2D texture from image. Returns 0 if the image has no data.
+	GLuint CreateTexture2D(const ImageLoader& image, GLint wrapMode = GL_REPEAT);
+
+	// Creates an immutable 2D texture from mip levels firstLevel onwards of image, leaving out the larger ones to
+	// save memory. Images with a single uncompressed level get the rest of their chain generated. Returns 0 on error.
+	// When changing the levels of an existing texture pass it as retained, along with the image level its level 0
+	// holds, and the levels both share are copied across on the GPU rather than uploaded again
+	GLuint CreateTexture2DFromLevel(const ImageLoader& image, int firstLevel, GLint wrapMode = GL_REPEAT, GLuint retained = 0, int retainedFirstLevel = 0);
+
+	// Creates a cube map from six faces given in OpenGL order: +X, -X, +Y, -Y, +Z, -Z.
+	// Returns 0 if any face has no data.
+	GLuint CreateCubeMap(const ImageLoader* const faces[6]);
+}
@@ -0,0 +1,314 @@
+#include "TextureCache.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	// Frames without being drawn before a texture counts as cold and can be evicted when over budget
+	constexpr UINT64 kColdFrames{ 120 };
+
+	// Most texture data streamed in per Update, to spread big uploads over several frames
+	constexpr size_t kMaxStreamBytesPerFrame{ 32 * 1024 * 1024 };
+
+	CachedTexture::CachedTexture(const std::string& filepath, const TextureOptions& options) :
+		m_filepath(filepath), m_options(options)
+	{
+		// The mip chain is built here too so any level can be uploaded on its own later
+		m_image = LoadingPool().Submit([filepath, options]()
+		{
+			ImageLoader image;
+			if (image.Load(filepath, options.loadMode))
+				image.GenerateMipChain();
+			return image;
+		});
+	}
+
+	CachedTexture::~CachedTexture()
+	{
+		// The decode may still be running, the future's shared state keeps its result alive until it finishes
+		glDeleteTextures(1, &m_texture);
+	}
+
+	// Waits for the decode. Returns false if the image couldn't be loaded
+	bool CachedTexture::FinishLoading()
+	{
+		if (m_image.valid())
+		{
+			m_source = m_image.get();
+			if (!m_source.GetData())
+				std::cout << "TextureCache could not load " << m_filepath << std::endl;
+		}
+		return m_source.GetData() != nullptr;
+	}
+
+	// Takes the decoded image if it is ready, without waiting. Returns false until then or if it couldn't be loaded
+	bool CachedTexture::PollLoading()
+	{
+		if (m_image.valid() && m_image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+		return FinishLoading();
+	}
+
+	// Video memory used when resident from baseLevel
+	size_t CachedTexture::ResidentSize(int baseLevel) const
+	{
+		size_t size{ 0 };
+		for (int i = baseLevel; i < m_source.MipLevelCount(); i++)
+			size += m_source.GetMipLevel(i).size;
+
+		// Single level images get their chain generated on the GPU, a third on top
+		if (m_source.MipLevelCount() == 1 && baseLevel == 0 && !m_source.IsCompressed())
+			size += size / 3;
+
+		return size;
+	}
+
+	// First mip level worth having for a texture covering screenSize pixels across
+	int CachedTexture::BaseLevelFor(float screenSize) const
+	{
+		if (screenSize <= 0.0f)
+			return 0;
+
+		// Keep the level at least as big as the screen footprint so there is no visible blurring
+		const float texels{ (float)std::max(m_source.Width(), m_source.Height()) };
+		const int level{ (int)std::floor(std::log2(std::max(texels / screenSize, 1.0f))) };
+		return std::clamp(level, 0, m_source.MipLevelCount() - 1);
+	}
+
+	// Makes the texture hold mip levels baseLevel onwards of the source, or frees it if baseLevel is past the last
+	// level. Only levels it didn't already hold are uploaded
+	void CachedTexture::MakeResident(int baseLevel)
+	{
+		if (m_texture && baseLevel == m_residentBase)
+			return;
+
+		// Immutable storage can't change size, so the levels kept are copied to a new texture on the GPU
+		GLuint texture{ 0 };
+		if (baseLevel < m_source.MipLevelCount())
+		{
+			texture = CreateTexture2DFromLevel(m_source, baseLevel, m_options.wrapMode, m_texture, m_residentBase);
+			if (!texture)
+			{
+				std::cout << "TextureCache could not create a texture from " << m_filepath << std::endl;
+				return;
+			}
+		}
+
+		// OpenGL defers deleting the old texture until draws still using it are done
+		glDeleteTextures(1, &m_texture);
+		m_texture = texture;
+		m_residentBase = baseLevel;
+		m_residentBytes = texture ? ResidentSize(baseLevel) : 0;
+	}
+
+	// The OpenGL texture, 0 while decoding or if the image could not be loaded. Created once the decode is done
+	GLuint CachedTexture::Id()
+	{
+		if (!m_texture && PollLoading())
+			MakeResident(m_wantedBase);
+		return m_texture;
+	}
+
+	// Absolute, lexically normal, lower case path with \ separators
+	std::string NormalisePath(const std::string& filepath)
+	{
+		// Only resolves the parts that exist, a missing file still gets a consistent key
+		std::error_code error;
+		fs::path path{ fs::weakly_canonical(fs::path(filepath), error) };
+		if (error)
+			path = fs::absolute(fs::path(filepath), error).lexically_normal();
+
+		std::string normalised{ path.string() };
+		std::replace(normalised.begin(), normalised.end(), '/', '\\');
+
+		// Windows paths are case insensitive
+		std::transform(normalised.begin(), normalised.end(), normalised.begin(), [](char c) { return (char)tolower(c); });
+		return normalised;
+	}
+
+	// Rough diameter in pixels of a sphere on screen
+	float ProjectedSize(const glm::vec3& centre, float radius, const glm::vec3& eye, float fovY, float viewportHeight)
+	{
+		// Inside the sphere it fills the screen
+		const float distance{ std::max(glm::length(centre - eye), radius) };
+		return viewportHeight * radius / (distance * std::tan(fovY * 0.5f));
+	}
+
+	// Handle to the texture for filepath, starting the decode if no one holds it yet
+	TextureHandle TextureCache::Acquire(const std::string& filepath, const TextureOptions& options)
+	{
+		const std::string key{ NormalisePath(filepath) + "|" + std::to_string(options.wrapMode) + "|" + std::to_string((int)options.loadMode) };
+
+		std::weak_ptr<CachedTexture>& entry{ m_textures[key] };
+		if (TextureHandle texture{ entry.lock() })
+		{
+			m_hits++;
+			return texture;
+		}
+
+		m_misses++;
+		TextureHandle texture{ std::make_shared<CachedTexture>(filepath, options) };
+		entry = texture;
+
+		// Keep the map from filling up with dead entries as textures come and go
+		if (m_misses % 64 == 0)
+			Prune();
+
+		return texture;
+	}
+
+	// Handle to the diffuse texture of a material loaded from modelFilepath, nullptr if it has none
+	TextureHandle TextureCache::AcquireDiffuse(const Material& material, const std::string& modelFilepath, const TextureOptions& options)
+	{
+		if (material.diffuseTextureFilename.empty())
+			return nullptr;
+
+		const fs::path modelFolder{ fs::path(modelFilepath).parent_path() };
+		return Acquire((modelFolder / material.diffuseTextureFilename).string(), options);
+	}
+
+	// The texture to draw with this frame, recording the use and the detail it needs
+	GLuint TextureCache::Use(const TextureHandle& texture, float screenSize)
+	{
+		// Still decoding, there is nothing to draw with yet
+		if (!texture || !texture->PollLoading())
+			return 0;
+
+		// Drawn more than once a frame, the biggest use decides
+		const int wanted{ texture->BaseLevelFor(screenSize) };
+		if (texture->m_lastUsedFrame == m_frame)
+			texture->m_wantedBase = std::min(texture->m_wantedBase, wanted);
+		else
+			texture->m_wantedBase = wanted;
+		texture->m_lastUsedFrame = m_frame;
+
+		// New or evicted textures stay 0 until Update streams them in within the budget
+		return texture->m_texture;
+	}
+
+	// Streams in wanted levels and keeps to the budget. Call once a frame after drawing
+	void TextureCache::Update()
+	{
+		// Resident textures and those drawn this frame. Raw pointers are fine, nothing can release a handle until
+		// this returns
+		std::vector<CachedTexture*> resident;
+		m_residentBytes = 0;
+		for (auto it = m_textures.begin(); it != m_textures.end();)
+		{
+			const TextureHandle texture{ it->second.lock() };
+			if (!texture)
+			{
+				it = m_textures.erase(it);
+				continue;
+			}
+
+			if (texture->m_texture || texture->m_lastUsedFrame == m_frame)
+			{
+				resident.push_back(texture.get());
+				m_residentBytes += texture->m_residentBytes;
+			}
+			++it;
+		}
+
+		// Least recently used first, biggest first between equals
+		std::sort(resident.begin(), resident.end(), [](const CachedTexture* a, const CachedTexture* b)
+		{
+			if (a->m_lastUsedFrame != b->m_lastUsedFrame)
+				return a->m_lastUsedFrame < b->m_lastUsedFrame;
+			return a->m_residentBytes > b->m_residentBytes;
+		});
+
+		// Extra memory the textures drawn this frame want for more detail
+		size_t demand{ 0 };
+		for (const CachedTexture* texture : resident)
+		{
+			if (texture->m_lastUsedFrame == m_frame && (!texture->m_texture || texture->m_wantedBase < texture->m_residentBase))
+				demand += texture->ResidentSize(texture->m_wantedBase) - texture->m_residentBytes;
+		}
+
+		// Make room by dropping levels nobody needs, then evicting cold textures. If that isn't enough and the budget
+		// is actually exceeded, lower the detail of the rest one level at a time. Anything still over is dealt with
+		// over the next frames
+		for (int pass = 0; pass < 3; pass++)
+		{
+			const size_t target{ pass < 2 ? m_budget - std::min(m_budget, demand) : m_budget };
+			for (CachedTexture* texture : resident)
+			{
+				if (m_residentBytes <= target)
+					break;
+
+				const int lastLevel{ texture->m_source.MipLevelCount() - 1 };
+				int base{ texture->m_residentBase };
+				if (pass == 0)
+					base = std::max(base, texture->m_wantedBase);
+				else if (pass == 1 && m_frame - texture->m_lastUsedFrame > kColdFrames)
+					base = lastLevel + 1;
+				else if (pass == 2)
+					base = std::min(base + 1, lastLevel);
+
+				if (base != texture->m_residentBase && texture->m_texture)
+				{
+					m_residentBytes -= texture->m_residentBytes;
+					texture->MakeResident(base);
+					m_residentBytes += texture->m_residentBytes;
+				}
+			}
+		}
+
+		// Stream in detail for what was drawn this frame, most recently used first. Levels go in smallest first for
+		// as long as they fit the budget and this frame's share, so a big texture sharpens over a few frames. The
+		// first level of a frame may go over the share so one large level can't hold streaming up, and anything
+		// drawn gets its smallest level even over budget so it shows up, the passes above make room later
+		size_t streamed{ 0 };
+		for (auto it = resident.rbegin(); it != resident.rend(); ++it)
+		{
+			CachedTexture* texture{ *it };
+			if (texture->m_lastUsedFrame != m_frame)
+				continue;
+
+			const int current{ texture->m_texture ? texture->m_residentBase : texture->m_source.MipLevelCount() };
+			int base{ current };
+			while (base > texture->m_wantedBase)
+			{
+				const size_t extra{ texture->ResidentSize(base - 1) - texture->m_residentBytes };
+				const bool firstOfFrame{ streamed == 0 && base == current };
+				const bool firstLevel{ !texture->m_texture && base == current };
+				if (!firstLevel && (m_residentBytes + extra > m_budget || (!firstOfFrame && streamed + extra > kMaxStreamBytesPerFrame)))
+					break;
+				base--;
+			}
+
+			if (base == current)
+				continue;
+
+			const size_t before{ texture->m_residentBytes };
+			texture->MakeResident(base);
+			m_residentBytes += texture->m_residentBytes - before;
+			streamed += texture->m_residentBytes - before;
+		}
+
+		m_frame++;
+	}
+
+	// Drops entries whose textures have been freed
+	void TextureCache::Prune()
+	{
+		for (auto it = m_textures.begin(); it != m_textures.end();)
+		{
+			if (it->second.expired())
+				it = m_textures.erase(it);
+			else
+				++it;
+		}
+	}
+
+	// Number of distinct textures currently alive
+	size_t TextureCache::Size()
+	{
+		Prune();
+		return m_textures.size();
+	}
+}
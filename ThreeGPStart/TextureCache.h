@@ -0,0 +1,146 @@
+#pragma once
+// Shares textures between everything that uses the same image, so each file is decoded and uploaded once.
+// Also keeps the textures inside a video memory budget: only the mip levels needed for how big a texture
+// appears on screen are uploaded, and textures that haven't been drawn for a while lose detail or are evicted.
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+#include "Mesh.h"
+#include <future>
+#include <memory>
+#include <unordered_map>
+
+namespace Helpers
+{
+	// Budget used until SetBudget is called
+	constexpr size_t kDefaultTextureBudget{ 256 * 1024 * 1024 };
+
+	// Settings that change the texture made from a file. Part of the cache key, so the same file
+	// with different options gives different textures
+	struct TextureOptions
+	{
+		GLint wrapMode{ GL_REPEAT };
+		ImageLoadMode loadMode{ ImageLoadMode::RGBA };
+	};
+
+	// One texture owned by the cache's handles. The image is decoded (and its mip chain built) on the loading pool
+	// straight away and the OpenGL texture created once it is done, when TextureCache::Update streams it in.
+	// The decoded image is kept so levels can be uploaded again after being dropped. Only baked containers are
+	// memory mapped and cost no memory for this, everything else, DDS included, is held decoded
+	class CachedTexture
+	{
+		friend class TextureCache;
+	private:
+		std::string m_filepath;
+		TextureOptions m_options;
+		std::future<ImageLoader> m_image;
+		ImageLoader m_source;
+		GLuint m_texture{ 0 };
+
+		// Residency, the texture holds mip levels m_residentBase onwards of the source
+		int m_residentBase{ 0 };
+		int m_wantedBase{ 0 };
+		size_t m_residentBytes{ 0 };
+		UINT64 m_lastUsedFrame{ 0 };
+
+		// Takes the decoded image if it is ready, without waiting. Returns false until then or if it couldn't be loaded
+		bool PollLoading();
+
+		// Makes the texture hold mip levels baseLevel onwards of the source, or frees it if baseLevel is past the last
+		// level. Only levels it didn't already hold are uploaded, the rest are copied across on the GPU
+		void MakeResident(int baseLevel);
+
+		// Video memory used when resident from baseLevel
+		size_t ResidentSize(int baseLevel) const;
+
+		// First mip level worth having for a texture covering screenSize pixels across, 0 for any size
+		int BaseLevelFor(float screenSize) const;
+	public:
+		CachedTexture(const std::string& filepath, const TextureOptions& options);
+
+		// Deletes the OpenGL texture, so must happen on the OpenGL thread
+		~CachedTexture();
+
+		CachedTexture(const CachedTexture&) = delete;
+		CachedTexture& operator=(const CachedTexture&) = delete;
+
+		// Waits for the decode, for start up code that has to know the file loaded. Returns false if it couldn't be
+		bool FinishLoading();
+
+		// The OpenGL texture, 0 while decoding or if the image could not be loaded. The first call after the decode
+		// creates the texture outside the budget, so must be made on the OpenGL thread. Prefer TextureCache::Use
+		// when drawing, which also tracks the use for the budget. The id changes when the resident levels change
+		GLuint Id();
+
+		// False while the image is still being decoded
+		bool IsDecoded() const { return !m_image.valid(); }
+
+		const std::string& Filepath() const { return m_filepath; }
+
+		// Size of the full resolution image, 0 until decoded
+		int Width() const { return m_source.Width(); }
+		int Height() const { return m_source.Height(); }
+
+		// Top mip level currently in video memory, 0 is full resolution
+		int ResidentBaseLevel() const { return m_residentBase; }
+	};
+
+	// Reference counted, the texture is deleted when the last handle to it goes
+	using TextureHandle = std::shared_ptr<CachedTexture>;
+
+	// Registry of the textures in use, keyed by normalised path and options. The cache only tracks textures,
+	// the handles own them, so a texture nobody holds is freed rather than kept around.
+	// Not thread safe, use from the OpenGL thread
+	class TextureCache
+	{
+	private:
+		std::unordered_map<std::string, std::weak_ptr<CachedTexture>> m_textures;
+		int m_hits{ 0 };
+		int m_misses{ 0 };
+
+		size_t m_budget{ kDefaultTextureBudget };
+		size_t m_residentBytes{ 0 };
+		UINT64 m_frame{ 1 };
+
+		// Drops entries whose textures have been freed
+		void Prune();
+	public:
+		// Handle to the texture for filepath, starting the decode if no one holds it yet.
+		// Returns the same texture for paths that point at the same file e.g. "a\\..\\b.png" and "B.png"
+		TextureHandle Acquire(const std::string& filepath, const TextureOptions& options = TextureOptions());
+
+		// Handle to the diffuse texture of a material loaded from modelFilepath, nullptr if it has none.
+		// Material texture names are relative to the model's folder
+		TextureHandle AcquireDiffuse(const Material& material, const std::string& modelFilepath, const TextureOptions& options = TextureOptions());
+
+		// The texture to draw with this frame. screenSize is roughly how many pixels across the texture covers
+		// on screen (see ProjectedSize), which decides the mip levels it needs. 0 asks for full resolution.
+		// Never waits or uploads, a texture is 0 until its decode is done and Update has streamed it in
+		GLuint Use(const TextureHandle& texture, float screenSize = 0.0f);
+
+		// Call once a frame after drawing. Streams in the levels textures now need, a few at a time, and when over budget
+		// drops levels that aren't needed, then evicts textures that haven't been used for a while,
+		// then lowers the detail of what is on screen until everything fits
+		void Update();
+
+		// Video memory allowed for the textures. Going over is only temporary
+		void SetBudget(size_t bytes) { m_budget = bytes; }
+		size_t Budget() const { return m_budget; }
+
+		// Video memory used by the textures as of the last Update
+		size_t ResidentBytes() const { return m_residentBytes; }
+
+		// Number of distinct textures currently alive
+		size_t Size();
+
+		// Acquires that found a live texture / had to load one
+		int Hits() const { return m_hits; }
+		int Misses() const { return m_misses; }
+	};
+
+	// Absolute, lexically normal, lower case path with \ separators so differently written paths to the same file compare equal
+	std::string NormalisePath(const std::string& filepath);
+
+	// Rough diameter in pixels of a sphere on screen, for working out the detail a texture on it needs
+	float ProjectedSize(const glm::vec3& centre, float radius, const glm::vec3& eye, float fovY, float viewportHeight);
+}
@@ -0,0 +1,197 @@
+#include "TextureContainer.h"
+#include "BlockCompress.h"
+#include <fstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	static_assert(sizeof(TextureContainerHeader) <= kTextureContainerDataAlignment, "Container header must fit before the level data");
+
+	static size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// The file BakeTexture writes for sourcePath
+	std::string BakedTexturePath(const std::string& sourcePath)
+	{
+		return sourcePath + ".btx";
+	}
+
+	// True if the baked file for sourcePath exists and is at least as new as the source
+	bool IsBakedTextureCurrent(const std::string& sourcePath)
+	{
+		std::error_code error;
+		const fs::file_time_type bakedTime{ fs::last_write_time(fs::path(BakedTexturePath(sourcePath)), error) };
+		if (error)
+			return false;
+
+		const fs::file_time_type sourceTime{ fs::last_write_time(fs::path(sourcePath), error) };
+		if (error)
+			return true;
+
+		return bakedTime >= sourceTime;
+	}
+
+	// One level on its way to the file
+	struct BakedLevel
+	{
+		int width;
+		int height;
+		const BYTE* data;
+		size_t size;
+	};
+
+	static bool WriteContainer(const std::string& destinationPath, ImageFormat format, const std::vector<BakedLevel>& levels)
+	{
+		TextureContainerHeader header{};
+		header.magic = kTextureContainerMagic;
+		header.version = kTextureContainerVersion;
+		header.format = (UINT32)format;
+		header.width = (UINT32)levels[0].width;
+		header.height = (UINT32)levels[0].height;
+		header.levelCount = (UINT32)levels.size();
+
+		size_t offset{ kTextureContainerDataAlignment };
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			header.levels[i] = TextureContainerLevel{ (UINT32)levels[i].width, (UINT32)levels[i].height, offset, levels[i].size };
+			offset = AlignUp(offset + levels[i].size, kTextureContainerLevelAlignment);
+		}
+
+		// Write to a temporary file first so the game never maps a half written container
+		const std::string tempPath{ destinationPath + ".tmp" };
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cout << "Could not create: " << tempPath << std::endl;
+				return false;
+			}
+
+			const std::vector<char> padding(kTextureContainerDataAlignment, 0);
+			file.write((const char*)&header, sizeof(header));
+			file.write(padding.data(), kTextureContainerDataAlignment - sizeof(header));
+
+			size_t written{ kTextureContainerDataAlignment };
+			for (size_t i = 0; i < levels.size(); i++)
+			{
+				file.write(padding.data(), header.levels[i].offset - written);
+				file.write((const char*)levels[i].data, levels[i].size);
+				written = header.levels[i].offset + levels[i].size;
+			}
+
+			if (!file)
+			{
+				std::cout << "Failed writing: " << tempPath << std::endl;
+				return false;
+			}
+		}
+
+		std::error_code error;
+		fs::rename(fs::path(tempPath), fs::path(destinationPath), error);
+		if (error)
+		{
+			std::cout << "Could not replace " << destinationPath << ": " << error.message() << std::endl;
+			fs::remove(fs::path(tempPath), error);
+			return false;
+		}
+
+		return true;
+	}
+
+	// Decodes sourcePath and writes it to destinationPath as a .btx container. Returns false on error.
+	bool BakeTexture(const std::string& sourcePath, const std::string& destinationPath, const TextureBakeSettings& settings)
+	{
+		// Always decode the real source, never an older bake of it
+		ImageLoader image;
+		if (!image.Load(sourcePath, ImageLoadMode::RGBA, false))
+			return false;
+
+		ImageFormat format{ image.Format() };
+		std::vector<BakedLevel> levels;
+		std::vector<std::vector<BYTE>> storage;
+
+		if (image.IsCompressed())
+		{
+			// Already in a GPU format, keep the stored levels
+			for (int i = 0; i < std::min(image.MipLevelCount(), kTextureContainerMaxLevels); i++)
+			{
+				const ImageMipLevel level{ image.GetMipLevel(i) };
+				levels.push_back(BakedLevel{ level.width, level.height, image.GetData() + level.offset, level.size });
+			}
+		}
+		else
+		{
+			if (settings.generateMips)
+				image.GenerateMipChain(kTextureContainerMaxLevels);
+
+			for (int i = 0; i < image.MipLevelCount(); i++)
+			{
+				const ImageMipLevel level{ image.GetMipLevel(i) };
+				levels.push_back(BakedLevel{ level.width, level.height, image.GetData() + level.offset, level.size });
+			}
+
+			if (settings.compress)
+			{
+				format = HasTransparency(image.GetData(), image.Width(), image.Height()) ? ImageFormat::BC3 : ImageFormat::BC1;
+				for (BakedLevel& level : levels)
+				{
+					storage.emplace_back(ImageLevelSize(level.width, level.height, format));
+					CompressImage(level.data, level.width, level.height, format, storage.back().data());
+					level.data = storage.back().data();
+					level.size = storage.back().size();
+				}
+			}
+		}
+
+		return WriteContainer(destinationPath, format, levels);
+	}
+
+	// Maps a .btx file and points the image at its levels. Returns false if the file is missing or not valid
+	bool ImageLoader::LoadContainer(const std::string& filepath)
+	{
+		MappedFile file;
+		if (!file.Open(filepath))
+			return false;
+
+		TextureContainerHeader header;
+		if (file.Size() < sizeof(header))
+			return false;
+		memcpy(&header, file.Data(), sizeof(header));
+
+		if (header.magic != kTextureContainerMagic || header.version != kTextureContainerVersion ||
+			header.format > (UINT32)ImageFormat::BC3 || header.levelCount == 0 || header.levelCount > kTextureContainerMaxLevels ||
+			header.width == 0 || header.height == 0)
+		{
+			std::cout << "Not a valid baked texture: " << filepath << std::endl;
+			return false;
+		}
+
+		const ImageFormat format{ (ImageFormat)header.format };
+		const UINT64 base{ header.levels[0].offset };
+
+		std::vector<ImageMipLevel> levels;
+		levels.reserve(header.levelCount);
+		for (UINT32 i = 0; i < header.levelCount; i++)
+		{
+			const TextureContainerLevel& level{ header.levels[i] };
+			if (level.offset < base || level.offset + level.size > file.Size() ||
+				level.size != ImageLevelSize((int)level.width, (int)level.height, format))
+			{
+				std::cout << "Baked texture is corrupt: " << filepath << std::endl;
+				return false;
+			}
+			levels.push_back(ImageMipLevel{ (int)level.width, (int)level.height, (size_t)(level.offset - base), (size_t)level.size });
+		}
+
+		m_width = (int)header.width;
+		m_height = (int)header.height;
+		m_data = file.Data() + base;
+		m_format = format;
+		m_mipLevels = std::move(levels);
+		m_mappedFile = std::move(file);
+		return true;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+// Baked texture container (.btx). Holds every mip level of an image, already in its GPU format
+// (RGBA8 or block compressed) so loading is a memory map and an upload with no decoding or mip generation.
+// Files are written by the TextureBaker tool and picked up automatically by ImageLoader::Load.
+
+#include "ExternalLibraryHeaders.h"
+#include "ImageLoader.h"
+
+namespace Helpers
+{
+	constexpr UINT32 kTextureContainerMagic{ 0x58544221 };	// "!BTX"
+	constexpr UINT32 kTextureContainerVersion{ 1 };
+	constexpr int kTextureContainerMaxLevels{ 16 };
+
+	// Level data starts on a page boundary so the first level of a mapped file is page aligned,
+	// every level after that is aligned to kTextureContainerLevelAlignment
+	constexpr size_t kTextureContainerDataAlignment{ 4096 };
+	constexpr size_t kTextureContainerLevelAlignment{ 256 };
+
+	// Position of one mip level, offset is from the start of the file
+	struct TextureContainerLevel
+	{
+		UINT32 width;
+		UINT32 height;
+		UINT64 offset;
+		UINT64 size;
+	};
+
+	// Start of a .btx file, followed by padding up to kTextureContainerDataAlignment and then the levels
+	struct TextureContainerHeader
+	{
+		UINT32 magic;
+		UINT32 version;
+		UINT32 format;			// ImageFormat
+		UINT32 width;
+		UINT32 height;
+		UINT32 levelCount;
+		UINT32 reserved[2];
+		TextureContainerLevel levels[kTextureContainerMaxLevels];
+	};
+
+	// Options for BakeTexture
+	struct TextureBakeSettings
+	{
+		// Store BC1 (opaque) or BC3 (with alpha) rather than RGBA8. 4 to 8 times smaller but lossy
+		bool compress{ false };
+
+		// Build the full mip chain. Images that are already compressed keep whatever mips they have
+		bool generateMips{ true };
+	};
+
+	// The file BakeTexture writes for sourcePath, next to the source with .btx appended
+	std::string BakedTexturePath(const std::string& sourcePath);
+
+	// True if the baked file for sourcePath exists and is at least as new as the source.
+	// Also true when only the baked file exists, e.g. in a build that ships without source images.
+	bool IsBakedTextureCurrent(const std::string& sourcePath);
+
+	// Decodes sourcePath and writes it to destinationPath as a .btx container. Returns false on error.
+	bool BakeTexture(const std::string& sourcePath, const std::string& destinationPath, const TextureBakeSettings& settings);
+}
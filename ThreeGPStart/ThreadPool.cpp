@@ -0,0 +1,68 @@
+#include "ThreadPool.h"
+#include "Parallel.h"
+
+namespace Helpers
+{
+	// Creates numThreads workers, 0 means one per hardware thread
+	ThreadPool::ThreadPool(size_t numThreads)
+	{
+		if (numThreads == 0)
+			numThreads = WorkerThreadCount();
+
+		m_threads.reserve(numThreads);
+		for (size_t i = 0; i < numThreads; i++)
+			m_threads.emplace_back([this]() { WorkerLoop(); });
+	}
+
+	// Runs any jobs still queued then joins the workers
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_jobAvailable.notify_all();
+
+		for (std::thread& t : m_threads)
+			t.join();
+	}
+
+	void ThreadPool::Enqueue(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_jobAvailable.notify_one();
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		// Every worker is already busy with its own job, splitting one further would only oversubscribe the CPU
+		ParallelForRunsSerially() = true;
+
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+				if (m_jobs.empty())
+					return;
+
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	// Pool shared by the asset loading code
+	ThreadPool& LoadingPool()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+}
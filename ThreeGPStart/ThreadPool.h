@@ -0,0 +1,55 @@
+#pragma once
+// Fixed size pool of worker threads for background jobs such as file loading
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Helpers
+{
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAvailable;
+		bool m_stopping{ false };
+
+		void WorkerLoop();
+		void Enqueue(std::function<void()> job);
+	public:
+		// Creates numThreads workers, 0 means one per hardware thread
+		explicit ThreadPool(size_t numThreads = 0);
+
+		// Runs any jobs still queued then joins the workers
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Number of worker threads
+		size_t Size() const { return m_threads.size(); }
+
+		// Queues func to run on a worker. The returned future holds its result or any exception it threw
+		template<typename Func>
+		auto Submit(Func&& func) -> std::future<decltype(func())>
+		{
+			using Result = decltype(func());
+
+			// std::function must be copyable and packaged_task isn't, hence the shared_ptr
+			auto task{ std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func)) };
+			std::future<Result> result{ task->get_future() };
+			Enqueue([task]() { (*task)(); });
+			return result;
+		}
+	};
+
+	// Pool shared by the asset loading code
+	ThreadPool& LoadingPool();
+}
@@ -0,0 +1,414 @@
+#include "VirtualTexture.h"
+#include "ThreadPool.h"
+
+namespace Helpers
+{
+	// lastUsedFrame of the coarsest page, which is never evicted so every lookup finds something
+	constexpr UINT64 kPinnedPage{ ~0ull };
+
+	static int NextPowerOfTwo(int value)
+	{
+		int power{ 1 };
+		while (power < value)
+			power *= 2;
+		return power;
+	}
+
+	// Page table texel as the shader reads it: cache slot x and y, level of the mapped page, 1 for valid
+	static UINT32 PageTableEntry(int slotX, int slotY, int level)
+	{
+		return (UINT32)slotX | ((UINT32)slotY << 8) | ((UINT32)level << 16) | (1u << 24);
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		// The copies read from the mapping
+		for (auto& load : m_pendingLoads)
+			load.second.data.wait();
+
+		for (FeedbackSlot& slot : m_feedbackSlots)
+		{
+			if (slot.fence)
+				glDeleteSync(slot.fence);
+			glDeleteBuffers(1, &slot.pbo);
+		}
+
+		glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+		glDeleteRenderbuffers(1, &m_feedbackDepth);
+		glDeleteTextures(1, &m_feedbackTarget);
+		glDeleteTextures(1, &m_pageTable);
+		glDeleteTextures(1, &m_cache);
+	}
+
+	// Maps the .vtx and creates the page table and cache with the coarsest page loaded
+	bool VirtualTexture::Open(const std::string& filepath, const VirtualTextureSettings& settings)
+	{
+		if (m_header)
+		{
+			std::cout << "VirtualTexture is already open, can't open " << filepath << std::endl;
+			return false;
+		}
+
+		if (!m_file.Open(filepath))
+		{
+			std::cout << "Could not open virtual texture: " << filepath << std::endl;
+			return false;
+		}
+
+		m_header = ValidateVirtualTexture(m_file.Data(), m_file.Size());
+		if (!m_header)
+		{
+			std::cout << "Not a usable virtual texture: " << filepath << std::endl;
+			m_file.Close();
+			return false;
+		}
+
+		// Slot positions are stored in a byte each
+		m_settings = settings;
+		m_settings.cachePages = std::clamp(m_settings.cachePages, 1, 255);
+		m_settings.feedbackDivisor = std::max(m_settings.feedbackDivisor, 1);
+		m_slots.assign((size_t)m_settings.cachePages * m_settings.cachePages, CacheSlot());
+
+		// A power of two table gives each virtual level its own mip level, and is big enough for the pages of
+		// every level as they are rounded up when halved
+		const int tableWidth{ NextPowerOfTwo((int)m_header->levels[0].pagesX) };
+		const int tableHeight{ NextPowerOfTwo((int)m_header->levels[0].pagesY) };
+		m_tableLevels.resize(LevelCount());
+		for (int level = 0; level < LevelCount(); level++)
+			m_tableLevels[level].resize((size_t)std::max(tableWidth >> level, 1) * std::max(tableHeight >> level, 1));
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_pageTable);
+		glTextureStorage2D(m_pageTable, LevelCount(), GL_RGBA8UI, tableWidth, tableHeight);
+		glTextureParameteri(m_pageTable, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(m_pageTable, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+		// Pages carry their own borders so the cache is only ever sampled bilinearly at level 0
+		const int cacheSize{ m_settings.cachePages * kVirtualTexturePageStride };
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_cache);
+		glTextureStorage2D(m_cache, 1, GL_RGBA8, cacheSize, cacheSize);
+		glTextureParameteri(m_cache, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(m_cache, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(m_cache, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_cache, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		const UINT32 coarsest{ VirtualPageKey(LevelCount() - 1, 0, 0) };
+		UploadPage(coarsest, PageData(coarsest));
+		m_slots[m_residentPages[coarsest]].lastUsedFrame = kPinnedPage;
+		RebuildPageTable();
+		return true;
+	}
+
+	// Where a page is stored in the mapped file
+	const BYTE* VirtualTexture::PageData(UINT32 page) const
+	{
+		const VirtualTextureLevel& level{ m_header->levels[VirtualPageLevel(page)] };
+		const UINT64 index{ (UINT64)VirtualPageY(page) * level.pagesX + VirtualPageX(page) };
+		return m_file.Data() + level.offset + index * kVirtualTexturePageBytes;
+	}
+
+	// Binds the page table and cache and sets the vt_ uniforms of program
+	void VirtualTexture::Bind(GLuint program, GLuint pageTableUnit, GLuint cacheUnit, float lodBias) const
+	{
+		glBindTextureUnit(pageTableUnit, m_pageTable);
+		glBindTextureUnit(cacheUnit, m_cache);
+
+		glUniform1i(glGetUniformLocation(program, "vt_page_table"), pageTableUnit);
+		glUniform1i(glGetUniformLocation(program, "vt_cache"), cacheUnit);
+		glUniform2f(glGetUniformLocation(program, "vt_size"), (float)Width(), (float)Height());
+		glUniform1f(glGetUniformLocation(program, "vt_page_size"), (float)kVirtualTexturePageSize);
+		glUniform1f(glGetUniformLocation(program, "vt_page_border"), (float)kVirtualTexturePageBorder);
+		glUniform1f(glGetUniformLocation(program, "vt_cache_size"), (float)(m_settings.cachePages * kVirtualTexturePageStride));
+		glUniform1f(glGetUniformLocation(program, "vt_max_level"), (float)(LevelCount() - 1));
+		glUniform1f(glGetUniformLocation(program, "vt_lod_bias"), lodBias);
+	}
+
+	// Drawn feedbackDivisor times smaller, so screen space derivatives are that much bigger
+	float VirtualTexture::FeedbackLodBias() const
+	{
+		return -std::log2((float)m_settings.feedbackDivisor);
+	}
+
+	// Switches to the small feedback target
+	void VirtualTexture::BeginFeedback()
+	{
+		glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+
+		const int width{ std::max(m_savedViewport[2] / m_settings.feedbackDivisor, 1) };
+		const int height{ std::max(m_savedViewport[3] / m_settings.feedbackDivisor, 1) };
+		if (width != m_feedbackWidth || height != m_feedbackHeight)
+		{
+			glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+			glDeleteRenderbuffers(1, &m_feedbackDepth);
+			glDeleteTextures(1, &m_feedbackTarget);
+
+			glCreateTextures(GL_TEXTURE_2D, 1, &m_feedbackTarget);
+			glTextureStorage2D(m_feedbackTarget, 1, GL_R32UI, width, height);
+			glCreateRenderbuffers(1, &m_feedbackDepth);
+			glNamedRenderbufferStorage(m_feedbackDepth, GL_DEPTH_COMPONENT24, width, height);
+
+			glCreateFramebuffers(1, &m_feedbackFramebuffer);
+			glNamedFramebufferTexture(m_feedbackFramebuffer, GL_COLOR_ATTACHMENT0, m_feedbackTarget, 0);
+			glNamedFramebufferRenderbuffer(m_feedbackFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+
+			m_feedbackWidth = width;
+			m_feedbackHeight = height;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+		glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+
+		// 0 means no page
+		const GLuint noPage[4]{ 0, 0, 0, 0 };
+		GLfloat farDepth{ 1.0f };
+		glClearNamedFramebufferuiv(m_feedbackFramebuffer, GL_COLOR, 0, noPage);
+		glClearNamedFramebufferfv(m_feedbackFramebuffer, GL_DEPTH, 0, &farDepth);
+	}
+
+	// Queues the feedback readback and restores the framebuffer and viewport
+	void VirtualTexture::EndFeedback()
+	{
+		// Skipping a frame's feedback when the ring is full is harmless, the next one asks for the same pages
+		FeedbackSlot& slot{ m_feedbackSlots[m_nextFeedbackSlot] };
+		if (!slot.fence)
+		{
+			const size_t size{ (size_t)m_feedbackWidth * m_feedbackHeight * sizeof(UINT32) };
+			if (slot.capacity < size)
+			{
+				glDeleteBuffers(1, &slot.pbo);
+				glCreateBuffers(1, &slot.pbo);
+				glNamedBufferStorage(slot.pbo, size, nullptr, GL_MAP_READ_BIT);
+				slot.capacity = size;
+			}
+
+			// With a pack buffer bound glReadPixels only queues the copy
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glReadPixels(0, 0, m_feedbackWidth, m_feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			slot.width = m_feedbackWidth;
+			slot.height = m_feedbackHeight;
+			m_nextFeedbackSlot = (m_nextFeedbackSlot + 1) % kFeedbackSlots;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+		glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	}
+
+	// Turns a finished feedback readback into page requests
+	void VirtualTexture::ReadFeedback(FeedbackSlot& slot)
+	{
+		glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+
+		const size_t count{ (size_t)slot.width * slot.height };
+		const UINT32* pixels{ (const UINT32*)glMapNamedBufferRange(slot.pbo, 0, count * sizeof(UINT32), GL_MAP_READ_BIT) };
+		if (!pixels)
+			return;
+
+		// Neighbouring pixels nearly always want the same page, skipping repeats keeps the sort small
+		std::vector<UINT32> pages;
+		UINT32 previous{ 0 };
+		for (size_t i = 0; i < count; i++)
+		{
+			if (pixels[i] != 0 && pixels[i] != previous)
+				pages.push_back(pixels[i] - 1);
+			previous = pixels[i];
+		}
+		glUnmapNamedBuffer(slot.pbo);
+
+		// Every coarser page above a wanted one is wanted too, they are what is drawn until it arrives
+		const size_t wanted{ pages.size() };
+		for (size_t i = 0; i < wanted; i++)
+		{
+			int x{ VirtualPageX(pages[i]) };
+			int y{ VirtualPageY(pages[i]) };
+			for (int level = VirtualPageLevel(pages[i]) + 1; level < LevelCount(); level++)
+			{
+				x /= 2;
+				y /= 2;
+				pages.push_back(VirtualPageKey(level, x, y));
+			}
+		}
+		std::sort(pages.begin(), pages.end());
+		pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+		// Pages seen now can't be evicted until the next feedback
+		m_frame++;
+		m_requests.clear();
+		for (const UINT32 page : pages)
+		{
+			const int level{ VirtualPageLevel(page) };
+			if (level >= LevelCount() || VirtualPageX(page) >= (int)m_header->levels[level].pagesX || VirtualPageY(page) >= (int)m_header->levels[level].pagesY)
+				continue;
+
+			const auto resident{ m_residentPages.find(page) };
+			if (resident != m_residentPages.end())
+			{
+				CacheSlot& cacheSlot{ m_slots[resident->second] };
+				if (cacheSlot.lastUsedFrame != kPinnedPage)
+					cacheSlot.lastUsedFrame = m_frame;
+			}
+			else
+			{
+				const auto pending{ m_pendingLoads.find(page) };
+				if (pending != m_pendingLoads.end())
+					pending->second.wantedFrame = m_frame;
+				else
+					m_requests.push_back(page);
+			}
+		}
+
+		// Coarsest first, they cover the most screen and make the finer ones useful. Keys sort by level first
+		std::reverse(m_requests.begin(), m_requests.end());
+	}
+
+	// Hands requested pages to the loading pool
+	void VirtualTexture::StartLoads()
+	{
+		for (const UINT32 page : m_requests)
+		{
+			if ((int)m_pendingLoads.size() >= m_settings.maxPendingLoads)
+				break;
+
+			// Copying out of the mapping is what reads the file, so it happens on a worker not this thread
+			const BYTE* data{ PageData(page) };
+			PendingLoad& load{ m_pendingLoads[page] };
+			load.wantedFrame = m_frame;
+			load.data = LoadingPool().Submit([data]()
+			{
+				return std::vector<BYTE>(data, data + kVirtualTexturePageBytes);
+			});
+		}
+
+		// Anything not started is asked for again by the next feedback if it's still needed
+		m_requests.clear();
+	}
+
+	// Uploads pages that have finished loading
+	void VirtualTexture::FinishLoads()
+	{
+		int uploads{ 0 };
+		for (auto it = m_pendingLoads.begin(); it != m_pendingLoads.end() && uploads < m_settings.maxUploadsPerFrame;)
+		{
+			if (it->second.data.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+
+			// The view moved on while it loaded, it would only push out pages that are wanted
+			const std::vector<BYTE> data{ it->second.data.get() };
+			if (it->second.wantedFrame == m_frame)
+			{
+				UploadPage(it->first, data.data());
+				uploads++;
+			}
+			it = m_pendingLoads.erase(it);
+		}
+	}
+
+	// Puts a page in a free slot or the least recently used one. Returns false if every slot is still in use
+	bool VirtualTexture::UploadPage(UINT32 page, const BYTE* data)
+	{
+		int best{ -1 };
+		for (int i = 0; i < (int)m_slots.size(); i++)
+		{
+			if (m_slots[i].page == kNoPage)
+			{
+				best = i;
+				break;
+			}
+			if (m_slots[i].lastUsedFrame < m_frame && (best < 0 || m_slots[i].lastUsedFrame < m_slots[best].lastUsedFrame))
+				best = i;
+		}
+
+		// The cache is too small for the view, the page is asked for again once something frees up
+		if (best < 0)
+			return false;
+
+		CacheSlot& slot{ m_slots[best] };
+		if (slot.page != kNoPage)
+			m_residentPages.erase(slot.page);
+
+		const int slotX{ best % m_settings.cachePages };
+		const int slotY{ best / m_settings.cachePages };
+		glTextureSubImage2D(m_cache, 0, slotX * kVirtualTexturePageStride, slotY * kVirtualTexturePageStride,
+			kVirtualTexturePageStride, kVirtualTexturePageStride, GL_RGBA, GL_UNSIGNED_BYTE, data);
+
+		slot.page = page;
+		slot.lastUsedFrame = m_frame;
+		m_residentPages[page] = best;
+		m_tableDirty = true;
+		m_uploadedPages++;
+		return true;
+	}
+
+	// Points every page table entry at its page if resident, otherwise at whatever its parent points at
+	void VirtualTexture::RebuildPageTable()
+	{
+		for (std::vector<UINT32>& entries : m_tableLevels)
+			std::fill(entries.begin(), entries.end(), 0);
+
+		const int tableWidth{ NextPowerOfTwo((int)m_header->levels[0].pagesX) };
+		const int tableHeight{ NextPowerOfTwo((int)m_header->levels[0].pagesY) };
+
+		// Resident pages go in first, then each level from the top inherits its parent's entry where it has none
+		for (const auto& resident : m_residentPages)
+		{
+			const int level{ VirtualPageLevel(resident.first) };
+			const int width{ std::max(tableWidth >> level, 1) };
+			m_tableLevels[level][(size_t)VirtualPageY(resident.first) * width + VirtualPageX(resident.first)] =
+				PageTableEntry(resident.second % m_settings.cachePages, resident.second / m_settings.cachePages, level);
+		}
+
+		for (int level = LevelCount() - 1; level >= 0; level--)
+		{
+			const int width{ std::max(tableWidth >> level, 1) };
+			const int height{ std::max(tableHeight >> level, 1) };
+			std::vector<UINT32>& entries{ m_tableLevels[level] };
+
+			if (level + 1 < LevelCount())
+			{
+				const int parentWidth{ std::max(tableWidth >> (level + 1), 1) };
+				const int parentHeight{ std::max(tableHeight >> (level + 1), 1) };
+				const std::vector<UINT32>& parents{ m_tableLevels[level + 1] };
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						UINT32& entry{ entries[(size_t)y * width + x] };
+						if (entry == 0)
+							entry = parents[(size_t)std::min(y / 2, parentHeight - 1) * parentWidth + std::min(x / 2, parentWidth - 1)];
+					}
+				}
+			}
+
+			glTextureSubImage2D(m_pageTable, level, 0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+		}
+
+		m_tableDirty = false;
+	}
+
+	// Reads back finished feedback, starts loading missing pages and uploads loaded ones
+	void VirtualTexture::Update()
+	{
+		if (!m_header)
+			return;
+
+		// Oldest first, only the newest matters but each one frees its slot for reuse
+		for (int i = 0; i < kFeedbackSlots; i++)
+		{
+			FeedbackSlot& slot{ m_feedbackSlots[(m_nextFeedbackSlot + i) % kFeedbackSlots] };
+			if (slot.fence && glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED)
+				ReadFeedback(slot);
+		}
+
+		StartLoads();
+		FinishLoads();
+
+		if (m_tableDirty)
+			RebuildPageTable();
+	}
+}
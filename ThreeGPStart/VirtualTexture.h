@@ -0,0 +1,150 @@
+#pragma once
+// Sparse virtual texturing. A texture far bigger than video memory is streamed a page at a time from a
+// baked .vtx file (see VirtualTextureFile.h) into a fixed size physical cache texture, so video memory use
+// stays the same however large the texture is.
+//
+// Each frame the scene is drawn small with a feedback shader that writes the page each pixel needs. That is
+// read back a couple of frames later without stalling, missing pages are copied out of the mapped file on
+// the loading pool and uploaded into free or least recently used cache slots. A page table texture with one
+// mip level per virtual level maps every page to its cache slot, or to the nearest coarser page that is
+// resident, so something is always drawn while finer pages arrive.
+//
+// Shader side, see fragment_shader.frag (VirtualSample) and vt_feedback.frag.
+
+#include "ExternalLibraryHeaders.h"
+#include "MappedFile.h"
+#include "VirtualTextureFile.h"
+#include <future>
+#include <unordered_map>
+
+namespace Helpers
+{
+	// Settings fixed when a virtual texture is opened
+	struct VirtualTextureSettings
+	{
+		// The physical cache holds cachePages x cachePages pages. 16 is 256 pages in 19 MB
+		int cachePages{ 16 };
+
+		// The feedback pass is drawn at 1 / feedbackDivisor of the viewport size
+		int feedbackDivisor{ 8 };
+
+		// Page copies in flight on the loading pool, and uploads done per Update to keep the frame time even
+		int maxPendingLoads{ 32 };
+		int maxUploadsPerFrame{ 16 };
+	};
+
+	// Can't be copied. Everything but the page copies happens on the OpenGL thread
+	class VirtualTexture
+	{
+	private:
+		// Feedback frames in flight between the GPU and the CPU
+		static constexpr int kFeedbackSlots{ 3 };
+
+		struct FeedbackSlot
+		{
+			GLuint pbo{ 0 };
+			size_t capacity{ 0 };
+			GLsync fence{ nullptr };
+			int width{ 0 };
+			int height{ 0 };
+		};
+
+		// One page of the physical cache
+		struct CacheSlot
+		{
+			UINT32 page{ kNoPage };
+			UINT64 lastUsedFrame{ 0 };
+		};
+		static constexpr UINT32 kNoPage{ 0xFFFFFFFF };
+
+		// A page being copied out of the file on the loading pool
+		struct PendingLoad
+		{
+			std::future<std::vector<BYTE>> data;
+			UINT64 wantedFrame{ 0 };
+		};
+
+		MappedFile m_file;
+		const VirtualTextureHeader* m_header{ nullptr };
+		VirtualTextureSettings m_settings;
+
+		GLuint m_pageTable{ 0 };
+		GLuint m_cache{ 0 };
+
+		// Page table contents as RGBA8UI texels: cache slot x, y and the level of the page actually mapped
+		std::vector<std::vector<UINT32>> m_tableLevels;
+		bool m_tableDirty{ false };
+
+		std::vector<CacheSlot> m_slots;
+		std::unordered_map<UINT32, int> m_residentPages;
+		std::unordered_map<UINT32, PendingLoad> m_pendingLoads;
+
+		// Counts feedback readbacks. Pages seen in the latest have lastUsedFrame (or wantedFrame) equal to it,
+		// resident ones can't be evicted until the next
+		UINT64 m_frame{ 1 };
+		int m_uploadedPages{ 0 };
+
+		// Feedback render target and its readback ring
+		GLuint m_feedbackFramebuffer{ 0 };
+		GLuint m_feedbackTarget{ 0 };
+		GLuint m_feedbackDepth{ 0 };
+		int m_feedbackWidth{ 0 };
+		int m_feedbackHeight{ 0 };
+		FeedbackSlot m_feedbackSlots[kFeedbackSlots];
+		int m_nextFeedbackSlot{ 0 };
+		GLint m_savedViewport[4]{};
+		GLint m_savedFramebuffer{ 0 };
+
+		// Page requests from the latest feedback, coarsest first
+		std::vector<UINT32> m_requests;
+
+		int LevelCount() const { return m_header ? (int)m_header->levelCount : 0; }
+		const BYTE* PageData(UINT32 page) const;
+
+		void ReadFeedback(FeedbackSlot& slot);
+		void StartLoads();
+		void FinishLoads();
+		bool UploadPage(UINT32 page, const BYTE* data);
+		void RebuildPageTable();
+	public:
+		VirtualTexture() = default;
+
+		// Waits for page copies still reading the file
+		~VirtualTexture();
+
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+		// Maps the .vtx and creates the page table and cache, with the coarsest page loaded so there is always
+		// something to draw. Must be called on the OpenGL thread. Returns false on error
+		bool Open(const std::string& filepath, const VirtualTextureSettings& settings = VirtualTextureSettings());
+
+		bool IsOpen() const { return m_header != nullptr; }
+
+		// Size of the whole texture in texels
+		int Width() const { return m_header ? (int)m_header->width : 0; }
+		int Height() const { return m_header ? (int)m_header->height : 0; }
+
+		// Binds the page table and cache to texture units pageTableUnit and cacheUnit and sets the vt_ uniforms
+		// of program. lodBias is added to the mip level the shader picks, the feedback pass needs the extra
+		// bias from FeedbackLodBias as it is drawn smaller
+		void Bind(GLuint program, GLuint pageTableUnit, GLuint cacheUnit, float lodBias = 0.0f) const;
+
+		// Bias for the feedback pass so it asks for the pages the full size view needs
+		float FeedbackLodBias() const;
+
+		// Draw the geometry that uses the texture with vt_feedback.frag between these. Begin switches to the
+		// small feedback target, End queues its readback and restores the framebuffer and viewport
+		void BeginFeedback();
+		void EndFeedback();
+
+		// Call once a frame. Reads back finished feedback, starts loading missing pages and uploads loaded ones
+		void Update();
+
+		// Pages in the cache / being loaded, and pages uploaded since opening
+		int ResidentPages() const { return (int)m_residentPages.size(); }
+		int PendingPages() const { return (int)m_pendingLoads.size(); }
+		int UploadedPages() const { return m_uploadedPages; }
+		int CachePages() const { return (int)m_slots.size(); }
+	};
+}
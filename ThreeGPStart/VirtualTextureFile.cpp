@@ -0,0 +1,218 @@
+#include "VirtualTextureFile.h"
+#include "ImageRegionReader.h"
+#include "PixelConvert.h"
+#include <fstream>
+#include <filesystem>
+namespace fs = std::filesystem;
+
+namespace Helpers
+{
+	static_assert(sizeof(VirtualTextureHeader) <= kVirtualTextureDataAlignment, "Virtual texture header must fit before the pages");
+	static_assert(kVirtualTexturePageBorder * 2 <= kVirtualTexturePageSize, "A page border can only reach into the next page");
+
+	// The file BakeVirtualTexture writes for sourcePath
+	std::string VirtualTexturePath(const std::string& sourcePath)
+	{
+		return sourcePath + ".vtx";
+	}
+
+	// True if the .vtx for sourcePath exists and is at least as new as the source
+	bool IsVirtualTextureCurrent(const std::string& sourcePath)
+	{
+		std::error_code error;
+		const fs::file_time_type bakedTime{ fs::last_write_time(fs::path(VirtualTexturePath(sourcePath)), error) };
+		if (error)
+			return false;
+
+		const fs::file_time_type sourceTime{ fs::last_write_time(fs::path(sourcePath), error) };
+		if (error)
+			return true;
+
+		return bakedTime >= sourceTime;
+	}
+
+	// Fills a stride x stride block of texels from (left, bottom) with texel(x, y), which must clamp to the edges
+	template<typename Texel>
+	static void FillTexels(int left, int bottom, int stride, Texel texel, UINT32* destination)
+	{
+		for (int y = 0; y < stride; y++)
+		{
+			for (int x = 0; x < stride; x++)
+				destination[(size_t)y * stride + x] = texel(left + x, bottom + y);
+		}
+	}
+
+	// Cuts sourcePath into pages and writes them with the full mip chain to destinationPath
+	bool BakeVirtualTexture(const std::string& sourcePath, const std::string& destinationPath)
+	{
+		ImageRegionReader source;
+		if (!source.Open(sourcePath, ImageLoadMode::RGBA))
+			return false;
+
+		const int width{ source.Width() };
+		const int height{ source.Height() };
+		const int pagesX{ (width + kVirtualTexturePageSize - 1) / kVirtualTexturePageSize };
+		const int pagesY{ (height + kVirtualTexturePageSize - 1) / kVirtualTexturePageSize };
+		if (pagesX > kVirtualTextureMaxPages || pagesY > kVirtualTextureMaxPages)
+		{
+			std::cout << "Too big for a virtual texture: " << sourcePath << std::endl;
+			return false;
+		}
+
+		// Halve the page grid (rounding up) until it is a single page
+		VirtualTextureHeader header{};
+		header.magic = kVirtualTextureMagic;
+		header.version = kVirtualTextureVersion;
+		header.width = (UINT32)width;
+		header.height = (UINT32)height;
+		header.pageSize = kVirtualTexturePageSize;
+		header.pageBorder = kVirtualTexturePageBorder;
+
+		UINT64 offset{ kVirtualTextureDataAlignment };
+		for (int level = 0; level < kVirtualTextureMaxLevels; level++)
+		{
+			const UINT32 levelPagesX{ (UINT32)((pagesX + (1 << level) - 1) >> level) };
+			const UINT32 levelPagesY{ (UINT32)((pagesY + (1 << level) - 1) >> level) };
+			header.levels[level] = VirtualTextureLevel{ levelPagesX, levelPagesY, offset };
+			header.levelCount++;
+			offset += (UINT64)levelPagesX * levelPagesY * kVirtualTexturePageBytes;
+
+			if (levelPagesX == 1 && levelPagesY == 1)
+				break;
+		}
+
+		// Write to a temporary file first so the game never maps a half written one. Earlier levels are read
+		// back from it to build the later ones, which keeps memory use to a few pages whatever the image size
+		const std::string tempPath{ destinationPath + ".tmp" };
+		bool ok{ true };
+		{
+			std::fstream file(tempPath, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::cout << "Could not create: " << tempPath << std::endl;
+				return false;
+			}
+
+			const std::vector<char> padding(kVirtualTextureDataAlignment - sizeof(header), 0);
+			file.write((const char*)&header, sizeof(header));
+			file.write(padding.data(), padding.size());
+
+			std::vector<UINT32> page((size_t)kVirtualTexturePageStride * kVirtualTexturePageStride);
+
+			// Level 0 a band of source rows at a time, a band holds one row of pages and their borders
+			std::vector<UINT32> band;
+			for (int pageY = 0; pageY < pagesY && ok; pageY++)
+			{
+				const int firstRow{ std::max(pageY * kVirtualTexturePageSize - kVirtualTexturePageBorder, 0) };
+				const int lastRow{ std::min((pageY + 1) * kVirtualTexturePageSize + kVirtualTexturePageBorder, height) - 1 };
+				band.resize((size_t)width * (lastRow - firstRow + 1));
+				if (!source.ReadRows(firstRow, lastRow - firstRow + 1, (BYTE*)band.data()))
+				{
+					ok = false;
+					break;
+				}
+
+				const auto texel = [&](int x, int y)
+				{
+					return band[(size_t)(std::clamp(y, 0, height - 1) - firstRow) * width + std::clamp(x, 0, width - 1)];
+				};
+
+				for (int pageX = 0; pageX < pagesX; pageX++)
+				{
+					FillTexels(pageX * kVirtualTexturePageSize - kVirtualTexturePageBorder, pageY * kVirtualTexturePageSize - kVirtualTexturePageBorder,
+						kVirtualTexturePageStride, texel, page.data());
+					file.write((const char*)page.data(), kVirtualTexturePageBytes);
+				}
+			}
+			source.Close();
+
+			// Later levels from 2x2 texels of the level before. The source texels of a page reach into at most
+			// one page on each side of the 2x2 pages it covers
+			const int windowStride{ kVirtualTexturePageStride * 2 };
+			std::vector<UINT32> window((size_t)windowStride * windowStride);
+			std::vector<std::vector<UINT32>> sourcePages(16, std::vector<UINT32>((size_t)kVirtualTexturePageStride * kVirtualTexturePageStride));
+
+			for (UINT32 level = 1; level < header.levelCount && ok; level++)
+			{
+				const VirtualTextureLevel& previous{ header.levels[level - 1] };
+				const int previousWidth{ (int)previous.pagesX * kVirtualTexturePageSize };
+				const int previousHeight{ (int)previous.pagesY * kVirtualTexturePageSize };
+
+				for (UINT32 pageY = 0; pageY < header.levels[level].pagesY && ok; pageY++)
+				{
+					for (UINT32 pageX = 0; pageX < header.levels[level].pagesX; pageX++)
+					{
+						const int firstSourceX{ std::max((int)pageX * 2 - 1, 0) };
+						const int firstSourceY{ std::max((int)pageY * 2 - 1, 0) };
+						const int lastSourceX{ std::min((int)pageX * 2 + 2, (int)previous.pagesX - 1) };
+						const int lastSourceY{ std::min((int)pageY * 2 + 2, (int)previous.pagesY - 1) };
+
+						for (int y = firstSourceY; y <= lastSourceY; y++)
+						{
+							for (int x = firstSourceX; x <= lastSourceX; x++)
+							{
+								const UINT64 pageOffset{ previous.offset + ((UINT64)y * previous.pagesX + x) * kVirtualTexturePageBytes };
+								file.seekg((std::streamoff)pageOffset);
+								file.read((char*)sourcePages[(y - firstSourceY) * 4 + (x - firstSourceX)].data(), kVirtualTexturePageBytes);
+							}
+						}
+
+						// Only the inside of the source pages is used, their borders repeat the same texels
+						const auto texel = [&](int x, int y)
+						{
+							x = std::clamp(x, 0, previousWidth - 1);
+							y = std::clamp(y, 0, previousHeight - 1);
+							const std::vector<UINT32>& sourcePage{ sourcePages[(y / kVirtualTexturePageSize - firstSourceY) * 4 + (x / kVirtualTexturePageSize - firstSourceX)] };
+							return sourcePage[(size_t)(y % kVirtualTexturePageSize + kVirtualTexturePageBorder) * kVirtualTexturePageStride + x % kVirtualTexturePageSize + kVirtualTexturePageBorder];
+						};
+
+						FillTexels(((int)pageX * kVirtualTexturePageSize - kVirtualTexturePageBorder) * 2, ((int)pageY * kVirtualTexturePageSize - kVirtualTexturePageBorder) * 2,
+							windowStride, texel, window.data());
+						DownsampleRGBA((const BYTE*)window.data(), windowStride, windowStride, (BYTE*)page.data(), kVirtualTexturePageStride, kVirtualTexturePageStride);
+
+						file.seekp((std::streamoff)(header.levels[level].offset + ((UINT64)pageY * header.levels[level].pagesX + pageX) * kVirtualTexturePageBytes));
+						file.write((const char*)page.data(), kVirtualTexturePageBytes);
+					}
+					ok = ok && (bool)file;
+				}
+			}
+
+			if (!file)
+			{
+				std::cout << "Failed writing: " << tempPath << std::endl;
+				ok = false;
+			}
+		}
+
+		std::error_code error;
+		if (ok)
+		{
+			fs::rename(fs::path(tempPath), fs::path(destinationPath), error);
+			if (!error)
+				return true;
+			std::cout << "Could not replace " << destinationPath << ": " << error.message() << std::endl;
+		}
+
+		fs::remove(fs::path(tempPath), error);
+		return false;
+	}
+
+	// Reads and checks the header of a mapped .vtx
+	const VirtualTextureHeader* ValidateVirtualTexture(const BYTE* data, size_t size)
+	{
+		if (!data || size < kVirtualTextureDataAlignment)
+			return nullptr;
+
+		const VirtualTextureHeader* header{ (const VirtualTextureHeader*)data };
+		if (header->magic != kVirtualTextureMagic || header->version != kVirtualTextureVersion ||
+			header->pageSize != kVirtualTexturePageSize || header->pageBorder != kVirtualTexturePageBorder ||
+			header->levelCount == 0 || header->levelCount > kVirtualTextureMaxLevels)
+			return nullptr;
+
+		const VirtualTextureLevel& last{ header->levels[header->levelCount - 1] };
+		if (last.pagesX != 1 || last.pagesY != 1 || last.offset + kVirtualTexturePageBytes > size)
+			return nullptr;
+
+		return header;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+// Tiled virtual texture file (.vtx). The image and its mip levels are cut into fixed size pages, each stored
+// with a border copied from its neighbours, so any page can be read straight into a cache slot without
+// touching the rest of the file. Written by BakeVirtualTexture (also from TextureBaker -virtual) and
+// streamed by VirtualTexture. No OpenGL calls so baking can run on a worker thread.
+
+#include "ExternalLibraryHeaders.h"
+
+namespace Helpers
+{
+	constexpr UINT32 kVirtualTextureMagic{ 0x58545621 };	// "!VTX"
+	constexpr UINT32 kVirtualTextureVersion{ 1 };
+	constexpr int kVirtualTextureMaxLevels{ 16 };
+
+	// Texels across the part of a page that is shown
+	constexpr int kVirtualTexturePageSize{ 128 };
+
+	// Texels on each side of a page copied from its neighbours so bilinear filtering never reads another page
+	constexpr int kVirtualTexturePageBorder{ 4 };
+
+	// Texels across a stored page including its border
+	constexpr int kVirtualTexturePageStride{ kVirtualTexturePageSize + 2 * kVirtualTexturePageBorder };
+
+	// Bytes in a stored page, RGBA8 rows bottom up like ImageLoader's data
+	constexpr size_t kVirtualTexturePageBytes{ (size_t)kVirtualTexturePageStride * kVirtualTexturePageStride * 4 };
+
+	// Page data starts on a page boundary so mapped pages are aligned
+	constexpr size_t kVirtualTextureDataAlignment{ 4096 };
+
+	// Pages of one mip level, offset is from the start of the file. Pages are stored a row at a time from the bottom
+	struct VirtualTextureLevel
+	{
+		UINT32 pagesX;
+		UINT32 pagesY;
+		UINT64 offset;
+	};
+
+	// Start of a .vtx file, followed by padding up to kVirtualTextureDataAlignment and then the levels.
+	// Level n page (x, y) covers level 0 texels from (x, y) * pageSize << n, so every level lines up with level 0
+	// and the last level is a single page
+	struct VirtualTextureHeader
+	{
+		UINT32 magic;
+		UINT32 version;
+		UINT32 width;
+		UINT32 height;
+		UINT32 pageSize;
+		UINT32 pageBorder;
+		UINT32 levelCount;
+		UINT32 reserved;
+		VirtualTextureLevel levels[kVirtualTextureMaxLevels];
+	};
+
+	// Identifies a page by level and position. Also what the feedback pass writes, plus one so 0 means no page
+	constexpr UINT32 VirtualPageKey(int level, int x, int y)
+	{
+		return ((UINT32)level << 24) | ((UINT32)y << 12) | (UINT32)x;
+	}
+	constexpr int VirtualPageLevel(UINT32 key) { return (int)(key >> 24); }
+	constexpr int VirtualPageY(UINT32 key) { return (int)((key >> 12) & 0xFFF); }
+	constexpr int VirtualPageX(UINT32 key) { return (int)(key & 0xFFF); }
+
+	// Largest level 0 page grid the keys can address
+	constexpr int kVirtualTextureMaxPages{ 4096 };
+
+	// The file BakeVirtualTexture writes for sourcePath, next to the source with .vtx appended
+	std::string VirtualTexturePath(const std::string& sourcePath);
+
+	// True if the .vtx for sourcePath exists and is at least as new as the source, or only the .vtx exists
+	bool IsVirtualTextureCurrent(const std::string& sourcePath);
+
+	// Cuts sourcePath into pages and writes them with the full mip chain to destinationPath.
+	// The source is read a band of rows at a time through ImageRegionReader, so uncompressed BMP, TGA and RAW
+	// images far bigger than memory can be baked. Returns false on error.
+	bool BakeVirtualTexture(const std::string& sourcePath, const std::string& destinationPath);
+
+	// Reads and checks the header of a mapped .vtx. Returns nullptr if it isn't a usable virtual texture
+	const VirtualTextureHeader* ValidateVirtualTexture(const BYTE* data, size_t size);
+}
@@ -50,26 +50,29 @@ int main()
 	if (!window)
 		return -1;
 
-	// Create an instance of the simulation class and initialise it
-	// If it could not load, exit gracefully
-	Simulation simulation;	
-	if (!simulation.Initialise())
+	// The simulation owns OpenGL objects so it is destroyed here, while the context still exists
 	{
-		glfwTerminate();
-		return -1;
-	}
+		// Create an instance of the simulation class and initialise it
+		// If it could not load, exit gracefully
+		Simulation simulation;	
+		if (!simulation.Initialise())
+		{
+			glfwTerminate();
+			return -1;
+		}
 		
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
+		glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
 
-	// Enter main GLFW loop until the user closes the window
-	while (!glfwWindowShouldClose(window))
-	{				
-		if (!simulation.Update(window))
-			break;
+		// Enter main GLFW loop until the user closes the window
+		while (!glfwWindowShouldClose(window))
+		{				
+			if (!simulation.Update(window))
+				break;
 		
-		// GLFW updating
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+			// GLFW updating
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
 	}
 
 	// Close down IMGUI